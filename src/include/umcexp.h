@@ -0,0 +1,92 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef UMCEXP_H
+#define UMCEXP_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <umcounters.h>
+
+// consts
+#define UMCEXP_CLIENTS 16
+#define UMCEXP_REQ_MAX 2048
+#define UMCEXP_PREFIX "umink_"
+
+// types
+typedef struct umcexp umcexp_t;
+typedef struct umcexp_client umcexp_client_t;
+
+/**
+ * Exporter client connection
+ */
+struct umcexp_client {
+    /** Socket (-1 if unused) */
+    int fd;
+    /** Request buffer */
+    char req[UMCEXP_REQ_MAX];
+    /** Request size */
+    size_t req_sz;
+    /** Response buffer */
+    char *rsp;
+    /** Response size */
+    size_t rsp_sz;
+    /** Response bytes sent */
+    size_t rsp_off;
+};
+
+/**
+ * OpenMetrics exporter
+ */
+struct umcexp {
+    /** Counter context */
+    umc_ctx_t *ctx;
+    /** Listening socket */
+    int fd;
+    /** UNIX socket path (removed on shutdown) */
+    char *path;
+    /** Clients */
+    umcexp_client_t clients[UMCEXP_CLIENTS];
+    /** Stop flag */
+    int stop;
+    /** Exporter thread */
+    pthread_t th;
+};
+
+/**
+ * Create OpenMetrics exporter and start its thread
+ *
+ * @param[in]   ctx     Counter context
+ * @param[in]   addr    Listen address ("unix:/path",
+ *                      "tcp:host:port" or "tcp:port")
+ *
+ * @return      Exporter or NULL on error
+ */
+umcexp_t *umcexp_new(umc_ctx_t *ctx, const char *addr);
+
+/**
+ * Stop exporter and close all connections
+ *
+ * @param[in]   exp     Exporter
+ */
+void umcexp_free(umcexp_t *exp);
+
+/**
+ * Format all counters in OpenMetrics text format (the
+ * context lock is not used)
+ *
+ * @param[in]   ctx     Counter context
+ * @param[out]  sz      Output size
+ *
+ * @return      Output buffer (free with free()) or NULL
+ */
+char *umcexp_snapshot(umc_ctx_t *ctx, size_t *sz);
+
+#endif /* ifndef UMCEXP_H */
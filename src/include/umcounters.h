@@ -20,12 +20,46 @@
 
 // consts
 #define UMC_NAME_MAX 256
+// number of per-thread slots for sharded counters
+#define UMC_SHARDS 16
+// counters per chunk and max number of chunks
+#define UMC_CHUNK_SZ 256
+#define UMC_CHUNKS 1024
+// max number of labels per counter (labeled counters)
+#define UMC_LABELS_MAX 8
+// name arena block size
+#define UMC_ARENA_SZ 8192
+// number of indexed name segments ('.' separated)
+#define UMC_INDEX_DEPTH 4
+// number of one-second rate window buckets
+#define UMC_WIN_SZ 60
+// histogram linear sub-buckets per power of two (2^n)
+#define UMC_HIST_SUB_BITS 4
+#define UMC_HIST_SUB (1 << UMC_HIST_SUB_BITS)
+// histogram bucket count (64-bit values)
+#define UMC_HIST_SZ ((64 - UMC_HIST_SUB_BITS + 1) * UMC_HIST_SUB)
+
+// counter flags
+// - sharded (per-thread slots, lock-free updates,
+//   aggregated on read; incremental counters only)
+#define UMCF_SHARDED 0x01
 
 // types
 typedef struct umc_ctx umc_ctx_t;
 typedef struct umc umc_t;
+typedef struct umc_name umc_name_t;
+typedef struct umc_label umc_label_t;
+typedef struct umc_series umc_series_t;
+typedef struct umc_family umc_family_t;
+typedef struct umc_tnode umc_tnode_t;
+typedef struct umc_snap umc_snap_t;
 typedef struct umc_val umc_val_t;
 typedef struct umc_lag umc_lag_t;
+typedef struct umc_shard umc_shard_t;
+typedef struct umc_win umc_win_t;
+typedef struct umc_rates umc_rates_t;
+typedef struct umc_hist umc_hist_t;
+typedef struct umc_hist_stats umc_hist_stats_t;
 
 /**
  * Counter callback
@@ -43,7 +77,9 @@ enum umc_type
     /** Incremental */
     UMCT_INCREMENTAL = 0,
     /** Gauge (no rate) */
-    UMCT_GAUGE = 1
+    UMCT_GAUGE = 1,
+    /** Histogram (value distribution, no rate) */
+    UMCT_HISTOGRAM = 2
 };
 
 /**
@@ -57,15 +93,75 @@ struct umc_val {
 };
 
 /**
- * Counter descriptor
+ * Sharded counter slot (one cache line)
+ */
+struct umc_shard {
+    /** Accumulated value */
+    uint64_t value;
+} __attribute__((aligned(64)));
+
+/**
+ * Rate window (incremental counters)
+ */
+struct umc_win {
+    /** Per-second value deltas (ring) */
+    uint64_t buckets[UMC_WIN_SZ];
+    /** Second of the current bucket */
+    uint64_t sec;
+    /** Window start timestamp in nsec */
+    uint64_t start_nsec;
+    /** 1s, 10s and 60s EWMA (per-second values) */
+    double ewma[3];
+};
+
+/**
+ * Counter rates
+ */
+struct umc_rates {
+    /** Average rate over the last UMC_WIN_SZ seconds */
+    double win;
+    /** 1s EWMA */
+    double ewma_1s;
+    /** 10s EWMA */
+    double ewma_10s;
+    /** 60s EWMA */
+    double ewma_60s;
+};
+
+/**
+ * Log-linear histogram (lock-free recording)
+ */
+struct umc_hist {
+    /** Bucket counts */
+    uint64_t buckets[UMC_HIST_SZ];
+    /** Number of recorded values */
+    uint64_t count;
+    /** Sum of recorded values */
+    uint64_t sum;
+};
+
+/**
+ * Histogram statistics
+ */
+struct umc_hist_stats {
+    /** Number of recorded values */
+    uint64_t count;
+    /** Sum of recorded values */
+    uint64_t sum;
+    /** Maximum value */
+    uint64_t max;
+    /** Percentiles (bucket upper bounds) */
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+};
+
+/**
+ * Counter descriptor (hot data; stored in dense,
+ * cache-line aligned chunks, indexed by counter id)
  */
 struct umc {
-    /** Id string buffer */
-    char id[UMC_NAME_MAX];
-    /** id string pointer */
-    char *idp;
-    /** Counter type */
-    enum umc_type type;
     /** Values */
     struct {
         /** Last value */
@@ -77,12 +173,121 @@ struct umc {
         /** Value delta */
         int64_t delta;
     } values;
+    /** Counter type */
+    enum umc_type type;
+    /** Flags (UMCF_*) */
+    int flags;
+    /** id string pointer (interned) */
+    const char *idp;
+    /** Counter index */
+    uint32_t idx;
+    /** Per-thread slots (sharded counters) */
+    umc_shard_t *shards;
+    /** Rate window (incremental counters) */
+    umc_win_t *win;
+    /** Histogram (histogram counters) */
+    umc_hist_t *hist;
     /** Mutex */
     pthread_mutex_t mtx;
+} __attribute__((aligned(64)));
+
+/**
+ * Counter name index entry (cold data)
+ */
+struct umc_name {
+    /** Interned id string */
+    const char *id;
+    /** Counter */
+    umc_t *c;
 
     UT_hash_handle hh;
 };
 
+/**
+ * Counter label
+ */
+struct umc_label {
+    /** Label name */
+    const char *key;
+    /** Label value */
+    const char *value;
+};
+
+/**
+ * Labeled counter (family member)
+ */
+struct umc_series {
+    /** Label set hash */
+    uint64_t key;
+    /** Labels (sorted by name) */
+    umc_label_t labels[UMC_LABELS_MAX];
+    /** Number of labels */
+    int nr;
+    /** Counter */
+    umc_t *c;
+    /** Next series with the same hash */
+    umc_series_t *next;
+
+    UT_hash_handle hh;
+};
+
+/**
+ * Counter family (labeled counters sharing a name)
+ */
+struct umc_family {
+    /** Family name */
+    char *name;
+    /** Counter type */
+    enum umc_type type;
+    /** Counter flags (UMCF_*) */
+    int flags;
+    /** Series map (label set hash) */
+    umc_series_t *series;
+    /** Member counters (creation order) */
+    umc_t **counters;
+    /** Number of member counters */
+    uint32_t nr;
+    /** Member counters capacity */
+    uint32_t cap;
+    /** Lock */
+    pthread_rwlock_t lock;
+
+    UT_hash_handle hh;
+};
+
+/**
+ * Name index node (one '.' separated name segment); nodes
+ * and index arrays are never modified in place, readers
+ * do not lock
+ */
+struct umc_tnode {
+    /** Segment (points to counter id, not terminated) */
+    const char *seg;
+    /** Segment length */
+    uint32_t seg_sz;
+    /** Number of counters in subtree */
+    uint32_t nr;
+    /** Counter indexes in subtree (ascending) */
+    uint32_t *idx;
+    /** Counter indexes capacity */
+    uint32_t cap;
+    /** First child */
+    umc_tnode_t *child;
+    /** Next sibling */
+    umc_tnode_t *next;
+};
+
+/**
+ * Counter registry snapshot (counters created after the
+ * snapshot was taken are not visible)
+ */
+struct umc_snap {
+    /** Counter context */
+    umc_ctx_t *ctx;
+    /** Number of visible counters */
+    uint32_t nr;
+};
+
 /**
  * Lag measurement descriptor
  */
@@ -99,8 +304,22 @@ struct umc_lag {
  * Counter context
  */
 struct umc_ctx {
-    /** Counter map */
-    umc_t *counters;
+    /** Counter chunks (allocated on demand, never moved) */
+    umc_t *chunks[UMC_CHUNKS];
+    /** Number of counters */
+    uint32_t nr;
+    /** Name index */
+    umc_name_t *names;
+    /** Counter families */
+    umc_family_t *families;
+    /** Name prefix index (top level segments) */
+    umc_tnode_t *index;
+    /** Name prefix index incomplete (allocation failed) */
+    int index_err;
+    /** Name arena (current block) */
+    char *arena;
+    /** Name arena free space offset */
+    size_t arena_off;
     /** Mutex */
     pthread_mutex_t mtx;
 };
@@ -131,6 +350,43 @@ void umc_free_ctx(umc_ctx_t *ctx);
  */
 umc_t *umc_new_counter(umc_ctx_t *ctx, const char *id, enum umc_type type);
 
+/**
+ * Create new counter with flags
+ *
+ * @param[in]   ctx     Counter context
+ * @param[in]   id      New counter id
+ * @param[in]   type    Counter type
+ * @param[in]   flags   Counter flags (UMCF_*)
+ *
+ * @return      New counter object or the one already
+ *              bound to this id
+ */
+umc_t *umc_new_counter_ex(umc_ctx_t *ctx,
+                          const char *id,
+                          enum umc_type type,
+                          int flags);
+
+/**
+ * Get number of counters; counters are never removed, so
+ * counters [0, count) can be iterated with umc_at()
+ * without locking
+ *
+ * @param[in]   ctx     Counter context
+ *
+ * @return      Number of counters
+ */
+uint32_t umc_count(umc_ctx_t *ctx);
+
+/**
+ * Get counter by index
+ *
+ * @param[in]   ctx     Counter context
+ * @param[in]   idx     Counter index
+ *
+ * @return      Counter object pointer or NULL
+ */
+umc_t *umc_at(umc_ctx_t *ctx, uint32_t idx);
+
 /**
  * Get counter object
  *
@@ -175,7 +431,8 @@ void umc_inc(umc_t *c, uint64_t val);
 umc_t *umc_get_set(umc_ctx_t *ctx, const char *id, uint64_t val, bool lock);
 
 /**
- * Set counter value
+ * Set counter value (histograms record the value
+ * without locking)
  *
  * @param[in]   c       Counter object
  * @param[in]   val     New counter value
@@ -183,27 +440,169 @@ umc_t *umc_get_set(umc_ctx_t *ctx, const char *id, uint64_t val, bool lock);
 void umc_set(umc_t *c, uint64_t val);
 
 /**
- * Match counter id by using the wildcard pattern
+ * Get histogram statistics
+ *
+ * @param[in]   c       Counter object
+ * @param[out]  hs      Histogram statistics
+ *
+ * @return      0 on success, 1 if not a histogram
+ *              (hs is zeroed)
+ */
+int umc_get_hist(umc_t *c, umc_hist_stats_t *hs);
+
+/**
+ * Get histogram percentile
+ *
+ * @param[in]   c       Counter object
+ * @param[in]   q       Percentile (0 - 100)
+ *
+ * @return      Upper bound of the percentile's bucket
+ *              (capped at max), or 0
+ */
+uint64_t umc_get_percentile(umc_t *c, double q);
+
+/**
+ * Get current counter value without locking (sharded
+ * counters are summed, counter is not modified)
+ *
+ * @param[in]   c       Counter object
+ *
+ * @return      Counter value
+ */
+uint64_t umc_peek(umc_t *c);
+
+/**
+ * Restore incremental counter value (e.g. after restart);
+ * rate and rate window are not affected
+ *
+ * @param[in]   c       Counter object
+ * @param[in]   val     Restored value
+ */
+void umc_restore(umc_t *c, uint64_t val);
+
+/**
+ * Match counter id by using the wildcard pattern; matching
+ * runs on a registry snapshot and the context mutex is not
+ * held while callbacks are running (callbacks can create
+ * new counters)
  *
  * @param[in]   ctx     Counter context
  * @param[in]   ptrn    String pattern
- * @param[in]   lock    Lock mutex
+ * @param[in]   lock    Unused (kept for compatibility)
  * @param[in]   cb      Callback function to call if matched
  * @param[in]   arg     User data to pass to callback function
  */
 int
 umc_match(umc_ctx_t *ctx, const char *ptrn, bool lock, umc_cb_t cb, void *arg);
 
+/**
+ * Take counter registry snapshot (counters are never moved
+ * or removed, the snapshot does not need to be released)
+ *
+ * @param[in]   ctx     Counter context
+ * @param[out]  snap    Snapshot
+ */
+void umc_snapshot(umc_ctx_t *ctx, umc_snap_t *snap);
+
+/**
+ * Match snapshot counters by using the wildcard pattern;
+ * patterns with a literal prefix ("a.b.*") only scan the
+ * counters under the matching prefix index node
+ *
+ * @param[in]   snap    Snapshot
+ * @param[in]   ptrn    String pattern
+ * @param[in]   cb      Callback function to call if matched
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      Number of matched counters
+ */
+int umc_snap_match(const umc_snap_t *snap,
+                   const char *ptrn,
+                   umc_cb_t cb,
+                   void *arg);
+
+/**
+ * Create counter family (labeled counters); member
+ * counters are regular counters named
+ * name{key="value",...} with labels sorted by name
+ *
+ * @param[in]   ctx     Counter context
+ * @param[in]   name    Family name
+ * @param[in]   type    Counter type
+ * @param[in]   flags   Counter flags (UMCF_*)
+ *
+ * @return      New family or the one already bound to
+ *              this name
+ */
+umc_family_t *umc_new_family(umc_ctx_t *ctx,
+                             const char *name,
+                             enum umc_type type,
+                             int flags);
+
+/**
+ * Get counter family
+ *
+ * @param[in]   ctx     Counter context
+ * @param[in]   name    Family name
+ *
+ * @return      Family or NULL
+ */
+umc_family_t *umc_get_family(umc_ctx_t *ctx, const char *name);
+
+/**
+ * Get or create family member (label set lookup is
+ * hashed, label order does not matter); the returned
+ * counter can be kept as a handle
+ *
+ * @param[in]   ctx     Counter context
+ * @param[in]   f       Counter family
+ * @param[in]   labels  Labels
+ * @param[in]   nr      Number of labels (max UMC_LABELS_MAX)
+ *
+ * @return      Counter object pointer or NULL
+ */
+umc_t *umc_family_get(umc_ctx_t *ctx,
+                      umc_family_t *f,
+                      const umc_label_t *labels,
+                      int nr);
+
+/**
+ * Iterate family members (no pattern matching)
+ *
+ * @param[in]   f       Counter family
+ * @param[in]   cb      Callback function
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      Number of member counters
+ */
+int umc_family_iter(umc_family_t *f, umc_cb_t cb, void *arg);
+
 /**
  * Calculate rate value (per-second value)
  *
  * @param[in]   c       Counter object
- * @param[in]   lock    Lock mutex
+ * @param[in]   lock    Lock mutex (sharded counters are
+ *                      aggregated only if locked)
  *
  * @return      Counter rate value
  */
 double umc_get_rate(umc_t *c, bool lock);
 
+/**
+ * Get windowed and EWMA rates (per-second values); idle
+ * periods are decayed at read time.
+ * Sharded counters are accounted for when aggregated
+ * (on read), so their windows have read granularity.
+ *
+ * @param[in]   c       Counter object
+ * @param[out]  r       Counter rates
+ * @param[in]   lock    Lock mutex
+ *
+ * @return      0 on success, 1 if rates are not available
+ *              (r is zeroed)
+ */
+int umc_get_rates(umc_t *c, umc_rates_t *r, bool lock);
+
 /**
  * Start lag measurement
  *
@@ -0,0 +1,122 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef UMCPST_H
+#define UMCPST_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <umcounters.h>
+
+// consts
+#define UMCPST_MAGIC 0x50434d55
+#define UMCPST_VERSION 1
+// default number of counter slots
+#define UMCPST_MAX 4096
+// default sync interval (msec)
+#define UMCPST_INTERVAL 1000
+
+// types
+typedef struct umcpst_hdr umcpst_hdr_t;
+typedef struct umcpst_slot umcpst_slot_t;
+typedef struct umcpst umcpst_t;
+
+/**
+ * Store header
+ */
+struct umcpst_hdr {
+    /** Magic (UMCPST_MAGIC) */
+    uint32_t magic;
+    /** Layout version (UMCPST_VERSION) */
+    uint32_t version;
+    /** Slot size in bytes */
+    uint32_t slot_sz;
+    /** Number of slots */
+    uint32_t capacity;
+    /** Number of used slots */
+    uint32_t nr;
+    /** Sync generation */
+    uint64_t gen;
+} __attribute__((aligned(64)));
+
+/**
+ * Counter slot
+ */
+struct umcpst_slot {
+    /** Counter type */
+    uint32_t type;
+    /** Counter flags (UMCF_*) */
+    uint32_t flags;
+    /** Last synced value */
+    uint64_t value;
+    /** Counter id */
+    char name[UMC_NAME_MAX];
+} __attribute__((aligned(64)));
+
+/**
+ * Persistent counter store
+ */
+struct umcpst {
+    /** Counter context */
+    umc_ctx_t *ctx;
+    /** Store file path */
+    char *path;
+    /** Mapped store */
+    umcpst_hdr_t *hdr;
+    /** Mapped size */
+    size_t sz;
+    /** Number of restored counters */
+    uint32_t restored;
+    /** Sync interval (msec) */
+    int interval;
+    /** Stop flag */
+    int stop;
+    /** Sync thread */
+    pthread_t th;
+};
+
+/**
+ * Attach persistent counter store and start sync thread;
+ * counters found in the store are re-created (slot index
+ * matches the counter index) and incremental counters get
+ * their stored values back. Values are copied to the store
+ * by the sync thread, update paths are not affected.
+ *
+ * @param[in]   ctx         Counter context (no counters yet)
+ * @param[in]   path        Store file path
+ * @param[in]   capacity    Number of slots for a new store
+ *                          (0 = UMCPST_MAX)
+ * @param[in]   interval    Sync interval in msec
+ *                          (0 = UMCPST_INTERVAL)
+ *
+ * @return      Store or NULL on error
+ */
+umcpst_t *
+umcpst_new(umc_ctx_t *ctx, const char *path, uint32_t capacity, int interval);
+
+/**
+ * Stop sync thread, sync values and unmap store (the store
+ * file is kept)
+ *
+ * @param[in]   pst     Store
+ */
+void umcpst_free(umcpst_t *pst);
+
+/**
+ * Copy counters to store and schedule write-back (called
+ * periodically by sync thread)
+ *
+ * @param[in]   pst     Store
+ * @param[in]   wait    Wait for write-back to complete
+ */
+void umcpst_sync(umcpst_t *pst, bool wait);
+
+#endif /* ifndef UMCPST_H */
@@ -0,0 +1,202 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef UMCSHM_H
+#define UMCSHM_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <umcounters.h>
+
+// consts
+#define UMCSHM_MAGIC 0x534d4355
+#define UMCSHM_VERSION 1
+// default number of counter slots
+#define UMCSHM_MAX 4096
+// default publish interval (msec)
+#define UMCSHM_INTERVAL 1000
+
+// types
+typedef struct umcshm_hdr umcshm_hdr_t;
+typedef struct umcshm_slot umcshm_slot_t;
+typedef struct umcshm umcshm_t;
+typedef struct umcshm_reader umcshm_reader_t;
+
+/**
+ * Slot callback (reader)
+ *
+ * @param[in]   s   Consistent copy of counter slot
+ * @param[in]   arg User data
+ */
+typedef void (*umcshm_cb_t)(const umcshm_slot_t *s, void *arg);
+
+/**
+ * Segment header
+ */
+struct umcshm_hdr {
+    /** Magic (UMCSHM_MAGIC) */
+    uint32_t magic;
+    /** Layout version (UMCSHM_VERSION) */
+    uint32_t version;
+    /** Slot size in bytes */
+    uint32_t slot_sz;
+    /** Number of slots */
+    uint32_t capacity;
+    /** Number of published slots */
+    uint32_t nr;
+    /** Publisher pid */
+    uint32_t pid;
+    /** Publish generation */
+    uint64_t gen;
+    /** Last publish timestamp in nsec (monotonic) */
+    uint64_t ts_nsec;
+} __attribute__((aligned(64)));
+
+/**
+ * Counter slot (seqlock protected)
+ */
+struct umcshm_slot {
+    /** Sequence (odd while being written) */
+    uint32_t seq;
+    /** Counter type */
+    uint32_t type;
+    /** Counter id */
+    char name[UMC_NAME_MAX];
+    /** Last value */
+    uint64_t value;
+    /** Maximum value */
+    uint64_t max;
+    /** Rate (last update) */
+    double rate;
+    /** Windowed rate */
+    double rate_win;
+    /** EWMA rates */
+    double ewma_1s;
+    double ewma_10s;
+    double ewma_60s;
+    /** Histogram count and percentiles */
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+} __attribute__((aligned(64)));
+
+/**
+ * Segment publisher
+ */
+struct umcshm {
+    /** Counter context */
+    umc_ctx_t *ctx;
+    /** Segment file path */
+    char *path;
+    /** Mapped segment */
+    umcshm_hdr_t *hdr;
+    /** Mapped size */
+    size_t sz;
+    /** Publish interval (msec) */
+    int interval;
+    /** Stop flag */
+    int stop;
+    /** Publisher thread */
+    pthread_t th;
+};
+
+/**
+ * Segment reader
+ */
+struct umcshm_reader {
+    /** Mapped segment */
+    umcshm_hdr_t *hdr;
+    /** Mapped size */
+    size_t sz;
+};
+
+/**
+ * Create counter segment and start publisher thread;
+ * counters are copied to the segment by the publisher,
+ * update paths are not affected (slot index matches the
+ * counter index)
+ *
+ * @param[in]   ctx         Counter context
+ * @param[in]   path        Segment file path (e.g. /dev/shm/umink.cnt)
+ * @param[in]   capacity    Number of slots (0 = UMCSHM_MAX)
+ * @param[in]   interval    Publish interval in msec (0 = UMCSHM_INTERVAL)
+ *
+ * @return      Publisher or NULL on error
+ */
+umcshm_t *
+umcshm_new(umc_ctx_t *ctx, const char *path, uint32_t capacity, int interval);
+
+/**
+ * Stop publisher, unmap and remove segment file
+ *
+ * @param[in]   shm     Publisher
+ */
+void umcshm_free(umcshm_t *shm);
+
+/**
+ * Publish counters (called periodically by publisher thread)
+ *
+ * @param[in]   shm     Publisher
+ */
+void umcshm_publish(umcshm_t *shm);
+
+/**
+ * Open counter segment (read-only)
+ *
+ * @param[in]   path    Segment file path
+ *
+ * @return      Reader or NULL on error (missing file or
+ *              incompatible layout)
+ */
+umcshm_reader_t *umcshm_open(const char *path);
+
+/**
+ * Close counter segment
+ *
+ * @param[in]   rd      Reader
+ */
+void umcshm_close(umcshm_reader_t *rd);
+
+/**
+ * Get number of published slots
+ *
+ * @param[in]   rd      Reader
+ *
+ * @return      Number of slots
+ */
+uint32_t umcshm_count(umcshm_reader_t *rd);
+
+/**
+ * Read consistent copy of counter slot
+ *
+ * @param[in]   rd      Reader
+ * @param[in]   idx     Slot index
+ * @param[out]  out     Slot copy
+ *
+ * @return      0 on success, 1 if index is invalid, 2 if
+ *              slot is being written (retry later)
+ */
+int umcshm_read(umcshm_reader_t *rd, uint32_t idx, umcshm_slot_t *out);
+
+/**
+ * Read all published slots
+ *
+ * @param[in]   rd      Reader
+ * @param[in]   cb      Callback function
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      Number of slots read
+ */
+int umcshm_read_all(umcshm_reader_t *rd, umcshm_cb_t cb, void *arg);
+
+#endif /* ifndef UMCSHM_H */
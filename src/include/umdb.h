@@ -14,10 +14,36 @@
 #include <sqlite3.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <uthash.h>
+
+// consts
+// max number of cached prepared statements (per connection)
+#define UMDB_STMT_MAX 64
+// max number of read connections (per manager); threads
+// above the limit use the writer connection
+#define UMDB_READERS_MAX 16
+// busy timeout (msec)
+#define UMDB_BUSY_TIMEOUT 1000
+// read retries when DB is still busy after busy timeout
+#define UMDB_READ_RETRIES 3
+// write-behind defaults: commit interval (msec) and batch size
+#define UMDB_WB_INTERVAL 1000
+#define UMDB_WB_BATCH 256
+// pending writes limit (multiple of batch size); writers
+// commit synchronously when reached
+#define UMDB_WB_LIMIT 8
 
 // types
 typedef struct umdb_mngr_d umdb_mngrd_t;
 typedef struct umdb_uauth_d umdb_uauth_d_t;
+typedef struct umdb_stmt umdb_stmt_t;
+typedef struct umdb_conn umdb_conn_t;
+typedef struct umdb_store umdb_store_t;
+typedef struct umdb_wbe umdb_wbe_t;
+typedef struct umdb_wb umdb_wb_t;
+typedef struct umdb_watch umdb_watch_t;
 
 /**
  * Query type
@@ -37,13 +63,154 @@ enum query_type
     /** Custom authentication */
     USER_CMD_SPECIFIC_AUTH,
     /** Get user */
-    USER_GET
+    USER_GET,
+    /** Set custom storage data */
+    STORE_SET,
+    /** Get custom storage data */
+    STORE_GET,
+    /** Delete custom storage data */
+    STORE_DEL,
+    /** Find custom storage data by key prefix */
+    STORE_SCAN,
+    /** Increment custom storage data */
+    STORE_INCR,
+    /** Compare-and-set custom storage data */
+    STORE_CAS,
+    /** Set custom storage data if missing */
+    STORE_CAS_NEW
+};
+
+/**
+ * Custom storage data callback (multi-key operations)
+ *
+ * @param[in]   k       Data key
+ * @param[in]   v       Data value
+ * @param[in]   arg     User data
+ */
+typedef void (*umdb_kv_cb_t)(const char *k, const char *v, void *arg);
+
+/**
+ * Key change callback; called with DB manager locks held,
+ * the DB manager must not be used from it
+ *
+ * @param[in]   w       Matching watch
+ * @param[in]   k       Data key
+ * @param[in]   old     Old value (NULL if missing)
+ * @param[in]   v       New value (NULL if deleted)
+ */
+typedef void (*umdb_watch_cb_t)(const umdb_watch_t *w,
+                                const char *k,
+                                const char *old,
+                                const char *v);
+
+/** Cached prepared statement */
+struct umdb_stmt {
+    /** Cache key (query type and table name) */
+    char *key;
+    /** Prepared statement */
+    sqlite3_stmt *stmt;
+
+    UT_hash_handle hh;
+};
+
+/** Read connection (owned by one thread at a time) */
+struct umdb_conn {
+    /** sqlite db pointer (read-only) */
+    sqlite3 *db;
+    /** Prepared statement cache */
+    umdb_stmt_t *stmts;
+    /** In use by a thread */
+    int used;
+    /** Next connection */
+    umdb_conn_t *next;
+};
+
+/** Initialized custom storage */
+struct umdb_store {
+    /** Storage (table) name */
+    char *name;
+
+    UT_hash_handle hh;
+};
+
+/** Write-behind entry (pending custom storage set or delete) */
+struct umdb_wbe {
+    /** Key (storage name and data key, '\0' separated) */
+    char *key;
+    /** Key size */
+    size_t key_sz;
+    /** Data value (NULL for deleted key) */
+    char *v;
+
+    UT_hash_handle hh;
+};
+
+/** Write-behind state */
+struct umdb_wb {
+    /** Pending sets (overlay, insertion order) */
+    umdb_wbe_t *pending;
+    /** Sets being committed (still visible to readers) */
+    umdb_wbe_t *flushing;
+    /** Commit interval (msec) */
+    int interval;
+    /** Batch size (commit before interval expires) */
+    unsigned int batch;
+    /** Stop flag */
+    int stop;
+    /** Overlay lock */
+    pthread_mutex_t mtx;
+    /** Commit lock (one batch at a time) */
+    pthread_mutex_t flush_mtx;
+    /** Commit thread wakeup */
+    pthread_cond_t cond;
+    /** Commit thread */
+    pthread_t th;
+};
+
+/** Key change watch */
+struct umdb_watch {
+    /** Storage name */
+    char *db;
+    /** Data key or key prefix */
+    char *key;
+    /** Data key or key prefix size */
+    size_t key_sz;
+    /** Prefix match */
+    bool prefix;
+    /** Watch name (e.g. signal name) */
+    char *name;
+    /** Callback */
+    umdb_watch_cb_t cb;
+    /** User data */
+    void *arg;
+    /** Next watch */
+    umdb_watch_t *next;
 };
 
 /** DB descriptor */
 struct umdb_mngr_d {
-    /** sqlite db pointer */
+    /** sqlite db pointer (writer, shared) */
     sqlite3 *db;
+    /** Prepared statement cache (least recently used first) */
+    umdb_stmt_t *stmts;
+    /** DB path (read connections) */
+    char *path;
+    /** In-memory DB (writer connection only) */
+    bool mem;
+    /** Read connections */
+    umdb_conn_t *readers;
+    /** Number of read connections */
+    int readers_nr;
+    /** Thread-local read connection key */
+    pthread_key_t rd_key;
+    /** Initialized custom storages */
+    umdb_store_t *stores;
+    /** Statement cache lock (held while a statement is in use) */
+    pthread_mutex_t mtx;
+    /** Write-behind state (NULL if disabled) */
+    umdb_wb_t *wb;
+    /** Key change watches (append only, lock-free readers) */
+    umdb_watch_t *watches;
 };
 
 /** User auth-result descriptor */
@@ -59,7 +226,8 @@ struct umdb_uauth_d {
 };
 
 /**
- * Create new DB manager
+ * Create new DB manager; writes use a shared connection,
+ * reads use thread-local read-only connections
  *
  * @param[in]   db  Database name
  * @param[in]   mem In-memory flag
@@ -102,7 +270,9 @@ int umdb_mngr_uauth(umdb_mngrd_t *m,
 int umdb_mngr_uget(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u);
 
 /**
- * Init custom user storage
+ * Init custom user storage (initialized storages are
+ * remembered; a storage is initialized again after a
+ * set/get failed because its table was removed)
  *
  * @param[in]   m   DB manager
  * @param[in]   n   User DB name
@@ -143,4 +313,171 @@ int umdb_mngr_store_get(umdb_mngrd_t *m,
                         char **out,
                         size_t *out_sz);
 
+/**
+ * Get multiple custom storage values; all keys are read in
+ * one transaction (consistent view) using one statement
+ *
+ * @param[in]   m       DB manager
+ * @param[in]   db      User DB name
+ * @param[in]   keys    Data keys
+ * @param[in]   nr      Number of keys
+ * @param[in]   cb      Callback function (called for each
+ *                      existing key)
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_store_mget(umdb_mngrd_t *m,
+                         const char *db,
+                         const char **keys,
+                         size_t nr,
+                         umdb_kv_cb_t cb,
+                         void *arg);
+
+/**
+ * Set multiple custom storage values in one transaction
+ * (write-behind mode: one overlay update, committed in the
+ * same batch)
+ *
+ * @param[in]   m       DB manager
+ * @param[in]   db      User DB name
+ * @param[in]   keys    Data keys
+ * @param[in]   values  Data values
+ * @param[in]   nr      Number of keys
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_store_mset(umdb_mngrd_t *m,
+                         const char *db,
+                         const char **keys,
+                         const char **values,
+                         size_t nr);
+
+/**
+ * Find custom storage values by key prefix (ordered by
+ * key); pending write-behind data is merged with
+ * committed data
+ *
+ * @param[in]   m       DB manager
+ * @param[in]   db      User DB name
+ * @param[in]   p       Key prefix
+ * @param[in]   limit   Max number of values (0 = no limit)
+ * @param[in]   cb      Callback function
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_store_scan(umdb_mngrd_t *m,
+                         const char *db,
+                         const char *p,
+                         int limit,
+                         umdb_kv_cb_t cb,
+                         void *arg);
+
+/**
+ * Delete custom storage data (missing key is not an error)
+ *
+ * @param[in]   m   DB manager
+ * @param[in]   db  User DB name
+ * @param[in]   k   Data key
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_store_del(umdb_mngrd_t *m, const char *db, const char *k);
+
+/**
+ * Atomic increment of custom storage data (missing value
+ * is created, non-numeric value is treated as 0); one
+ * upsert statement (write-behind mode: overlay update)
+ *
+ * @param[in]   m       DB manager
+ * @param[in]   db      User DB name
+ * @param[in]   k       Data key
+ * @param[in]   delta   Increment
+ * @param[out]  out     New value (can be NULL)
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_store_incr(umdb_mngrd_t *m,
+                         const char *db,
+                         const char *k,
+                         int64_t delta,
+                         int64_t *out);
+
+/**
+ * Atomic compare-and-set of custom storage data; one
+ * statement (write-behind mode: overlay update)
+ *
+ * @param[in]   m       DB manager
+ * @param[in]   db      User DB name
+ * @param[in]   k       Data key
+ * @param[in]   old     Expected value (NULL = key must not exist)
+ * @param[in]   v       New value
+ *
+ * @return      0 if value was set, 8 if current value does
+ *              not match or error code
+ */
+int umdb_mngr_store_cas(umdb_mngrd_t *m,
+                        const char *db,
+                        const char *k,
+                        const char *old,
+                        const char *v);
+
+/**
+ * Watch custom storage key changes; every set, delete,
+ * increment or compare-and-set that changes the value of a
+ * matching key calls the watch callback with the old and
+ * new value (registering the same watch again is a no-op)
+ *
+ * @param[in]   m       DB manager
+ * @param[in]   db      User DB name
+ * @param[in]   k       Data key or key prefix ending with '*'
+ * @param[in]   name    Watch name
+ * @param[in]   cb      Callback function
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_watch(umdb_mngrd_t *m,
+                    const char *db,
+                    const char *k,
+                    const char *name,
+                    umdb_watch_cb_t cb,
+                    void *arg);
+
+/**
+ * Enable WAL journal mode (synchronous=NORMAL); not
+ * available for in-memory databases
+ *
+ * @param[in]   m   DB manager
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_wal(umdb_mngrd_t *m);
+
+/**
+ * Enable write-behind mode for custom storage data; sets
+ * are kept in an in-memory overlay (also used by gets) and
+ * committed by a background thread in batched transactions
+ * every interval or when batch size is reached. Data set
+ * within the last interval is lost on crash.
+ *
+ * @param[in]   m           DB manager
+ * @param[in]   interval    Commit interval in msec
+ *                          (0 = UMDB_WB_INTERVAL)
+ * @param[in]   batch       Batch size (0 = UMDB_WB_BATCH)
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_wb_start(umdb_mngrd_t *m, int interval, unsigned int batch);
+
+/**
+ * Commit pending custom storage sets (write-behind mode)
+ *
+ * @param[in]   m   DB manager
+ *
+ * @return      0 for success or error code
+ */
+int umdb_mngr_wb_flush(umdb_mngrd_t *m);
+
 #endif /* ifndef UMDB */
@@ -13,6 +13,7 @@
 
 #include <stdbool.h>
 #include <pthread.h>
+#include <time.h>
 #include <utarray.h>
 #include <uthash.h>
 
@@ -22,6 +23,7 @@ typedef struct umplg_mngrd umplg_mngrd_t;
 typedef struct umplg_idata umplg_idata_t;
 typedef struct umplg_mngr umplg_mngr_t;
 typedef struct umplg_sh umplg_sh_t;
+typedef struct umplg_auth umplg_auth_t;
 typedef struct umplg_data_std_items umplg_data_std_items_t;
 typedef struct umplg_data_std_item umplg_data_std_item_t;
 typedef struct umplg_data_std umplg_data_std_t;
@@ -34,6 +36,7 @@ typedef struct umplg_cmd_map umplg_cmd_map_t;
 #define UMPLG_CMD_HNDLR       "run"
 #define UMPLG_CMD_HNDLR_LOCAL "run_local"
 #define UMPLG_CMD_LST         "COMMANDS"
+#define UMPLG_AUTH_USR_MAX    64
 
 /**
  * Plugin CMD ids
@@ -244,6 +247,18 @@ struct umplg_data_std_item {
     UT_hash_handle hh;
 };
 
+/** User authentication context */
+struct umplg_auth {
+    /** User id (-1 if unknown) */
+    int uid;
+    /** User flags (auth level) */
+    int flags;
+    /** User name */
+    char usr[UMPLG_AUTH_USR_MAX];
+    /** Expiry timestamp (0 = no expiry) */
+    time_t exp;
+};
+
 /** Standard data items */
 struct umplg_data_std_items {
     /** Items hashmap */
@@ -421,6 +436,54 @@ int umplg_proc_signal(umplg_mngr_t *pm,
                       int usr_flags,
                       void *args);
 
+/**
+ * Process signal with user authentication context
+ *
+ * @param[in]   pm          Plugin manager
+ * @param[in]   s           Signal name
+ * @param[in]   d_in        Signal input data
+ * @param[out]  d_out       Signal output buffer
+ * @param[out]  out_sz      Size of data in output buffer
+ * @param[in]   auth        User authentication context (NULL = no user)
+ * @param[in]   args        User data
+ *
+ * @return      0 for success or error code
+ */
+int umplg_proc_signal_auth(umplg_mngr_t *pm,
+                           const char *s,
+                           umplg_data_std_t *d_in,
+                           char **d_out,
+                           size_t *out_sz,
+                           const umplg_auth_t *auth,
+                           void *args);
+
+/**
+ * Get user authentication context of the signal
+ * currently running in the calling thread
+ *
+ * @return      User authentication context or NULL
+ */
+const umplg_auth_t *umplg_auth_current(void);
+
+/**
+ * Get user authentication context from auth JSON string
+ * ({"uid": 1, "flags": 1, "username": "admin", "exp": 0});
+ * parsed once per string and cached
+ *
+ * @param[in]   s           Auth JSON string
+ * @param[out]  out         User authentication context
+ *                          (uid -1 if malformed)
+ *
+ * @return      0 for success or error code
+ */
+int umplg_auth_get(const char *s, umplg_auth_t *out);
+
+/**
+ * Free cached user authentication contexts (cache is
+ * process wide, it is also freed when library is unloaded)
+ */
+void umplg_auth_clear(void);
+
 void umplg_match_signal(umplg_mngr_t *pm,
                         const char *ptrn,
                         umplg_shfn_match_t cb,
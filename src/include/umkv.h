@@ -0,0 +1,254 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef UMKV_H
+#define UMKV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <uthash.h>
+
+// consts
+#define UMKV_STRIPES_BITS 6
+#define UMKV_STRIPES (1 << UMKV_STRIPES_BITS)
+
+// types
+typedef struct umkv umkv_t;
+typedef struct umkv_item umkv_item_t;
+typedef struct umkv_stripe umkv_stripe_t;
+
+/**
+ * Key/value callback (multi-key operations); called with
+ * copies of the data, after stripe locks are released
+ *
+ * @param[in]   k       Data key
+ * @param[in]   k_sz    Data key size
+ * @param[in]   v       Data value ('\0' terminated)
+ * @param[in]   v_sz    Data value size (without terminator)
+ * @param[in]   arg     User data
+ */
+typedef void (*umkv_cb_t)(const char *k,
+                          size_t k_sz,
+                          const char *v,
+                          size_t v_sz,
+                          void *arg);
+
+/**
+ * Key/value item descriptor
+ */
+struct umkv_item {
+    /** Composite key (table name + '\0' + key) */
+    char *key;
+    /** Composite key size */
+    size_t key_sz;
+    /** Value buffer (binary safe, '\0' terminated) */
+    char *value;
+    /** Value size (without terminator) */
+    size_t value_sz;
+    /** Hash handle */
+    UT_hash_handle hh;
+};
+
+/**
+ * Lock stripe descriptor
+ */
+struct umkv_stripe {
+    /** Items hashed to this stripe */
+    umkv_item_t *items;
+    /** Stripe lock */
+    pthread_rwlock_t lock;
+} __attribute__((aligned(64)));
+
+/**
+ * In-memory key/value store descriptor
+ */
+struct umkv {
+    /** Lock stripes */
+    umkv_stripe_t stripes[UMKV_STRIPES];
+};
+
+/**
+ * Create new in-memory key/value store
+ *
+ * @return      New key/value store
+ */
+umkv_t *umkv_new(void);
+
+/**
+ * Free key/value store
+ *
+ * @param[in]   kv  Key/value store
+ */
+void umkv_free(umkv_t *kv);
+
+/**
+ * Set value
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   k       Data key
+ * @param[in]   k_sz    Data key size
+ * @param[in]   v       Data value
+ * @param[in]   v_sz    Data value size
+ *
+ * @return      0 for success or error code
+ */
+int umkv_set(umkv_t *kv,
+             const char *tbl,
+             const char *k,
+             size_t k_sz,
+             const char *v,
+             size_t v_sz);
+
+/**
+ * Get value copy
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   k       Data key
+ * @param[in]   k_sz    Data key size
+ * @param[out]  out     Output buffer ('\0' terminated, free with free())
+ * @param[out]  out_sz  Output data size (without terminator)
+ *
+ * @return      0 for success or error code
+ */
+int umkv_get(umkv_t *kv,
+             const char *tbl,
+             const char *k,
+             size_t k_sz,
+             char **out,
+             size_t *out_sz);
+
+/**
+ * Delete value
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   k       Data key
+ * @param[in]   k_sz    Data key size
+ *
+ * @return      0 for success or error code
+ */
+int umkv_del(umkv_t *kv, const char *tbl, const char *k, size_t k_sz);
+
+/**
+ * Get multiple values (consistent view, all involved
+ * stripes are locked at once)
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   keys    Data keys
+ * @param[in]   k_szs   Data key sizes
+ * @param[in]   nr      Number of keys
+ * @param[in]   cb      Callback function (called for each
+ *                      existing key)
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      0 for success or error code
+ */
+int umkv_mget(umkv_t *kv,
+              const char *tbl,
+              const char **keys,
+              const size_t *k_szs,
+              size_t nr,
+              umkv_cb_t cb,
+              void *arg);
+
+/**
+ * Set multiple values (atomic, all involved stripes are
+ * locked at once)
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   keys    Data keys
+ * @param[in]   k_szs   Data key sizes
+ * @param[in]   values  Data values
+ * @param[in]   v_szs   Data value sizes
+ * @param[in]   nr      Number of keys
+ *
+ * @return      0 for success or error code
+ */
+int umkv_mset(umkv_t *kv,
+              const char *tbl,
+              const char **keys,
+              const size_t *k_szs,
+              const char **values,
+              const size_t *v_szs,
+              size_t nr);
+
+/**
+ * Find values by key prefix (unordered); all stripes are
+ * read locked while matching values are copied
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   p       Key prefix
+ * @param[in]   p_sz    Key prefix size
+ * @param[in]   limit   Max number of values (0 = no limit)
+ * @param[in]   cb      Callback function
+ * @param[in]   arg     User data to pass to callback function
+ *
+ * @return      Number of values found or -1 on error
+ */
+int umkv_scan(umkv_t *kv,
+              const char *tbl,
+              const char *p,
+              size_t p_sz,
+              int limit,
+              umkv_cb_t cb,
+              void *arg);
+
+/**
+ * Atomic increment (missing value is created, non-numeric
+ * value is treated as 0)
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   k       Data key
+ * @param[in]   k_sz    Data key size
+ * @param[in]   delta   Increment
+ * @param[out]  out     New value (can be NULL)
+ *
+ * @return      0 for success or error code
+ */
+int umkv_incr(umkv_t *kv,
+              const char *tbl,
+              const char *k,
+              size_t k_sz,
+              int64_t delta,
+              int64_t *out);
+
+/**
+ * Atomic compare-and-set
+ *
+ * @param[in]   kv      Key/value store
+ * @param[in]   tbl     Table (namespace) name
+ * @param[in]   k       Data key
+ * @param[in]   k_sz    Data key size
+ * @param[in]   old     Expected value (NULL = key must not exist)
+ * @param[in]   old_sz  Expected value size
+ * @param[in]   v       New value
+ * @param[in]   v_sz    New value size
+ *
+ * @return      0 if value was set, 3 if current value does
+ *              not match or error code
+ */
+int umkv_cas(umkv_t *kv,
+             const char *tbl,
+             const char *k,
+             size_t k_sz,
+             const char *old,
+             size_t old_sz,
+             const char *v,
+             size_t v_sz);
+
+#endif /* ifndef UMKV_H */
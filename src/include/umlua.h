@@ -16,6 +16,10 @@
 #include <time.h>
 #include <utarray.h>
 #include <umdb.h>
+#include <umkv.h>
+
+// all standard libraries
+#define UMLUA_LIBS_ALL 0xffffffff
 
 /****************/
 /* LUA ENV data */
@@ -65,9 +69,11 @@ struct lua_env_d {
     // dbm
     struct {
         // in-memory
-        umdb_mngrd_t *mem;
+        umkv_t *mem;
         // permanent
         umdb_mngrd_t *perm;
+        // permanent key change dispatcher
+        struct umlua_watchd *watch;
     } dbm;
     // mem options
     struct {
@@ -76,6 +82,23 @@ struct lua_env_d {
         // uncached lua state
         bool conserve_mem;
     } mem;
+    // shared lua state mode (isolated _ENV
+    // sandbox on scheduler coroutine)
+    struct {
+        // run in shared lua state
+        bool enabled;
+        // one-time execution finished
+        bool done;
+        // next run (monotonic, msec)
+        uint64_t next;
+    } sbox;
+    // lua state profile
+    struct {
+        // standard libraries (UMLUA_LIBS_* bitmask)
+        uint32_t libs;
+        // M sub-modules (NULL = all)
+        UT_array *modules;
+    } profile;
     // hashable
     UT_hash_handle hh;
 };
@@ -88,9 +111,90 @@ struct lua_env_mngr {
     struct lua_env_d *envs;
     // shared dbm
     umdb_mngrd_t *dbm_perm;
-    umdb_mngrd_t *dbm_mem;
+    umkv_t *dbm_mem;
+    // permanent dbm key change dispatcher
+    struct umlua_watchd *dbm_watch;
     // lock
     pthread_mutex_t mtx;
 };
 
+/************************/
+/* LUA signal call data */
+/************************/
+struct lua_sig_call_d {
+    // caller's lua state
+    struct lua_State *L;
+    // structured payload stack index
+    // in caller's lua state (0 = none)
+    int pld_idx;
+    // result was left on the caller's
+    // lua stack (same lua state, no copy)
+    bool in_place;
+    // result is MessagePack encoded
+    bool res_mp;
+};
+
+/*******************************/
+/* LUA signal args (get_args) */
+/*******************************/
+int umlua_args_totable(struct lua_State *L, int idx);
+
+/*****************************************/
+/* LUA value serialization (MessagePack) */
+/*****************************************/
+int umlua_mp_encode(struct lua_State *L, int idx, char **out, size_t *out_sz);
+int umlua_mp_decode(struct lua_State *L, const char *b, size_t sz);
+
+/****************************/
+/* LUA JSON module (M.json) */
+/****************************/
+int umlua_json_open(struct lua_State *L);
+
+/*********************************************/
+/* LUA DB key change dispatcher (M.db_watch) */
+/*********************************************/
+// pending key change notification
+struct umlua_wev {
+    // dedup key (signal, db and data key, '\0' separated)
+    char *key;
+    // dedup key size
+    size_t key_sz;
+    // old value before first pending change (NULL = missing)
+    char *old;
+    // latest value (NULL = deleted)
+    char *v;
+    // hashable (insertion order)
+    UT_hash_handle hh;
+};
+
+// key change dispatcher
+struct umlua_watchd {
+    // plugin manager
+    umplg_mngr_t *pm;
+    // pending notifications (deduplicated)
+    struct umlua_wev *pending;
+    // stop flag
+    bool stop;
+    // queue lock
+    pthread_mutex_t mtx;
+    // dispatcher wakeup (new or processed notification)
+    pthread_cond_t cond;
+    // notification being processed
+    bool busy;
+    // queue full (drop is logged once per overflow)
+    bool full;
+    // dropped notifications (perf counter)
+    umc_t *dropped;
+    // dispatcher thread
+    pthread_t th;
+};
 
+struct umlua_watchd *umlua_watch_new(umplg_mngr_t *pm);
+void umlua_watch_stop(struct umlua_watchd *wd);
+void umlua_watch_free(struct umlua_watchd *wd);
+int umlua_watch_add(struct umlua_watchd *wd,
+                    umdb_mngrd_t *dbm,
+                    const char *db,
+                    const char *k,
+                    const char *sig);
+void umlua_watch_wait(struct umlua_watchd *wd);
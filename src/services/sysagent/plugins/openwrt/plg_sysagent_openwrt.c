@@ -106,22 +106,17 @@ run_signal(struct ubus_context *ctx,
         char *id = blobmsg_get_string(tb[RUN_SIGNAL_ID]);
         char *args = "";
         char *auth = "";
-        int uflags = 0;
+        umplg_auth_t auth_ctx;
+        const umplg_auth_t *auth_p = NULL;
         // check args
         if (tb[RUN_SIGNAL_ARGS] != NULL) {
             args = blobmsg_get_string(tb[RUN_SIGNAL_ARGS]);
         }
-        // check auth
+        // check auth (parsed once per auth string and cached)
         if (tb[RUN_SIGNAL_AUTH] != NULL) {
             auth = blobmsg_get_string(tb[RUN_SIGNAL_AUTH]);
-            // check auth (already checked for errors)
-            if (auth != NULL) {
-                json_object *j = json_tokener_parse(auth);
-                if (j != NULL) {
-                    json_object *j_usr = json_object_object_get(j, "flags");
-                    uflags = json_object_get_int(j_usr);
-                    json_object_put(j);
-                }
+            if (auth != NULL && umplg_auth_get(auth, &auth_ctx) == 0) {
+                auth_p = &auth_ctx;
             }
         }
 
@@ -141,7 +136,13 @@ run_signal(struct ubus_context *ctx,
         umplg_stdd_items_add(&e_d, &items);
 
         // run signal (set)
-        int r = umplg_proc_signal(umplgm, id, &e_d, &buff, &b_sz, uflags, NULL);
+        int r = umplg_proc_signal_auth(umplgm,
+                                       id,
+                                       &e_d,
+                                       &buff,
+                                       &b_sz,
+                                       auth_p,
+                                       NULL);
 
         switch (r) {
             case UMPLG_RES_SUCCESS:
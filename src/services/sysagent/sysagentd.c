@@ -19,6 +19,9 @@
 #include <dirent.h>
 #include <json_tokener.h>
 #include <umcounters.h>
+#include <umcshm.h>
+#include <umcexp.h>
+#include <umcpst.h>
 #ifdef ENABLE_COAP
 #include <umrpc.h>
 #endif
@@ -26,6 +29,8 @@
 // daemon name and description
 const char *UMD_TYPE = "umsysagent";
 const char *UMD_DESCRIPTION = "umINK System Agent";
+// default persistent counter sync interval (msec, flash wear)
+#define SYSAGENT_PST_INTERVAL 60000
 
 // filter for scandir
 typedef int (*fs_dir_filter_t)(const struct dirent *);
@@ -43,6 +48,14 @@ typedef struct {
     umplg_mngr_t *pm;
     struct json_object *cfg;
     umc_ctx_t *perf;
+    const char *shm_f;
+    int shm_intvl;
+    umcshm_t *shm;
+    const char *exp_addr;
+    umcexp_t *exp;
+    const char *pst_f;
+    int pst_intvl;
+    umcpst_t *pst;
 } sysagentdd_t;
 
 // help
@@ -57,6 +70,15 @@ print_help()
            "-v    display version",
            "-D    start in debug mode");
     printf("%s\n %s\n", "Plugins:", "--plugins-cfg    Plugins configuration file");
+    printf("%s\n %s\n %s\n %s\n %s\n %s\n",
+           "Counters:",
+           "--counters-shm   Counter segment file (e.g. /dev/shm/umink.cnt)",
+           "--counters-shm-interval  Segment publish interval in msec "
+           "(default 1000)",
+           "--counters-exp   OpenMetrics address (unix:/path or tcp:host:port)",
+           "--counters-pst   Persistent counter store file",
+           "--counters-pst-interval  Store sync interval in msec "
+           "(default 60000)");
 }
 
 // process args
@@ -66,6 +88,11 @@ proc_args(umdaemon_t *umd, int argc, char **argv)
     int opt;
     int option_index = 0;
     struct option long_options[] = { { "plugins-cfg", required_argument, 0, 0 },
+                                     { "counters-shm", required_argument, 0, 0 },
+                                     { "counters-exp", required_argument, 0, 0 },
+                                     { "counters-pst", required_argument, 0, 0 },
+                                     { "counters-pst-interval", required_argument, 0, 0 },
+                                     { "counters-shm-interval", required_argument, 0, 0 },
                                      { 0, 0, 0, 0 } };
 
     // mandatory param count
@@ -86,6 +113,38 @@ proc_args(umdaemon_t *umd, int argc, char **argv)
                 dd->plg_cfg_f = optarg;
                 ++mpc;
                 break;
+            // counters-shm
+            case 1:
+                dd->shm_f = optarg;
+                break;
+            // counters-exp
+            case 2:
+                dd->exp_addr = optarg;
+                break;
+            // counters-pst
+            case 3:
+                dd->pst_f = optarg;
+                break;
+            // counters-pst-interval
+            case 4:
+                dd->pst_intvl = atoi(optarg);
+                if (dd->pst_intvl <= 0) {
+                    printf("%s\n",
+                           "ERROR: Invalid persistent counter store "
+                           "sync interval!");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            // counters-shm-interval
+            case 5:
+                dd->shm_intvl = atoi(optarg);
+                if (dd->shm_intvl <= 0) {
+                    printf("%s\n",
+                           "ERROR: Invalid counter segment publish "
+                           "interval!");
+                    exit(EXIT_FAILURE);
+                }
+                break;
             default:
                 break;
             }
@@ -243,6 +302,14 @@ main(int argc, char **argv)
     sysagentdd_t dd = { .pcfg = NULL,
                         .plg_cfg_f = NULL,
                         .plg_pth = NULL,
+                        .shm_f = NULL,
+                        .shm_intvl = 0,
+                        .shm = NULL,
+                        .exp_addr = NULL,
+                        .exp = NULL,
+                        .pst_f = NULL,
+                        .pst_intvl = SYSAGENT_PST_INTERVAL,
+                        .pst = NULL,
                         .pm = umplg_new_mngr() };
     umd->data = &dd;
     dd.pm->cfg = dd.cfg;
@@ -253,6 +320,16 @@ main(int argc, char **argv)
     signal(SIGTERM, &umd_signal_handler);
     // start daemon
     umd_start(umd);
+    // persistent counters (before any counter is created)
+    if (dd.pst_f != NULL) {
+        dd.pst = umcpst_new(umd->perf, dd.pst_f, 0, dd.pst_intvl);
+        if (dd.pst == NULL) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "Cannot attach persistent counter store [%s]",
+                    dd.pst_f);
+        }
+    }
     // load config
     load_cfg(&dd);
     // init lua core
@@ -261,6 +338,26 @@ main(int argc, char **argv)
     init_plugins(dd.pm, dd.plg_pth);
     // start lua envs
     umlua_start(dd.pm);
+    // counter segment publisher
+    if (dd.shm_f != NULL) {
+        dd.shm = umcshm_new(umd->perf, dd.shm_f, 0, dd.shm_intvl);
+        if (dd.shm == NULL) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "Cannot create counter segment [%s]",
+                    dd.shm_f);
+        }
+    }
+    // OpenMetrics exporter
+    if (dd.exp_addr != NULL) {
+        dd.exp = umcexp_new(umd->perf, dd.exp_addr);
+        if (dd.exp == NULL) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "Cannot start counter exporter [%s]",
+                    dd.exp_addr);
+        }
+    }
     // loop until terminated
     umd_loop(umd);
     // shutdown plugins (phase 0)
@@ -270,6 +367,9 @@ main(int argc, char **argv)
     // shutdown plugins (phase 1)
     umplg_terminate_all(dd.pm, 1);
     // cleanup
+    umcexp_free(dd.exp);
+    umcshm_free(dd.shm);
+    umcpst_free(dd.pst);
     json_object_put(dd.cfg);
     umc_free_ctx(umd->perf);
     umplg_free_mngr(dd.pm);
@@ -19,12 +19,14 @@
 #include <uthash.h>
 #include <time.h>
 #include <json_object.h>
+#include <json_tokener.h>
 #include <luaconf.h>
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
 #include <utarray.h>
 #include <umdb.h>
+#include <umkv.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -76,9 +78,19 @@ int mink_lua_get_args(lua_State *L);
 int mink_lua_do_cmd_call(lua_State *L);
 int mink_lua_do_perf_inc(lua_State *L);
 int mink_lua_do_perf_set(lua_State *L);
+int mink_lua_do_counter(lua_State *L);
 int mink_lua_do_perf_match(lua_State *L);
+int mink_lua_do_perf_family(lua_State *L);
 int mink_lua_do_db_set(lua_State *L);
 int mink_lua_do_db_get(lua_State *L);
+int mink_lua_do_db_mget(lua_State *L);
+int mink_lua_do_db_mset(lua_State *L);
+int mink_lua_do_db_scan(lua_State *L);
+int mink_lua_do_db_del(lua_State *L);
+int mink_lua_do_db_incr(lua_State *L);
+int mink_lua_do_db_cas(lua_State *L);
+int mink_lua_do_db_watch(lua_State *L);
+int mink_lua_do_auth(lua_State *L);
 
 // registered lua module methods
 static const struct luaL_Reg mink_lualib[] = {
@@ -87,9 +99,19 @@ static const struct luaL_Reg mink_lualib[] = {
     { "cmd_call", &mink_lua_do_cmd_call },
     { "perf_inc", &mink_lua_do_perf_inc },
     { "perf_set", &mink_lua_do_perf_set },
+    { "counter", &mink_lua_do_counter },
     { "perf_match", &mink_lua_do_perf_match },
+    { "perf_family", &mink_lua_do_perf_family },
     { "db_set", &mink_lua_do_db_set },
     { "db_get", &mink_lua_do_db_get },
+    { "db_mget", &mink_lua_do_db_mget },
+    { "db_mset", &mink_lua_do_db_mset },
+    { "db_scan", &mink_lua_do_db_scan },
+    { "db_del", &mink_lua_do_db_del },
+    { "db_incr", &mink_lua_do_db_incr },
+    { "db_cas", &mink_lua_do_db_cas },
+    { "db_watch", &mink_lua_do_db_watch },
+    { "auth", &mink_lua_do_auth },
     { NULL, NULL }
 };
 
@@ -97,6 +119,8 @@ static const struct luaL_Reg mink_lualib[] = {
 /* globals */
 /***********/
 struct lua_env_mngr *lenv_mngr = NULL;
+// lua state creation perf counters
+static struct perf_d state_perf;
 
 /*******************/
 /* Lua env manager */
@@ -108,6 +132,7 @@ lenvm_new()
     lem->envs = NULL;
     lem->dbm_mem = NULL;
     lem->dbm_perm = NULL;
+    lem->dbm_watch = NULL;
     pthread_mutex_init(&lem->mtx, NULL);
     return lem;
 }
@@ -203,17 +228,17 @@ lenvm_process_envs(struct lua_env_mngr *lem, void (*f)(struct lua_env_d *env))
 }
 
 static void
-init_counters(const char *id, const char *pfx, struct perf_d *p)
+init_counters(const char *id, const char *pfx, struct perf_d *p, int flags)
 {
     char perf_id[UMC_NAME_MAX];
     snprintf(perf_id, sizeof(perf_id), "lua.%s.%s.count", pfx, id);
-    p->cnt = umc_new_counter(UMD->perf, perf_id, UMCT_INCREMENTAL);
+    p->cnt = umc_new_counter_ex(UMD->perf, perf_id, UMCT_INCREMENTAL, flags);
 
     snprintf(perf_id, sizeof(perf_id), "lua.%s.%s.error", pfx, id);
-    p->err = umc_new_counter(UMD->perf, perf_id, UMCT_INCREMENTAL);
+    p->err = umc_new_counter_ex(UMD->perf, perf_id, UMCT_INCREMENTAL, flags);
 
     snprintf(perf_id, sizeof(perf_id), "lua.%s.%s.lag", pfx, id);
-    p->lag = umc_new_counter(UMD->perf, perf_id, UMCT_GAUGE);
+    p->lag = umc_new_counter(UMD->perf, perf_id, UMCT_HISTOGRAM);
 }
 
 static void
@@ -222,10 +247,206 @@ init_mink_lua_module(lua_State *L)
     // init mink module table
     luaL_newlib(L, mink_lualib);
 
+    // M.json sub-module
+    lua_pushstring(L, "json");
+    umlua_json_open(L);
+    lua_settable(L, -3);
+
     // add to globals
     lua_setglobal(L, "M");
 }
 
+/******************************/
+/* Lua state profile (libs/M) */
+/******************************/
+static const struct {
+    // config name
+    const char *name;
+    // module name
+    const char *mod;
+    lua_CFunction open;
+} lua_std_libs[] = {
+    { "base", "_G", &luaopen_base },
+    { LUA_LOADLIBNAME, LUA_LOADLIBNAME, &luaopen_package },
+#if LUA_VERSION_NUM >= 502
+    { LUA_COLIBNAME, LUA_COLIBNAME, &luaopen_coroutine },
+#endif
+    { LUA_TABLIBNAME, LUA_TABLIBNAME, &luaopen_table },
+    { LUA_IOLIBNAME, LUA_IOLIBNAME, &luaopen_io },
+    { LUA_OSLIBNAME, LUA_OSLIBNAME, &luaopen_os },
+    { LUA_STRLIBNAME, LUA_STRLIBNAME, &luaopen_string },
+    { LUA_MATHLIBNAME, LUA_MATHLIBNAME, &luaopen_math },
+#if LUA_VERSION_NUM >= 503
+    { LUA_UTF8LIBNAME, LUA_UTF8LIBNAME, &luaopen_utf8 },
+#endif
+    { LUA_DBLIBNAME, LUA_DBLIBNAME, &luaopen_debug },
+};
+
+// get standard library bit (0 if unknown)
+static uint32_t
+lua_lib_bit(const char *name)
+{
+    for (int i = 0; i < sizeof(lua_std_libs) / sizeof(lua_std_libs[0]); i++) {
+        if (strcmp(lua_std_libs[i].name, name) == 0) {
+            return 1 << i;
+        }
+    }
+    return 0;
+}
+
+// open standard libraries not already present in lua state
+static void
+lua_state_open_libs(lua_State *L, uint32_t libs)
+{
+    // base library is always required
+    libs |= 1;
+    lua_pushstring(L, "mink_libs");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    uint32_t loaded = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    if ((libs & ~loaded) == 0) {
+        return;
+    }
+    // no profile; all libraries, including the ones not in
+    // lua_std_libs (e.g. bit32, LuaJIT's bit, jit and ffi)
+    if (libs == UMLUA_LIBS_ALL) {
+        luaL_openlibs(L);
+        loaded = UMLUA_LIBS_ALL;
+    }
+    for (int i = 0; i < sizeof(lua_std_libs) / sizeof(lua_std_libs[0]); i++) {
+        if (!(libs & (1 << i)) || (loaded & (1 << i))) {
+            continue;
+        }
+#if LUA_VERSION_NUM >= 502
+        luaL_requiref(L, lua_std_libs[i].mod, lua_std_libs[i].open, 1);
+        lua_pop(L, 1);
+#else
+        lua_pushcfunction(L, lua_std_libs[i].open);
+        lua_pushstring(L, lua_std_libs[i].mod);
+        lua_call(L, 1, 0);
+#endif
+        loaded |= 1 << i;
+    }
+    lua_pushstring(L, "mink_libs");
+    lua_pushnumber(L, loaded);
+    lua_settable(L, LUA_REGISTRYINDEX);
+}
+
+// init M sub-modules not already present in lua state
+static void
+lua_state_open_modules(struct lua_env_d *env, lua_State *L)
+{
+    lua_pushstring(L, "mink_mods");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    // all sub-modules already loaded
+    lua_pushstring(L, "*");
+    lua_rawget(L, -2);
+    if (lua_toboolean(L, -1)) {
+        lua_pop(L, 2);
+        return;
+    }
+    lua_pop(L, 1);
+
+    // all sub-modules
+    if (env->profile.modules == NULL) {
+        umplg_proc_signal(env->pm,
+                          "@init_lua_sub_modules",
+                          NULL,
+                          NULL,
+                          NULL,
+                          0,
+                          L);
+        lua_pushstring(L, "*");
+        lua_pushboolean(L, 1);
+        lua_rawset(L, -3);
+        lua_pop(L, 1);
+        return;
+    }
+
+    // selected sub-modules
+    char sig[128];
+    char **m = NULL;
+    while ((m = utarray_next(env->profile.modules, m))) {
+        lua_pushstring(L, *m);
+        lua_rawget(L, -2);
+        int loaded = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        if (loaded) {
+            continue;
+        }
+        snprintf(sig, sizeof(sig), "@init_lua_sub_module:%s", *m);
+        umplg_proc_signal(env->pm, sig, NULL, NULL, NULL, 0, L);
+        lua_pushstring(L, *m);
+        lua_pushboolean(L, 1);
+        lua_rawset(L, -3);
+    }
+    lua_pop(L, 1);
+}
+
+// make sure libs and sub-modules required by env are present
+// in lua state (per-thread signal states are shared between envs)
+static void
+lua_state_ensure(struct lua_env_d *env, lua_State *L)
+{
+    lua_pushstring(L, "mink_envs");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    if (env->name != NULL) {
+        lua_pushstring(L, env->name);
+        lua_rawget(L, -2);
+        int done = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        if (done) {
+            lua_pop(L, 1);
+            return;
+        }
+        lua_pushstring(L, env->name);
+        lua_pushboolean(L, 1);
+        lua_rawset(L, -3);
+    }
+    lua_pop(L, 1);
+
+    lua_state_open_libs(L, env->profile.libs);
+    lua_state_open_modules(env, L);
+}
+
+// create new lua state for env
+static lua_State *
+lua_state_new(struct lua_env_d *env)
+{
+    umc_lag_t lag;
+    umc_lag_start(&lag);
+
+    lua_State *L = luaL_newstate();
+    if (L == NULL) {
+        umc_inc(state_perf.err, 1);
+        return NULL;
+    }
+
+    // profile registry
+    lua_pushstring(L, "mink_libs");
+    lua_pushnumber(L, 0);
+    lua_settable(L, LUA_REGISTRYINDEX);
+    lua_pushstring(L, "mink_mods");
+    lua_newtable(L);
+    lua_settable(L, LUA_REGISTRYINDEX);
+    lua_pushstring(L, "mink_envs");
+    lua_newtable(L);
+    lua_settable(L, LUA_REGISTRYINDEX);
+
+    // init umink lua module
+    init_mink_lua_module(L);
+
+    // init libs and other submodules
+    lua_state_ensure(env, L);
+
+    // update perf
+    umc_lag_end(&lag);
+    umc_inc(state_perf.cnt, 1);
+    umc_set(state_perf.lag, lag.ts_diff);
+
+    return L;
+}
+
 
 // load script for lua env
 static int
@@ -268,16 +489,11 @@ lua_env_load_script(struct lua_env_d *env, lua_State *L)
 static int
 lua_env_setup(struct lua_env_d *env, lua_State **L)
 {
-    *L = luaL_newstate();
-
-    // init lua
-    luaL_openlibs(*L);
-
-    // init umink lua module
-    init_mink_lua_module(*L);
-
-    // init other submodules
-    umplg_proc_signal(env->pm, "@init_lua_sub_modules", NULL, NULL, NULL, 0, *L);
+    // new lua state (libs, M module and submodules)
+    *L = lua_state_new(env);
+    if (*L == NULL) {
+        return 1;
+    }
 
     // table key = "mink_pm"
     // =================================
@@ -300,6 +516,13 @@ lua_env_setup(struct lua_env_d *env, lua_State **L)
     lua_pushlightuserdata(*L, env->dbm.perm);
     lua_settable(*L, LUA_REGISTRYINDEX);
 
+    // table key = "mink_dbm_watch"
+    // =================================
+    // registry["mink_dbm_watch"] = watch
+    lua_pushstring(*L, "mink_dbm_watch");
+    lua_pushlightuserdata(*L, env->dbm.watch);
+    lua_settable(*L, LUA_REGISTRYINDEX);
+
     return 0;
 }
 
@@ -346,7 +569,7 @@ th_lua_env(void *arg)
 #endif
 
     // perf counters
-    init_counters(env->name, "environment", &env->env_perf);
+    init_counters(env->name, "environment", &env->env_perf, 0);
 
     // lua state
     lua_State *L = NULL;
@@ -454,6 +677,277 @@ th_lua_env(void *arg)
     return NULL;
 }
 
+/************************************/
+/* Shared LUA state (env sandboxes) */
+/************************************/
+// max scheduler sleep (msec)
+#define LUA_SBOX_TICK_MAX 100
+
+// envs attached to shared lua state
+static UT_array *sbox_envs = NULL;
+static pthread_t sbox_th;
+
+// monotonic time in msec
+static uint64_t
+lua_sbox_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// resume coroutine (lua version independent)
+static int
+lua_sbox_resume(lua_State *co)
+{
+#if LUA_VERSION_NUM >= 504
+    int nres = 0;
+    return lua_resume(co, NULL, 0, &nres);
+#elif LUA_VERSION_NUM >= 502
+    return lua_resume(co, NULL, 0);
+#else
+    return lua_resume(co, 0);
+#endif
+}
+
+// push env sandbox record (registry["mink_sbox"][name]):
+// - env: isolated globals (reads fall back to shared _G,
+//        env._G = env)
+// - fn:  cached chunk bound to env
+// - co:  yielded coroutine
+static void
+lua_sbox_push(struct lua_env_d *env, lua_State *L)
+{
+    lua_pushstring(L, "mink_sbox");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    lua_pushstring(L, env->name);
+    lua_rawget(L, -2);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 3);
+        // env = setmetatable({}, { __index = _G })
+        lua_pushstring(L, "env");
+        lua_newtable(L);
+        lua_createtable(L, 0, 1);
+        lua_pushstring(L, "__index");
+#if LUA_VERSION_NUM >= 502
+        lua_pushglobaltable(L);
+#else
+        lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+        lua_rawset(L, -3);
+        lua_setmetatable(L, -2);
+        // _G writes stay in the sandbox
+        lua_pushstring(L, "_G");
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -3);
+        lua_rawset(L, -3);
+        // save record
+        lua_pushstring(L, env->name);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -4);
+    }
+    lua_remove(L, -2);
+}
+
+// push env chunk bound to sandbox globals (record at index rec)
+static int
+lua_sbox_push_chunk(struct lua_env_d *env, lua_State *L, int rec)
+{
+    // cached chunk
+    if (!env->mem.conserve_mem) {
+        lua_pushstring(L, "fn");
+        lua_rawget(L, rec);
+        if (!lua_isnil(L, -1)) {
+            return 0;
+        }
+        lua_pop(L, 1);
+    }
+    if (lua_env_load_script(env, L) != 0) {
+        lua_pop(L, 1);
+        return 1;
+    }
+    // bind chunk to sandbox globals
+    lua_pushstring(L, "env");
+    lua_rawget(L, rec);
+#if LUA_VERSION_NUM >= 502
+    if (lua_setupvalue(L, -2, 1) == NULL) {
+        lua_pop(L, 1);
+    }
+#else
+    lua_setfenv(L, -2);
+#endif
+    // cache chunk
+    if (!env->mem.conserve_mem) {
+        lua_pushstring(L, "fn");
+        lua_pushvalue(L, -2);
+        lua_rawset(L, rec);
+    }
+    return 0;
+}
+
+// run (or resume) env on its coroutine; true if yielded
+static bool
+lua_sbox_run(struct lua_env_d *env, lua_State *L)
+{
+    // sandbox record
+    int top = lua_gettop(L);
+    lua_sbox_push(env, L);
+    int rec = lua_gettop(L);
+
+    // resume yielded coroutine or start a new one
+    lua_pushstring(L, "co");
+    lua_rawget(L, rec);
+    lua_State *co = lua_tothread(L, -1);
+    if (co == NULL) {
+        lua_pop(L, 1);
+        co = lua_newthread(L);
+        if (lua_sbox_push_chunk(env, L, rec) != 0) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "plg_lua: [cannot load Lua environment (%s)]",
+                    env->name);
+            umc_inc(env->env_perf.err, 1);
+            lua_settop(L, top);
+            return false;
+        }
+        lua_xmove(L, co, 1);
+    }
+
+    // lag measurement
+    umc_lag_t lag;
+    umc_lag_start(&lag);
+    int r = lua_sbox_resume(co);
+    umc_lag_end(&lag);
+    umc_set(env->env_perf.lag, lag.ts_diff);
+
+    // keep yielded coroutine (thread is at the top of the stack)
+    lua_pushstring(L, "co");
+    if (r == LUA_YIELD) {
+        lua_settop(co, 0);
+        lua_pushvalue(L, -2);
+
+    } else {
+        if (r != 0) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "plg_lua: [%s]:%s",
+                    env->name,
+                    lua_tostring(co, -1));
+            umc_inc(env->env_perf.err, 1);
+
+        } else {
+            umc_inc(env->env_perf.cnt, 1);
+        }
+        lua_pushnil(L);
+    }
+    lua_rawset(L, rec);
+    lua_settop(L, top);
+
+    // mem optimizations
+    if (env->mem.agressive_gc) {
+        lua_gc(L, LUA_GCCOLLECT, 0);
+    }
+    return (r == LUA_YIELD);
+}
+
+// shared lua state scheduler
+static void *
+th_lua_sbox(void *arg)
+{
+    UT_array *envs = arg;
+    struct lua_env_d **env = utarray_front(envs);
+
+#if defined(__GNUC__) && defined(__linux__)
+#    if __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 12
+    pthread_setname_np(sbox_th, "lua_sbox");
+#    endif
+#endif
+
+    // shared lua state
+    lua_State *L = NULL;
+    if (lua_env_setup(*env, &L) != 0) {
+        umd_log(UMD,
+                UMD_LLT_ERROR,
+                "plg_lua: [cannot create shared Lua environment]");
+        return NULL;
+    }
+    lua_pushstring(L, "mink_sbox");
+    lua_newtable(L);
+    lua_settable(L, LUA_REGISTRYINDEX);
+
+    // libs, submodules and perf counters of attached envs
+    env = NULL;
+    while ((env = utarray_next(envs, env))) {
+        lua_state_ensure(*env, L);
+        init_counters((*env)->name, "environment", &(*env)->env_perf, 0);
+        (*env)->sbox.next = 0;
+        umd_log(UMD,
+                UMD_LLT_INFO,
+                "plg_lua: [starting '%s' Lua environment, with '%s' attached "
+                "(shared)]",
+                (*env)->name,
+                (*env)->path);
+    }
+
+    // run
+    while (!umd_is_terminating()) {
+        uint64_t now = lua_sbox_now();
+        uint64_t wake = now + LUA_SBOX_TICK_MAX;
+        size_t running = 0;
+        env = NULL;
+        while ((env = utarray_next(envs, env))) {
+            struct lua_env_d *e = *env;
+            if (e->sbox.done) {
+                continue;
+            }
+            ++running;
+            if (e->sbox.next <= now) {
+                // yielded, resume on next tick
+                if (lua_sbox_run(e, L)) {
+                    e->sbox.next = now + 1;
+
+                // one-time only
+                } else if (e->interval == 0) {
+                    e->sbox.done = true;
+                    continue;
+
+                // next iteration
+                } else {
+                    e->sbox.next = e->interval < UINT64_MAX - now ?
+                                       now + e->interval :
+                                       UINT64_MAX;
+                }
+            }
+            if (e->sbox.next < wake) {
+                wake = e->sbox.next;
+            }
+        }
+        // all one-time envs finished
+        if (running == 0) {
+            break;
+        }
+        // sleep until next run
+        now = lua_sbox_now();
+        if (wake > now) {
+            uint64_t ms = wake - now;
+            struct timespec st = { ms / 1000, (ms % 1000) * 1000000 };
+            nanosleep(&st, NULL);
+        }
+    }
+
+    // remove shared lua state
+    lua_close(L);
+    env = NULL;
+    while ((env = utarray_next(envs, env))) {
+        umd_log(UMD,
+                UMD_LLT_INFO,
+                "plg_lua: [stopping '%s' Lua environment]",
+                (*env)->name);
+    }
+    return NULL;
+}
+
 /*****************************/
 /* lua signal handler (term) */
 /*****************************/
@@ -533,29 +1027,15 @@ lua_sig_setup(umplg_sh_t *shd, lua_State **L)
     // get lua env
     struct lua_env_d **env = utarray_eltptr(shd->args, 1);
 
-    // lua state
-    *L = luaL_newstate();
-    if (!L) {
+    // lua state (libs, M module and submodules)
+    *L = lua_state_new(*env);
+    if (*L == NULL) {
         umd_log(UMD,
                 UMD_LLT_ERROR,
                 "plg_lua: [cannot create Lua environment (%s)]",
                 (*env)->name);
         return 1;
     }
-    // init lua
-    luaL_openlibs(*L);
-
-    // init umink lua module
-    init_mink_lua_module(*L);
-
-    // init other submodules
-    umplg_proc_signal((*env)->pm,
-                      "@init_lua_sub_modules",
-                      NULL,
-                      NULL,
-                      NULL,
-                      0,
-                      *L);
 
     // table key = "mink_pm"
     // =================================
@@ -578,6 +1058,13 @@ lua_sig_setup(umplg_sh_t *shd, lua_State **L)
     lua_pushlightuserdata(*L, (*env)->dbm.perm);
     lua_settable(*L, LUA_REGISTRYINDEX);
 
+    // table key = "mink_dbm_watch"
+    // =================================
+    // registry["mink_dbm_watch"] = watch
+    lua_pushstring(*L, "mink_dbm_watch");
+    lua_pushlightuserdata(*L, (*env)->dbm.watch);
+    lua_settable(*L, LUA_REGISTRYINDEX);
+
     return 0;
 }
 
@@ -590,7 +1077,8 @@ lua_sig_hndlr_init(umplg_sh_t *shd)
 
     // init counters
     struct perf_d **perf = utarray_eltptr(shd->args, 2);
-    init_counters((*env)->name, "signal", *perf);
+    // signal counters are updated from many threads (sharded)
+    init_counters((*env)->name, "signal", *perf, UMCF_SHARDED);
 
     // success
     return 0;
@@ -603,6 +1091,28 @@ tls_dtor(void *arg)
     lua_close((lua_State *)arg);
 }
 
+// push structured M.signal payload to handler's lua state
+static int
+lua_sig_push_payload(lua_State *L, struct lua_sig_call_d *call)
+{
+    // same lua state, no conversion
+    if (call->L == L) {
+        lua_pushvalue(L, call->pld_idx);
+        return 0;
+    }
+    // different lua state (same thread, caller is
+    // blocked in M.signal); use MessagePack
+    char *b = NULL;
+    size_t sz = 0;
+    int r = umlua_mp_encode(call->L, call->pld_idx, &b, &sz);
+    if (r != 0) {
+        return r;
+    }
+    r = umlua_mp_decode(L, b, sz);
+    free(b);
+    return r;
+}
+
 // lua signal handler (run)
 static int
 lua_sig_hndlr_run(umplg_sh_t *shd,
@@ -613,11 +1123,16 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
 {
     // thread local storage
     static __thread int Lref;
+    // signal call generation (M.get_args() view validation)
+    static __thread uint64_t Lgen;
     lua_State *L = pthread_getspecific(tls_key);
 
     // get lua env
     struct lua_env_d **env = utarray_eltptr(shd->args, 1);
 
+    // M.signal call data (NULL if not called from lua)
+    struct lua_sig_call_d *call = args;
+
     // crete per-thread lua state
     if(L == NULL){
         // setup lua state
@@ -634,9 +1149,16 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
         lua_pushstring(L, "mink_stdd");
         lua_newtable(L);
         lua_settable(L, LUA_REGISTRYINDEX);
+        lua_pushstring(L, "mink_sgen");
+        lua_newtable(L);
+        lua_settable(L, LUA_REGISTRYINDEX);
         lua_pushstring(L, "mink_sig_cache");
         lua_newtable(L);
         lua_settable(L, LUA_REGISTRYINDEX);
+        // - structured (lua value) arguments for signal handlers
+        lua_pushstring(L, "mink_sargs");
+        lua_newtable(L);
+        lua_settable(L, LUA_REGISTRYINDEX);
     }
 
     // check if current per-thread lua state contains the current signal
@@ -651,6 +1173,8 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
         // not found, preload
         if (lua_isnil(L, -1)) {
             lua_pop(L, 1);
+            // libs and submodules required by env
+            lua_state_ensure(*env, L);
             lua_pushstring(L, shd->id);
             if (lua_sig_load_script(shd, L) != 0) {
                 // pop error message, sig cache table and signal id
@@ -688,6 +1212,8 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
 
     // load script each time if conserving memory
     if ((*env)->mem.conserve_mem) {
+        // libs and submodules required by env
+        lua_state_ensure(*env, L);
         if (lua_sig_load_script(shd, L) != 0) {
             lua_pop(L, 1);
             return UMPLG_RES_SIG_SETUP_FAILED;
@@ -714,6 +1240,24 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
     lua_pushlightuserdata(L, d_in);
     lua_settable(L, -3);
     lua_remove(L, -1);
+    lua_pushstring(L, "mink_sgen");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    lua_pushnumber(L, Lref);
+    lua_pushnumber(L, ++Lgen);
+    lua_settable(L, -3);
+    lua_remove(L, -1);
+
+    // set structured input argument for this signal (via global registry)
+    if (call != NULL && call->pld_idx != 0) {
+        lua_pushstring(L, "mink_sargs");
+        lua_gettable(L, LUA_REGISTRYINDEX);
+        lua_pushnumber(L, Lref);
+        if (lua_sig_push_payload(L, call) != 0) {
+            lua_pushnil(L);
+        }
+        lua_settable(L, -3);
+        lua_remove(L, -1);
+    }
 
     // get perf counters
     struct perf_d **perf = utarray_eltptr(shd->args, 2);
@@ -731,6 +1275,11 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
     // lag measurement end
     umc_lag_end(&lag);
 
+    // M.get_args() view result would outlive its signal (copied)
+    if (r == 0 && umlua_args_totable(L, -1)) {
+        lua_replace(L, -2);
+    }
+
     // remove input arguments for this signal(via global registry)
     lua_pushstring(L, "mink_stdd");
     lua_gettable(L, LUA_REGISTRYINDEX);
@@ -738,6 +1287,20 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
     lua_pushnil(L);
     lua_settable(L, -3);
     lua_remove(L, -1);
+    lua_pushstring(L, "mink_sgen");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    lua_pushnumber(L, Lref);
+    lua_pushnil(L);
+    lua_settable(L, -3);
+    lua_remove(L, -1);
+    if (call != NULL && call->pld_idx != 0) {
+        lua_pushstring(L, "mink_sargs");
+        lua_gettable(L, LUA_REGISTRYINDEX);
+        lua_pushnumber(L, Lref);
+        lua_pushnil(L);
+        lua_settable(L, -3);
+        lua_remove(L, -1);
+    }
 
     // - dec current thread's signal reference counter
     // - used for proper signal arguments handling in case of signal recursion
@@ -765,10 +1328,36 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
         lua_gc(L, LUA_GCCOLLECT, 0);
     }
 
+    // nested M.signal call from the same lua state; leave the
+    // result (any lua value) on the caller's stack
+    if (call != NULL && call->L == L) {
+        call->in_place = true;
+        shd->running = false;
+        pthread_mutex_unlock(&shd->mtx);
+        return UMPLG_RES_SUCCESS;
+    }
+
+    // M.signal call from another lua state; tables and booleans
+    // are passed as MessagePack
+    if (call != NULL && (lua_istable(L, -1) || lua_isboolean(L, -1))) {
+        char *out = NULL;
+        size_t sz = 0;
+        if (umlua_mp_encode(L, -1, &out, &sz) == 0) {
+            call->res_mp = true;
+            *d_out = out;
+            *out_sz = sz;
+        }
+        // pop result
+        lua_pop(L, 1);
+        shd->running = false;
+        pthread_mutex_unlock(&shd->mtx);
+        return UMPLG_RES_SUCCESS;
+    }
+
     // check return (STRING/NUMBER)
     if (lua_isstring(L, -1)) {
-        const char *str = lua_tostring(L, -1);
-        size_t sl = strlen(str);
+        size_t sl = 0;
+        const char *str = lua_tolstring(L, -1, &sl);
         // empty string is ok
         if (sl == 0) {
             *out_sz = 0;
@@ -779,25 +1368,21 @@ lua_sig_hndlr_run(umplg_sh_t *shd,
             return UMPLG_RES_SUCCESS;
         }
 
-        // copy lua string to output buffer
+        // copy lua string to output buffer (binary safe, with
+        // additional '\0' terminator for string consumers)
         size_t sz = sl + 1;
         char *out = malloc(sz);
-        r = snprintf(out, sz, "%s", str);
-        // error (buffer too small)
-        if (r <= 0 || r >= sz) {
-            free(out);
+        if (out == NULL) {
             *out_sz = 0;
             // pop result or error message
             lua_pop(L, 1);
             shd->running = false;
             pthread_mutex_unlock(&shd->mtx);
             return UMPLG_RES_BUFFER_OVERFLOW;
-
-        // success
-        } else {
-            *d_out = out;
-            *out_sz = sz;
         }
+        memcpy(out, str, sz);
+        *d_out = out;
+        *out_sz = sz;
     }
     // pop result or error message
     lua_pop(L, 1);
@@ -841,8 +1426,61 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
     if (j_db != NULL && json_object_is_type(j_db, json_type_string)) {
         lem->dbm_perm = umdb_mngr_new(json_object_get_string(j_db), false);
     }
+    // permanent DB WAL journal mode (default, parallel reads;
+    // "db_wal": false keeps the rollback journal)
+    struct json_object *j_wal = json_object_object_get(plg_cfg, "db_wal");
+    if (lem->dbm_perm != NULL) {
+        if (j_wal != NULL && !json_object_is_type(j_wal, json_type_boolean)) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "plg_lua: [wrong type for 'db_wal']");
+            return 6;
+        }
+        if ((j_wal == NULL || json_object_get_boolean(j_wal)) &&
+            umdb_mngr_wal(lem->dbm_perm) != 0) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [cannot enable WAL for permanent DB]");
+        }
+    }
+    // permanent DB write-behind (optional)
+    // - interval:  commit interval in msec (durability window)
+    // - batch:     commit when number of pending sets is reached
+    struct json_object *j_wb = json_object_object_get(plg_cfg,
+                                                      "db_write_behind");
+    if (j_wb != NULL && lem->dbm_perm != NULL) {
+        if (!json_object_is_type(j_wb, json_type_object)) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "plg_lua: [wrong type for 'db_write_behind']");
+            return 6;
+        }
+        struct json_object *j_wb_int = json_object_object_get(j_wb, "interval");
+        struct json_object *j_wb_b = json_object_object_get(j_wb, "batch");
+        if ((j_wb_int != NULL &&
+             !json_object_is_type(j_wb_int, json_type_int)) ||
+            (j_wb_b != NULL && !json_object_is_type(j_wb_b, json_type_int))) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "plg_lua: [malformed 'db_write_behind']");
+            return 6;
+        }
+        if (umdb_mngr_wb_start(
+                lem->dbm_perm,
+                j_wb_int != NULL ? json_object_get_int(j_wb_int) : 0,
+                j_wb_b != NULL ? json_object_get_int(j_wb_b) : 0) != 0) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "plg_lua: [cannot start permanent DB write-behind]");
+            return 6;
+        }
+    }
+    // permanent DB key change dispatcher (M.db_watch)
+    if (lem->dbm_perm != NULL) {
+        lem->dbm_watch = umlua_watch_new(pm);
+    }
     // init in-memory DB
-    lem->dbm_mem = umdb_mngr_new(NULL, true);
+    lem->dbm_mem = umkv_new();
 
     // memory optimizations
     // aggresive lua gc
@@ -899,6 +1537,9 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
             struct json_object *j_p = json_object_object_get(v, "path");
             struct json_object *j_ev = json_object_object_get(v, "events");
             struct json_object *j_mauth = json_object_object_get(v, "min_auth");
+            struct json_object *j_libs = json_object_object_get(v, "libs");
+            struct json_object *j_mods = json_object_object_get(v, "modules");
+            struct json_object *j_shared = json_object_object_get(v, "shared");
             // all values are mandatory
             if (!(j_n && j_as && j_int && j_p && j_ev)) {
                 umd_log(
@@ -918,6 +1559,49 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
                 return 6;
             }
 
+            // shared lua state is optional
+            if (j_shared != NULL &&
+                !json_object_is_type(j_shared, json_type_boolean)) {
+                umd_log(UMD,
+                        UMD_LLT_ERROR,
+                        "plg_lua: [malformed Lua environment (wrong type for "
+                        "'shared')]");
+                return 6;
+            }
+
+            // libs and modules are optional (all, if not set)
+            if ((j_libs != NULL &&
+                 !json_object_is_type(j_libs, json_type_array)) ||
+                (j_mods != NULL &&
+                 !json_object_is_type(j_mods, json_type_array))) {
+                umd_log(UMD,
+                        UMD_LLT_ERROR,
+                        "plg_lua: [malformed Lua environment (wrong type for "
+                        "'libs' or 'modules')]");
+                return 6;
+            }
+            uint32_t libs = UMLUA_LIBS_ALL;
+            if (j_libs != NULL) {
+                libs = 0;
+                int libs_l = json_object_array_length(j_libs);
+                for (int j = 0; j < libs_l; ++j) {
+                    json_object *v2 = json_object_array_get_idx(j_libs, j);
+                    uint32_t lb = 0;
+                    if (json_object_is_type(v2, json_type_string)) {
+                        lb = lua_lib_bit(json_object_get_string(v2));
+                    }
+                    if (lb == 0) {
+                        umd_log(UMD,
+                                UMD_LLT_ERROR,
+                                "plg_lua: [malformed Lua environment (unknown "
+                                "library '%s')]",
+                                json_object_get_string(v2));
+                        return 6;
+                    }
+                    libs |= lb;
+                }
+            }
+
             // check types
             if (!(json_object_is_type(j_n, json_type_string) &&
                   json_object_is_type(j_as, json_type_boolean) &&
@@ -963,13 +1647,32 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
             // create ENV descriptor
             struct lua_env_d *env = calloc(1, sizeof(struct lua_env_d));
             env->name = strdup(json_object_get_string(j_n));
-            env->interval = json_object_get_int(j_int);
+            // negative interval: never auto-started (signals only)
+            int intvl = json_object_get_int(j_int);
+            env->interval = intvl > 0 ? intvl : 0;
             env->pm = pm;
             env->dbm.mem = lem->dbm_mem;
             env->dbm.perm = lem->dbm_perm;
+            env->dbm.watch = lem->dbm_watch;
             env->mem.agressive_gc = agr_gc;
             env->mem.conserve_mem = cs_mem;
-            UM_ATOMIC_COMP_SWAP(&env->active, 0, json_object_get_boolean(j_as));
+            env->profile.libs = libs;
+            env->sbox.enabled = json_object_get_boolean(j_shared);
+            if (j_mods != NULL) {
+                utarray_new(env->profile.modules, &ut_str_icd);
+                int mods_l = json_object_array_length(j_mods);
+                for (int j = 0; j < mods_l; ++j) {
+                    json_object *v2 = json_object_array_get_idx(j_mods, j);
+                    if (!json_object_is_type(v2, json_type_string)) {
+                        continue;
+                    }
+                    const char *mn = json_object_get_string(v2);
+                    utarray_push_back(env->profile.modules, &mn);
+                }
+            }
+            UM_ATOMIC_COMP_SWAP(&env->active,
+                                0,
+                                json_object_get_boolean(j_as) && intvl >= 0);
             env->path = strdup(json_object_get_string(j_p));
 
             // register events
@@ -1034,8 +1737,19 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
 static void
 process_lua_envs(struct lua_env_d *env)
 {
+    // shared lua state (started after all envs are processed)
+    if (env->sbox.enabled) {
+        if (env->active) {
+            if (sbox_envs == NULL) {
+                UT_icd icd = { sizeof(void *), NULL, NULL, NULL };
+                utarray_new(sbox_envs, &icd);
+            }
+            utarray_push_back(sbox_envs, &env);
+        }
+        return;
+    }
     // check if ENV should auto-start
-    if (env->interval >= 0 && env->active &&
+    if (env->active &&
         pthread_create(&env->th, NULL, th_lua_env, env)) {
         umd_log(UMD,
                 UMD_LLT_ERROR,
@@ -1052,13 +1766,16 @@ shutdown_lua_envs(struct lua_env_d *env)
     free(env->name);
     free(env->path);
     free(env->sgnl_perf);
+    if (env->profile.modules != NULL) {
+        utarray_free(env->profile.modules);
+    }
     free(env);
 }
 
 static void
 stop_lua_envs(struct lua_env_d *env)
 {
-    if (UM_ATOMIC_GET(&env->active)) {
+    if (!env->sbox.enabled && UM_ATOMIC_GET(&env->active)) {
         pthread_join(env->th, NULL);
     }
 }
@@ -1086,8 +1803,11 @@ th_cli_client(void *args)
     env->pm = ccd->pm;
     env->dbm.mem = lenv_mngr->dbm_mem;
     env->dbm.perm = lenv_mngr->dbm_perm;
+    env->dbm.watch = lenv_mngr->dbm_watch;
     env->mem.agressive_gc = true;
     env->mem.conserve_mem = true;
+    env->profile.libs = UMLUA_LIBS_ALL;
+    env->profile.modules = NULL;
     UM_ATOMIC_COMP_SWAP(&env->active, 0, true);
     env->path = NULL;
 
@@ -1153,14 +1873,12 @@ th_cli_client(void *args)
             lua_gc(L, LUA_GCCOLLECT, 0);
         }
 
-        // check return (STRING)
+        // check return (STRING); send lua string directly,
+        // including '\0' terminator
         if (lua_isstring(L, -1)) {
-            // copy lua string to output buffer
-            size_t sz = strlen(lua_tostring(L, -1)) + 1;
-            char *out = malloc(sz);
-            snprintf(out, sz, "%s", lua_tostring(L, -1));
-            send(ccd->s, out, sz, 0);
-            free(out);
+            size_t sz = 0;
+            const char *out = lua_tolstring(L, -1, &sz);
+            send(ccd->s, out, sz + 1, 0);
         }
 
         // pop result or error message
@@ -1358,6 +2076,14 @@ umlua_init(umplg_mngr_t *pm)
     // register signal
     umplg_reg_signal(pm, sh);
 
+    // lua state perf counters
+    state_perf.cnt =
+        umc_new_counter(UMD->perf, "lua.state.count", UMCT_INCREMENTAL);
+    state_perf.err =
+        umc_new_counter(UMD->perf, "lua.state.error", UMCT_INCREMENTAL);
+    state_perf.lag =
+        umc_new_counter(UMD->perf, "lua.state.lag", UMCT_HISTOGRAM);
+
     // lue env manager
     lenv_mngr = lenvm_new();
     if (process_cfg(pm, lenv_mngr)) {
@@ -1376,6 +2102,15 @@ umlua_start(umplg_mngr_t *pm)
 {
     // create environments
     lenvm_process_envs(lenv_mngr, &process_lua_envs);
+    // shared lua state environments
+    if (sbox_envs != NULL &&
+        pthread_create(&sbox_th, NULL, &th_lua_sbox, sbox_envs)) {
+        umd_log(UMD,
+                UMD_LLT_ERROR,
+                "plg_lua: [cannot start shared Lua environment]");
+        utarray_free(sbox_envs);
+        sbox_envs = NULL;
+    }
     // domain socket lua cli
     pthread_create(&cli_server_th, NULL, &th_cli_server, pm);
 }
@@ -1390,11 +2125,19 @@ umlua_shutdown()
     pthread_join(cli_server_th, NULL);
     // stop env threads
     lenvm_process_envs(lenv_mngr, &stop_lua_envs);
+    if (sbox_envs != NULL) {
+        pthread_join(sbox_th, NULL);
+        utarray_free(sbox_envs);
+        sbox_envs = NULL;
+    }
+    // stop key change dispatcher
+    umlua_watch_stop(lenv_mngr->dbm_watch);
     // free envs
     lenvm_process_envs(lenv_mngr, &shutdown_lua_envs);
     // free shared db managers
-    umdb_mngr_free(lenv_mngr->dbm_mem);
+    umkv_free(lenv_mngr->dbm_mem);
     umdb_mngr_free(lenv_mngr->dbm_perm);
+    umlua_watch_free(lenv_mngr->dbm_watch);
     // free env manager
     lenvm_free(lenv_mngr);
 }
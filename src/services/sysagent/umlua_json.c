@@ -0,0 +1,602 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <luaconf.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <json_object.h>
+#include <json_tokener.h>
+#include <linkhash.h>
+#include <umlua.h>
+
+/*
+ * M.json sub-module:
+ *  - M.json.decode(s [, { lazy = true }]) (lazy on Lua 5.3+)
+ *  - M.json.encode(v)
+ *  - M.json.null
+ */
+
+#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM == 501
+#    define lua_rawlen(L, i) lua_objlen(L, i)
+#endif
+
+// max nesting level (also prevents cyclic tables)
+#define JSON_MAX_DEPTH 32
+// lazy view metatable
+#define JSON_LAZY_MT "mink_json"
+
+/*****************/
+/* output buffer */
+/*****************/
+struct json_buff {
+    char *b;
+    size_t len;
+    size_t cap;
+};
+
+static int
+json_put(struct json_buff *jb, const char *d, size_t sz)
+{
+    if (jb->len + sz > jb->cap) {
+        size_t cap = (jb->cap > 0 ? jb->cap : 256);
+        while (cap < jb->len + sz) {
+            cap *= 2;
+        }
+        char *b = realloc(jb->b, cap);
+        if (b == NULL) {
+            return 1;
+        }
+        jb->b = b;
+        jb->cap = cap;
+    }
+    memcpy(jb->b + jb->len, d, sz);
+    jb->len += sz;
+    return 0;
+}
+
+// get lazy view at index (NULL if not a lazy view)
+static json_object **
+json_lazy_test(lua_State *L, int idx)
+{
+    json_object **jo = lua_touserdata(L, idx);
+    if (jo == NULL || !lua_getmetatable(L, idx)) {
+        return NULL;
+    }
+    luaL_getmetatable(L, JSON_LAZY_MT);
+    if (!lua_rawequal(L, -1, -2)) {
+        jo = NULL;
+    }
+    lua_pop(L, 2);
+    return jo;
+}
+
+/************/
+/* encoding */
+/************/
+static int
+json_enc_str(struct json_buff *jb, const char *s, size_t sz)
+{
+    static const char hex[] = "0123456789abcdef";
+    if (json_put(jb, "\"", 1)) {
+        return 1;
+    }
+    // copy unescaped runs at once
+    size_t run = 0;
+    for (size_t i = 0; i < sz; i++) {
+        unsigned char c = s[i];
+        char esc[6];
+        size_t esc_sz = 2;
+        esc[0] = '\\';
+        switch (c) {
+        case '"':
+            esc[1] = '"';
+            break;
+        case '\\':
+            esc[1] = '\\';
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            if (c >= 0x20) {
+                continue;
+            }
+            memcpy(esc, "\\u00", 4);
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0x0f];
+            esc_sz = 6;
+            break;
+        }
+        if (json_put(jb, s + run, i - run) || json_put(jb, esc, esc_sz)) {
+            return 1;
+        }
+        run = i + 1;
+    }
+    if (json_put(jb, s + run, sz - run)) {
+        return 1;
+    }
+    return json_put(jb, "\"", 1);
+}
+
+static int
+json_enc_number(lua_State *L, int idx, struct json_buff *jb)
+{
+    char b[32];
+    int sz;
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(L, idx)) {
+        sz = snprintf(b, sizeof(b), "%lld", (long long)lua_tointeger(L, idx));
+        return json_put(jb, b, sz);
+    }
+#endif
+    lua_Number n = lua_tonumber(L, idx);
+    // no NaN/Inf in JSON
+    if (isnan(n) || isinf(n)) {
+        return json_put(jb, "null", 4);
+    }
+    // integral numbers
+    if (n == floor(n) && n >= -9007199254740992.0 &&
+        n <= 9007199254740992.0) {
+        sz = snprintf(b, sizeof(b), "%lld", (long long)n);
+    } else {
+        sz = snprintf(b, sizeof(b), "%.14g", (double)n);
+    }
+    return json_put(jb, b, sz);
+}
+
+static int
+json_enc_value(lua_State *L, int idx, struct json_buff *jb, int depth);
+
+static int
+json_enc_table(lua_State *L, int idx, struct json_buff *jb, int depth)
+{
+    if (depth >= JSON_MAX_DEPTH || !lua_checkstack(L, 3)) {
+        return 2;
+    }
+    // array check; keys must be 1..n
+    size_t n = lua_rawlen(L, idx);
+    size_t cnt = 0;
+    bool arr = true;
+    lua_pushnil(L);
+    while (lua_next(L, idx) != 0) {
+        ++cnt;
+        if (arr) {
+            if (lua_type(L, -2) != LUA_TNUMBER) {
+                arr = false;
+            } else {
+                lua_Number k = lua_tonumber(L, -2);
+                if (k != floor(k) || k < 1 || k > n) {
+                    arr = false;
+                }
+            }
+        }
+        lua_pop(L, 1);
+    }
+    // empty tables are encoded as objects
+    arr = arr && cnt == n && n > 0;
+
+    // array
+    if (arr) {
+        if (json_put(jb, "[", 1)) {
+            return 1;
+        }
+        for (size_t i = 1; i <= n; i++) {
+            if (i > 1 && json_put(jb, ",", 1)) {
+                return 1;
+            }
+            lua_rawgeti(L, idx, i);
+            int r = json_enc_value(L, lua_gettop(L), jb, depth + 1);
+            lua_pop(L, 1);
+            if (r) {
+                return r;
+            }
+        }
+        return json_put(jb, "]", 1);
+    }
+
+    // object (string and number keys)
+    if (json_put(jb, "{", 1)) {
+        return 1;
+    }
+    cnt = 0;
+    lua_pushnil(L);
+    while (lua_next(L, idx) != 0) {
+        int r = 0;
+        if (cnt++ > 0) {
+            r = json_put(jb, ",", 1);
+        }
+        if (!r) {
+            // key (copy number keys; lua_tolstring converts in place)
+            if (lua_type(L, -2) == LUA_TSTRING) {
+                size_t sz = 0;
+                const char *k = lua_tolstring(L, -2, &sz);
+                r = json_enc_str(jb, k, sz);
+
+            } else if (lua_type(L, -2) == LUA_TNUMBER) {
+                lua_pushvalue(L, -2);
+                size_t sz = 0;
+                const char *k = lua_tolstring(L, -1, &sz);
+                r = json_enc_str(jb, k, sz);
+                lua_pop(L, 1);
+
+            } else {
+                r = 3;
+            }
+        }
+        if (!r) {
+            r = json_put(jb, ":", 1);
+        }
+        if (!r) {
+            r = json_enc_value(L, lua_gettop(L), jb, depth + 1);
+        }
+        if (r) {
+            lua_pop(L, 2);
+            return r;
+        }
+        lua_pop(L, 1);
+    }
+    return json_put(jb, "}", 1);
+}
+
+static int
+json_enc_value(lua_State *L, int idx, struct json_buff *jb, int depth)
+{
+    switch (lua_type(L, idx)) {
+    case LUA_TNIL:
+        return json_put(jb, "null", 4);
+    case LUA_TBOOLEAN:
+        if (lua_toboolean(L, idx)) {
+            return json_put(jb, "true", 4);
+        }
+        return json_put(jb, "false", 5);
+    case LUA_TNUMBER:
+        return json_enc_number(L, idx, jb);
+    case LUA_TSTRING: {
+        size_t sz = 0;
+        const char *s = lua_tolstring(L, idx, &sz);
+        return json_enc_str(jb, s, sz);
+    }
+    case LUA_TTABLE:
+        return json_enc_table(L, idx, jb, depth);
+    // M.json.null
+    case LUA_TLIGHTUSERDATA:
+        if (lua_touserdata(L, idx) == NULL) {
+            return json_put(jb, "null", 4);
+        }
+        return 3;
+    // lazy decoded value or M.get_args() view
+    case LUA_TUSERDATA: {
+        json_object **jo = json_lazy_test(L, idx);
+        if (jo == NULL) {
+            if (!umlua_args_totable(L, idx)) {
+                return 3;
+            }
+            int r = json_enc_table(L, lua_gettop(L), jb, depth);
+            lua_pop(L, 1);
+            return r;
+        }
+        const char *s = json_object_to_json_string_ext(*jo,
+                                                       JSON_C_TO_STRING_PLAIN);
+        return json_put(jb, s, strlen(s));
+    }
+    // functions and threads
+    default:
+        return 3;
+    }
+}
+
+// M.json.encode(v)
+static int
+json_lua_encode(lua_State *L)
+{
+    luaL_checkany(L, 1);
+    lua_settop(L, 1);
+    struct json_buff jb = { NULL, 0, 0 };
+    int r = json_enc_value(L, 1, &jb, 0);
+    if (r) {
+        free(jb.b);
+        lua_pushnil(L);
+        switch (r) {
+        case 2:
+            lua_pushstring(L, "nesting too deep");
+            break;
+        case 3:
+            lua_pushstring(L, "unsupported value type");
+            break;
+        default:
+            lua_pushstring(L, "out of memory");
+            break;
+        }
+        return 2;
+    }
+    lua_pushlstring(L, jb.b, jb.len);
+    free(jb.b);
+    return 1;
+}
+
+/************/
+/* decoding */
+/************/
+static void json_push_lazy(lua_State *L, json_object *o);
+
+// push scalar or (eager) container value
+static void
+json_push_value(lua_State *L, json_object *o, bool lazy)
+{
+    switch (json_object_get_type(o)) {
+    case json_type_null:
+        lua_pushlightuserdata(L, NULL);
+        break;
+    case json_type_boolean:
+        lua_pushboolean(L, json_object_get_boolean(o));
+        break;
+    case json_type_int:
+#if LUA_VERSION_NUM >= 503
+        lua_pushinteger(L, json_object_get_int64(o));
+#else
+        lua_pushnumber(L, json_object_get_int64(o));
+#endif
+        break;
+    case json_type_double:
+        lua_pushnumber(L, json_object_get_double(o));
+        break;
+    case json_type_string:
+        lua_pushlstring(L,
+                        json_object_get_string(o),
+                        json_object_get_string_len(o));
+        break;
+    case json_type_array: {
+        if (lazy) {
+            json_push_lazy(L, o);
+            break;
+        }
+        // presized array
+        size_t n = json_object_array_length(o);
+        luaL_checkstack(L, 2, "json nesting too deep");
+        lua_createtable(L, n, 0);
+        for (size_t i = 0; i < n; i++) {
+            json_push_value(L, json_object_array_get_idx(o, i), false);
+            lua_rawseti(L, -2, i + 1);
+        }
+        break;
+    }
+    case json_type_object: {
+        if (lazy) {
+            json_push_lazy(L, o);
+            break;
+        }
+        // presized hash
+        luaL_checkstack(L, 3, "json nesting too deep");
+        lua_createtable(L, 0, json_object_object_length(o));
+        json_object_object_foreach(o, k, v)
+        {
+            lua_pushstring(L, k);
+            json_push_value(L, v, false);
+            lua_rawset(L, -3);
+        }
+        break;
+    }
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
+// lazy view: v:totable()
+static int
+json_lazy_totable(lua_State *L)
+{
+    json_object **jo = luaL_checkudata(L, 1, JSON_LAZY_MT);
+    json_push_value(L, *jo, false);
+    return 1;
+}
+
+// lazy view: v[k]
+static int
+json_lazy_index(lua_State *L)
+{
+    json_object **jo = luaL_checkudata(L, 1, JSON_LAZY_MT);
+    json_object *o = *jo;
+    // array (1 based)
+    if (json_object_is_type(o, json_type_array)) {
+        if (lua_type(L, 2) == LUA_TNUMBER) {
+            int i = lua_tointeger(L, 2);
+            if (i >= 1 && i <= json_object_array_length(o)) {
+                json_push_value(L, json_object_array_get_idx(o, i - 1), true);
+                return 1;
+            }
+        }
+
+    // object (data keys shadow methods)
+    } else if (lua_type(L, 2) == LUA_TSTRING) {
+        json_object *v = NULL;
+        if (json_object_object_get_ex(o, lua_tostring(L, 2), &v)) {
+            json_push_value(L, v, true);
+            return 1;
+        }
+    }
+    // methods
+    if (lua_type(L, 2) == LUA_TSTRING &&
+        strcmp(lua_tostring(L, 2), "totable") == 0) {
+        lua_pushcfunction(L, &json_lazy_totable);
+        return 1;
+    }
+    return 0;
+}
+
+// lazy view: #v
+static int
+json_lazy_len(lua_State *L)
+{
+    json_object **jo = luaL_checkudata(L, 1, JSON_LAZY_MT);
+    if (json_object_is_type(*jo, json_type_array)) {
+        lua_pushinteger(L, json_object_array_length(*jo));
+    } else {
+        lua_pushinteger(L, 0);
+    }
+    return 1;
+}
+
+// lazy view: pairs iterator (upvalue: next array index or object entry)
+static int
+json_lazy_next(lua_State *L)
+{
+    json_object **jo = luaL_checkudata(L, 1, JSON_LAZY_MT);
+    json_object *o = *jo;
+    if (json_object_is_type(o, json_type_array)) {
+        int i = lua_tointeger(L, lua_upvalueindex(1));
+        if (i >= json_object_array_length(o)) {
+            return 0;
+        }
+        lua_pushinteger(L, i + 1);
+        lua_replace(L, lua_upvalueindex(1));
+        lua_pushinteger(L, i + 1);
+        json_push_value(L, json_object_array_get_idx(o, i), true);
+        return 2;
+    }
+    struct lh_entry *e = lua_touserdata(L, lua_upvalueindex(1));
+    if (e == NULL) {
+        return 0;
+    }
+    lua_pushlightuserdata(L, e->next);
+    lua_replace(L, lua_upvalueindex(1));
+    lua_pushstring(L, (const char *)e->k);
+    json_push_value(L, (json_object *)e->v, true);
+    return 2;
+}
+
+// lazy view: pairs(v)
+static int
+json_lazy_pairs(lua_State *L)
+{
+    json_object **jo = luaL_checkudata(L, 1, JSON_LAZY_MT);
+    if (json_object_is_type(*jo, json_type_array)) {
+        lua_pushinteger(L, 0);
+    } else {
+        lua_pushlightuserdata(L, json_object_get_object(*jo)->head);
+    }
+    lua_pushcclosure(L, &json_lazy_next, 1);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+// lazy view: gc
+static int
+json_lazy_gc(lua_State *L)
+{
+    json_object **jo = luaL_checkudata(L, 1, JSON_LAZY_MT);
+    json_object_put(*jo);
+    *jo = NULL;
+    return 0;
+}
+
+// push lazy view (holds a reference to json object)
+static void
+json_push_lazy(lua_State *L, json_object *o)
+{
+    json_object **jo = lua_newuserdata(L, sizeof(json_object *));
+    *jo = json_object_get(o);
+    if (luaL_newmetatable(L, JSON_LAZY_MT)) {
+        lua_pushstring(L, "__index");
+        lua_pushcfunction(L, &json_lazy_index);
+        lua_settable(L, -3);
+        lua_pushstring(L, "__len");
+        lua_pushcfunction(L, &json_lazy_len);
+        lua_settable(L, -3);
+        lua_pushstring(L, "__pairs");
+        lua_pushcfunction(L, &json_lazy_pairs);
+        lua_settable(L, -3);
+        lua_pushstring(L, "__gc");
+        lua_pushcfunction(L, &json_lazy_gc);
+        lua_settable(L, -3);
+    }
+    lua_setmetatable(L, -2);
+}
+
+// M.json.decode(s [, opts])
+static int
+json_lua_decode(lua_State *L)
+{
+    size_t sz = 0;
+    const char *s = luaL_checklstring(L, 1, &sz);
+    // options
+    bool lazy = false;
+    if (lua_istable(L, 2)) {
+        lua_pushstring(L, "lazy");
+        lua_gettable(L, 2);
+        lazy = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+    }
+#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM < 503
+    // lazy views require Lua 5.3+ (decoded eagerly)
+    lazy = false;
+#endif
+    // parse
+    struct json_tokener *tok = json_tokener_new_ex(JSON_MAX_DEPTH);
+    if (tok == NULL) {
+        lua_pushnil(L);
+        lua_pushstring(L, "out of memory");
+        return 2;
+    }
+    json_object *o = json_tokener_parse_ex(tok, s, sz);
+    enum json_tokener_error err = json_tokener_get_error(tok);
+    json_tokener_free(tok);
+    if (err != json_tokener_success) {
+        json_object_put(o);
+        lua_pushnil(L);
+        lua_pushstring(L, json_tokener_error_desc(err));
+        return 2;
+    }
+    // convert (lazy views hold their own reference)
+    json_push_value(L, o, lazy);
+    json_object_put(o);
+    return 1;
+}
+
+/*********************/
+/* M.json sub-module */
+/*********************/
+static const luaL_Reg json_lualib[] = { { "decode", &json_lua_decode },
+                                        { "encode", &json_lua_encode },
+                                        { NULL, NULL } };
+
+int
+umlua_json_open(lua_State *L)
+{
+    lua_createtable(L, 0, 3);
+    for (const luaL_Reg *r = json_lualib; r->name != NULL; r++) {
+        lua_pushstring(L, r->name);
+        lua_pushcfunction(L, r->func);
+        lua_rawset(L, -3);
+    }
+    // M.json.null sentinel
+    lua_pushstring(L, "null");
+    lua_pushlightuserdata(L, NULL);
+    lua_rawset(L, -3);
+    return 1;
+}
@@ -17,9 +17,15 @@
 #include <lauxlib.h>
 #include <umdaemon.h>
 #include <umdb.h>
+#include <umkv.h>
+#include <umlua.h>
 #include <json_object.h>
 #include <json_tokener.h>
 
+#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM == 501
+#    define lua_rawlen(L, i) lua_objlen(L, i)
+#endif
+
 /*********/
 /* Types */
 /*********/
@@ -36,6 +42,8 @@ mink_lua_signal(const char *s,
                 const char *d,
                 const char *auth,
                 void *md,
+                struct lua_sig_call_d *call,
+                size_t *out_sz,
                 enum umplg_ret_t *res)
 {
     // plugin manager
@@ -43,16 +51,14 @@ mink_lua_signal(const char *s,
     // check signal
     if (!s) {
         *res = UMPLG_RES_UNKNOWN_SIGNAL;
-        return strdup("");
+        return NULL;
     }
 
-    // check auth (already checked for errors)
-    int usr_flags = 0;
-    if (auth != NULL){
-        json_object *j = json_tokener_parse(auth);
-        json_object *j_usr = json_object_object_get(j, "flags");
-        usr_flags = json_object_get_int(j_usr);
-        json_object_put(j);
+    // auth context (parsed once and cached)
+    umplg_auth_t ctx;
+    const umplg_auth_t *auth_ctx = NULL;
+    if (auth != NULL && umplg_auth_get(auth, &ctx) == 0) {
+        auth_ctx = &ctx;
     }
 
     // create std data
@@ -68,31 +74,23 @@ mink_lua_signal(const char *s,
     umplg_stdd_items_add(&e_d, &items);
     // output buffer (allocated in signal handler)
     char *b = NULL;
-    size_t sz = 0;
+    *out_sz = 0;
     // process signal
-    int r = umplg_proc_signal(pm, s, &e_d, &b, &sz, usr_flags, NULL);
+    int r = umplg_proc_signal_auth(pm, s, &e_d, &b, out_sz, auth_ctx, call);
     *res = r;
-    // success
+    // cleanup
+    HASH_CLEAR(hh, items.table);
+    umplg_stdd_free(&e_d);
+
+    // success (result buffer or in-place result)
     if (r == UMPLG_RES_SUCCESS) {
-        // cleanup
-        HASH_CLEAR(hh, items.table);
-        umplg_stdd_free(&e_d);
         return b;
-
-    // auth error
-    } else if (r == UMPLG_RES_AUTH_ERROR) {
-        // cleanup
-        HASH_CLEAR(hh, items.table);
-        umplg_stdd_free(&e_d);
-        return strdup("");
     }
 
-    // ** other errors **
-    // cleanup
-    HASH_CLEAR(hh, items.table);
-    umplg_stdd_free(&e_d);
-    // error
-    return strdup("");
+    // auth and other errors
+    free(b);
+    *out_sz = 0;
+    return NULL;
 }
 
 /*****************************/
@@ -230,6 +228,444 @@ mink_lua_cmd_call(void *md, int argc, const char **args, void *out)
 
 }
 
+/******************************/
+/* get_args (lazy data views) */
+/******************************/
+#define MINK_ARGS_MT     "mink_args"
+#define MINK_ARGS_ROW_MT "mink_args_row"
+#define MINK_ARGS_TBL_MT "mink_args_tbl"
+
+// signal input data view (rows or single row)
+typedef struct {
+    // signal input data
+    umplg_data_std_t *d;
+    // per-thread signal reference (mink_stdd index)
+    size_t tl;
+    // signal call generation (mink_sgen value)
+    lua_Number gen;
+    // row index (-1 for rows view)
+    int row;
+} mink_args_view_t;
+
+static void mink_args_push_view(lua_State *L,
+                                const mink_args_view_t *pv,
+                                int row);
+
+// view at index (rows or row view) or NULL
+static mink_args_view_t *
+mink_args_test(lua_State *L, int idx)
+{
+    mink_args_view_t *v = lua_touserdata(L, idx);
+    if (v == NULL || lua_islightuserdata(L, idx) ||
+        !lua_getmetatable(L, idx)) {
+        return NULL;
+    }
+    luaL_getmetatable(L, MINK_ARGS_MT);
+    luaL_getmetatable(L, MINK_ARGS_ROW_MT);
+    int ok = lua_rawequal(L, -3, -2) || lua_rawequal(L, -3, -1);
+    lua_pop(L, 3);
+    return ok ? v : NULL;
+}
+
+// signal data is valid only while its signal is running
+// (input data address can be reused by a later call, the
+// call generation cannot)
+static int
+mink_args_valid(lua_State *L, const mink_args_view_t *v)
+{
+    lua_pushstring(L, "mink_sgen");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    int ok = 0;
+    if (lua_istable(L, -1)) {
+        lua_pushnumber(L, v->tl);
+        lua_gettable(L, -2);
+        ok = lua_isnumber(L, -1) && lua_tonumber(L, -1) == v->gen;
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    return ok;
+}
+
+// get view at index (rows or row view)
+static mink_args_view_t *
+mink_args_check(lua_State *L, int idx)
+{
+    mink_args_view_t *v = mink_args_test(L, idx);
+    if (v == NULL) {
+        luaL_argerror(L, idx, "M.get_args() view expected");
+        return NULL;
+    }
+    if (!mink_args_valid(L, v)) {
+        luaL_error(L, "M.get_args() view used outside of its signal");
+        return NULL;
+    }
+    return v;
+}
+
+// push structured payload (M.signal with lua value); 0 if not set
+static int
+mink_args_push_sargs(lua_State *L, size_t tl)
+{
+    lua_pushstring(L, "mink_sargs");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return 0;
+    }
+    lua_pushnumber(L, tl);
+    lua_gettable(L, -2);
+    lua_remove(L, -2);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        return 0;
+    }
+    return 1;
+}
+
+// get row at index
+static umplg_data_std_items_t *
+mink_args_row(umplg_data_std_t *d, int r)
+{
+    if (r < 0 || r >= mink_lua_cmd_data_sz(d)) {
+        return NULL;
+    }
+    return utarray_eltptr(d->items, r);
+}
+
+// materialize row as lua table
+static void
+mink_args_push_row_table(lua_State *L, mink_args_view_t *v, int r)
+{
+    umplg_data_std_items_t *row = mink_args_row(v->d, r);
+    lua_createtable(L, 0, row != NULL ? HASH_COUNT(row->table) : 0);
+    if (row == NULL) {
+        return;
+    }
+    // tmp column key
+    int k = 0;
+    // loop columns
+    umplg_data_std_item_t *c = NULL;
+    for (c = row->table; c != NULL; c = c->hh.next) {
+        if (c->value == NULL) {
+            continue;
+        }
+        ++k;
+        // update key, if not null
+        if (c->name != NULL && strlen(c->name) > 0) {
+            lua_pushstring(L, c->name);
+        } else {
+            lua_pushnumber(L, k);
+        }
+        // add value and add table column
+        lua_pushstring(L, c->value);
+        lua_settable(L, -3);
+    }
+    // structured payload replaces the first column of the first row
+    if (r == 0 && mink_args_push_sargs(L, v->tl)) {
+        lua_rawseti(L, -2, 1);
+    }
+}
+
+// materialize view as lua table
+static void
+mink_args_push_table(lua_State *L, mink_args_view_t *v)
+{
+    // single row
+    if (v->row >= 0) {
+        mink_args_push_row_table(L, v, v->row);
+        return;
+    }
+    // all rows
+    size_t sz = mink_lua_cmd_data_sz(v->d);
+    lua_createtable(L, sz, 0);
+    for (int i = 0; i < sz; i++) {
+        mink_args_push_row_table(L, v, i);
+        lua_rawseti(L, -2, i + 1);
+    }
+}
+
+// view:totable()
+static int
+mink_args_totable(lua_State *L)
+{
+    mink_args_push_table(L, mink_args_check(L, 1));
+    return 1;
+}
+
+// rows view: data[i]
+static int
+mink_args_index(lua_State *L)
+{
+    mink_args_view_t *v = mink_args_check(L, 1);
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        int r = lua_tointeger(L, 2);
+        if (r >= 1 && r <= mink_lua_cmd_data_sz(v->d)) {
+            mink_args_push_view(L, v, r - 1);
+            return 1;
+        }
+    } else if (lua_type(L, 2) == LUA_TSTRING &&
+               strcmp(lua_tostring(L, 2), "totable") == 0) {
+        lua_pushcfunction(L, &mink_args_totable);
+        return 1;
+    }
+    return 0;
+}
+
+// rows view: #data
+static int
+mink_args_len(lua_State *L)
+{
+    mink_args_view_t *v = mink_args_check(L, 1);
+    lua_pushinteger(L, mink_lua_cmd_data_sz(v->d));
+    return 1;
+}
+
+// rows view: pairs iterator
+static int
+mink_args_next(lua_State *L)
+{
+    mink_args_view_t *v = mink_args_check(L, 1);
+    int r = lua_isnil(L, 2) ? 0 : lua_tointeger(L, 2);
+    if (r >= mink_lua_cmd_data_sz(v->d)) {
+        return 0;
+    }
+    lua_pushinteger(L, r + 1);
+    mink_args_push_view(L, v, r);
+    return 2;
+}
+
+// rows view: pairs(data)
+static int
+mink_args_pairs(lua_State *L)
+{
+    mink_args_check(L, 1);
+    lua_pushcfunction(L, &mink_args_next);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+// row view: row[k]
+static int
+mink_args_row_index(lua_State *L)
+{
+    mink_args_view_t *v = mink_args_check(L, 1);
+    umplg_data_std_items_t *row = mink_args_row(v->d, v->row);
+    if (row == NULL) {
+        return 0;
+    }
+    // positional column (non-null columns without name)
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        int n = lua_tointeger(L, 2);
+        // structured payload
+        if (n == 1 && v->row == 0 && mink_args_push_sargs(L, v->tl)) {
+            return 1;
+        }
+        int k = 0;
+        umplg_data_std_item_t *c = NULL;
+        for (c = row->table; c != NULL && k < n; c = c->hh.next) {
+            if (c->value == NULL) {
+                continue;
+            }
+            if (++k == n && (c->name == NULL || strlen(c->name) == 0)) {
+                lua_pushstring(L, c->value);
+                return 1;
+            }
+        }
+        return 0;
+    }
+    // named column
+    if (lua_type(L, 2) == LUA_TSTRING) {
+        const char *key = lua_tostring(L, 2);
+        umplg_data_std_item_t *c = NULL;
+        if (strlen(key) > 0) {
+            HASH_FIND_STR(row->table, key, c); // GCOVR_EXCL_BR_LINE
+        }
+        if (c != NULL && c->value != NULL) {
+            lua_pushstring(L, c->value);
+            return 1;
+        }
+        if (strcmp(key, "totable") == 0) {
+            lua_pushcfunction(L, &mink_args_totable);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// row view: #row
+static int
+mink_args_row_len(lua_State *L)
+{
+    mink_args_view_t *v = mink_args_check(L, 1);
+    umplg_data_std_items_t *row = mink_args_row(v->d, v->row);
+    if (row == NULL) {
+        lua_pushinteger(L, 0);
+        return 1;
+    }
+    // border of positional columns
+    int n = 0;
+    if (v->row == 0 && mink_args_push_sargs(L, v->tl)) {
+        lua_pop(L, 1);
+        n = 1;
+    }
+    int k = 0;
+    umplg_data_std_item_t *c = NULL;
+    for (c = row->table; c != NULL; c = c->hh.next) {
+        if (c->value == NULL) {
+            continue;
+        }
+        if (++k == n + 1 && (c->name == NULL || strlen(c->name) == 0)) {
+            n = k;
+        }
+    }
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+// row view: pairs iterator (upvalues: next column, positional key,
+// structured payload pending)
+static int
+mink_args_row_next(lua_State *L)
+{
+    mink_args_view_t *v = mink_args_check(L, 1);
+    umplg_data_std_items_t *row = mink_args_row(v->d, v->row);
+    if (row == NULL) {
+        return 0;
+    }
+    umplg_data_std_item_t *c = lua_touserdata(L, lua_upvalueindex(1));
+    int k = lua_tointeger(L, lua_upvalueindex(2));
+    int sargs = lua_toboolean(L, lua_upvalueindex(3));
+
+    // structured payload first
+    if (sargs) {
+        lua_pushboolean(L, 0);
+        lua_replace(L, lua_upvalueindex(3));
+        lua_pushinteger(L, 1);
+        if (mink_args_push_sargs(L, v->tl)) {
+            return 2;
+        }
+        lua_pop(L, 1);
+    }
+
+    for (; c != NULL; c = c->hh.next) {
+        if (c->value == NULL) {
+            continue;
+        }
+        ++k;
+        bool named = (c->name != NULL && strlen(c->name) > 0);
+        // first positional column replaced by structured payload
+        if (!named && k == 1 && lua_toboolean(L, lua_upvalueindex(4))) {
+            continue;
+        }
+        // save iterator state
+        lua_pushlightuserdata(L, c->hh.next);
+        lua_replace(L, lua_upvalueindex(1));
+        lua_pushinteger(L, k);
+        lua_replace(L, lua_upvalueindex(2));
+        // key/value
+        if (named) {
+            lua_pushstring(L, c->name);
+        } else {
+            lua_pushinteger(L, k);
+        }
+        lua_pushstring(L, c->value);
+        return 2;
+    }
+    return 0;
+}
+
+// row view: pairs(row)
+static int
+mink_args_row_pairs(lua_State *L)
+{
+    mink_args_view_t *v = mink_args_check(L, 1);
+    umplg_data_std_items_t *row = mink_args_row(v->d, v->row);
+    int sargs = 0;
+    if (v->row == 0 && mink_args_push_sargs(L, v->tl)) {
+        lua_pop(L, 1);
+        sargs = 1;
+    }
+    lua_pushlightuserdata(L, row != NULL ? row->table : NULL);
+    lua_pushinteger(L, 0);
+    lua_pushboolean(L, sargs);
+    lua_pushboolean(L, sargs);
+    lua_pushcclosure(L, &mink_args_row_next, 4);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+// views are read-only (signal input data); copy with
+// :totable() to modify
+static int
+mink_args_newindex(lua_State *L)
+{
+    mink_args_check(L, 1);
+    return luaL_error(L, "M.get_args() view is read-only (use :totable())");
+}
+
+int
+umlua_args_totable(lua_State *L, int idx)
+{
+    mink_args_view_t *v = mink_args_test(L, idx);
+    if (v == NULL || !mink_args_valid(L, v)) {
+        return 0;
+    }
+    mink_args_push_table(L, v);
+    return 1;
+}
+
+#if LUA_VERSION_NUM < 503
+// table:totable() (plain tables have the same API as views)
+static int
+mink_args_tbl_totable(lua_State *L)
+{
+    lua_settop(L, 1);
+    return 1;
+}
+
+// set plain table metatable (top of the stack)
+static void
+mink_args_tbl_mt(lua_State *L)
+{
+    if (luaL_newmetatable(L, MINK_ARGS_TBL_MT)) {
+        lua_pushstring(L, "__index");
+        lua_newtable(L);
+        lua_pushstring(L, "totable");
+        lua_pushcfunction(L, &mink_args_tbl_totable);
+        lua_settable(L, -3);
+        lua_settable(L, -3);
+    }
+    lua_setmetatable(L, -2);
+}
+#endif
+
+// push new rows/row view (same signal call as parent view)
+static void
+mink_args_push_view(lua_State *L, const mink_args_view_t *pv, int row)
+{
+    mink_args_view_t *v = lua_newuserdata(L, sizeof(mink_args_view_t));
+    *v = *pv;
+    v->row = row;
+    // metatables (created once per lua state)
+    if (luaL_newmetatable(L, row < 0 ? MINK_ARGS_MT : MINK_ARGS_ROW_MT)) {
+        lua_pushstring(L, "__index");
+        lua_pushcfunction(L, row < 0 ? &mink_args_index : &mink_args_row_index);
+        lua_settable(L, -3);
+        lua_pushstring(L, "__len");
+        lua_pushcfunction(L, row < 0 ? &mink_args_len : &mink_args_row_len);
+        lua_settable(L, -3);
+        lua_pushstring(L, "__pairs");
+        lua_pushcfunction(L, row < 0 ? &mink_args_pairs : &mink_args_row_pairs);
+        lua_settable(L, -3);
+        lua_pushstring(L, "__newindex");
+        lua_pushcfunction(L, &mink_args_newindex);
+        lua_settable(L, -3);
+    }
+    lua_setmetatable(L, -2);
+}
+
 /************/
 /* get_args */
 /************/
@@ -251,54 +687,41 @@ mink_lua_get_args(lua_State *L)
     lua_gettable(L, -2);
 
     // get user data pointer
-    umplg_data_std_t *d = lua_touserdata(L, -1);
-    size_t sz = mink_lua_cmd_data_sz(d);
-
-    // lua table
-    lua_newtable(L);
-
-    // tmp column key
-    int k = 0;
-    // loop result data (rows)
+    mink_args_view_t v = { .d = lua_touserdata(L, -1), .tl = tl, .row = -1 };
+    lua_pop(L, 2);
+    // signal call generation
+    lua_pushstring(L, "mink_sgen");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return 0;
+    }
+    lua_pushnumber(L, tl);
+    lua_gettable(L, -2);
+    v.gen = lua_tonumber(L, -1);
+    lua_pop(L, 2);
+
+#if LUA_VERSION_NUM >= 503
+    // lazy view (userdata); rows and columns are read on
+    // demand from signal input data, ipairs() and pairs()
+    // work through __index and __pairs, :totable()
+    // materializes plain tables (views are read-only;
+    // M.json.encode and M.signal payloads copy them)
+    mink_args_push_view(L, &v, -1);
+#else
+    // ipairs() and pairs() do not use metamethods of views
+    // before Lua 5.3; plain tables (with :totable())
+    mink_args_push_table(L, &v);
+    size_t sz = mink_lua_cmd_data_sz(v.d);
     for (int i = 0; i < sz; i++) {
-        // table key (array)
-        lua_pushnumber(L, i + 1);
-
-        // create table row
-        lua_newtable(L);
-
-        // get column count
-        size_t sz_c = mink_lua_cmd_data_row_sz(i, d);
-        // reset tmp key
-        k = 0;
-        // loop columns
-        for (int j = 0; j < sz_c; j++) {
-            // get column key/value
-            mink_cdata_column_t c = mink_lua_cmd_data_get_column(i, j, d);
-            // add column to lua table
-            if (c.value != NULL) {
-                ++k;
-                // update key, if not null
-                if (c.key != NULL && strlen(c.key) > 0) {
-                    // k = ffi.string(c.key)
-                    lua_pushstring(L, c.key);
-
-                } else {
-                    // k = 1
-                    lua_pushnumber(L, k);
-                }
-
-                // add value and add table column
-                lua_pushstring(L, c.value);
-                lua_settable(L, -3);
-            }
-        }
-
-        // add table row
-        lua_settable(L, -3);
+        lua_rawgeti(L, -1, i + 1);
+        mink_args_tbl_mt(L);
+        lua_pop(L, 1);
     }
+    mink_args_tbl_mt(L);
+#endif
 
-    // return table
+    // return view
     return 1;
 }
 
@@ -429,20 +852,33 @@ mink_lua_do_signal(lua_State *L)
         idx_offset = -1;
     }
 
-    // check types
+    // check types (payload can also be a structured lua value)
+    int pld_idx = 0;
     for (int i = idx_offset; i < 0; i++) {
-        if (!lua_isstring(L, i)) {
-            lua_pushstring(L, "");
-            lua_pushnumber(L, UMPLG_RES_INVALID_TYPE);
-            return 2;
+        if (lua_isstring(L, i)) {
+            continue;
         }
+        // M.get_args() view payload (copied)
+        if (i == idx_offset + 1 && umlua_args_totable(L, i)) {
+            lua_replace(L, i - 1);
+        }
+        if (i == idx_offset + 1 && (lua_istable(L, i) || lua_isboolean(L, i))) {
+            pld_idx = lua_gettop(L) + i + 1;
+            continue;
+        }
+        lua_pushstring(L, "");
+        lua_pushnumber(L, UMPLG_RES_INVALID_TYPE);
+        return 2;
     }
 
     // get signal name
     s = lua_tostring(L, idx_offset++);
     // get payload data
     if (idx_offset < 0){
-        d = lua_tostring(L, idx_offset++);
+        if (pld_idx == 0) {
+            d = lua_tostring(L, idx_offset);
+        }
+        ++idx_offset;
     }
     // get user info
     if (idx_offset < 0){
@@ -457,15 +893,34 @@ mink_lua_do_signal(lua_State *L)
 
     // signal
     enum umplg_ret_t res = UMPLG_RES_UNKNOWN_SIGNAL;
-    char *s_res = mink_lua_signal(s, d, auth, pm, &res);
-    // string result
-    if (s_res != NULL) {
-        lua_pushstring(L, s_res);
-        free(s_res);
+    struct lua_sig_call_d call = { .L = L,
+                                   .pld_idx = pld_idx,
+                                   .in_place = false,
+                                   .res_mp = false };
+    size_t sz = 0;
+    char *s_res = mink_lua_signal(s, d, auth, pm, &call, &sz, &res);
+    // result left on stack by handler running in this lua state
+    if (call.in_place) {
+        // no result, keep string type for compatibility
+        if (lua_isnoneornil(L, -1)) {
+            lua_pop(L, 1);
+            lua_pushstring(L, "");
+        }
+
+    // structured result from another lua state
+    } else if (call.res_mp && s_res != NULL) {
+        if (umlua_mp_decode(L, s_res, sz) != 0) {
+            lua_pushstring(L, "");
+        }
+
+    // binary safe string result (size includes '\0')
+    } else if (s_res != NULL && sz > 0) {
+        lua_pushlstring(L, s_res, sz - 1);
 
     } else {
         lua_pushstring(L, "");
     }
+    free(s_res);
     // status result
     lua_pushnumber(L, res);
 
@@ -473,6 +928,33 @@ mink_lua_do_signal(lua_State *L)
     return 2;
 }
 
+/****************/
+/* auth context */
+/****************/
+int
+mink_lua_do_auth(lua_State *L)
+{
+    // auth context of the running signal
+    const umplg_auth_t *a = umplg_auth_current();
+    if (a == NULL) {
+        return 0;
+    }
+    lua_createtable(L, 0, 4);
+    lua_pushstring(L, "uid");
+    lua_pushinteger(L, a->uid);
+    lua_settable(L, -3);
+    lua_pushstring(L, "flags");
+    lua_pushinteger(L, a->flags);
+    lua_settable(L, -3);
+    lua_pushstring(L, "username");
+    lua_pushstring(L, a->usr);
+    lua_settable(L, -3);
+    lua_pushstring(L, "exp");
+    lua_pushinteger(L, a->exp);
+    lua_settable(L, -3);
+    return 1;
+}
+
 /********************/
 /* perf counter inc */
 /********************/
@@ -499,100 +981,296 @@ mink_lua_do_perf_inc(lua_State *L)
     return 0;
 }
 
-/********************/
-/* perf counter set */
-/********************/
-int
-mink_lua_do_perf_set(lua_State *L)
-{
-    // counter name and value are required
-    if (lua_gettop(L) < 2) {
-        return 0;
-    }
-    // check types
-    if (!lua_isstring(L, 1) || !lua_isnumber(L, 2)) {
-        return 0;
-    }
+/****************************/
+/* perf counter (M.counter) */
+/****************************/
+#define MINK_COUNTER_MT "mink_counter"
 
-    // counter name
-    const char *id = lua_tostring(L, 1);
-    // counter value
-    int val = lua_tonumber(L, 2);
-    // crate counter if needed
-    umc_t *c = umc_new_counter(UMD->perf, id, UMCT_GAUGE);
-    // set perf counter
-    umc_set(c, val);
+// counter handle at index (counters live as long as the perf context)
+static umc_t *
+mink_counter_check(lua_State *L, int idx)
+{
+    umc_t **c = luaL_checkudata(L, idx, MINK_COUNTER_MT);
+    return *c;
+}
 
-    return 0;
+// counter value at index (uint64_t range)
+static uint64_t
+mink_counter_value(lua_State *L, int idx)
+{
+    lua_Number n = luaL_checknumber(L, idx);
+    luaL_argcheck(L,
+                  n >= 0 && n < 18446744073709551616.0,
+                  idx,
+                  "non-negative value expected");
+    return (uint64_t)n;
+}
+
+// c:inc([n])
+static int
+mink_counter_inc(lua_State *L)
+{
+    umc_t *c = mink_counter_check(L, 1);
+    uint64_t inc = lua_isnoneornil(L, 2) ? 1 : mink_counter_value(L, 2);
+    umc_inc(c, inc);
+    return 0;
+}
+
+// c:set(v)
+static int
+mink_counter_set(lua_State *L)
+{
+    umc_t *c = mink_counter_check(L, 1);
+    umc_set(c, mink_counter_value(L, 2));
+    return 0;
+}
+
+// c:get() (lock-free; sums shards of sharded counters)
+static int
+mink_counter_get(lua_State *L)
+{
+    umc_t *c = mink_counter_check(L, 1);
+    lua_pushinteger(L, umc_peek(c));
+    return 1;
+}
+
+static const luaL_Reg mink_counter_methods[] = { { "inc", &mink_counter_inc },
+                                                 { "set", &mink_counter_set },
+                                                 { "get", &mink_counter_get },
+                                                 { NULL, NULL } };
+
+// M.counter(name [, "inc" | "gauge" | "histogram" [, labels]])
+int
+mink_lua_do_counter(lua_State *L)
+{
+    const char *id = luaL_checkstring(L, 1);
+    const char *t = luaL_optstring(L, 2, "inc");
+    enum umc_type type;
+    if (strcmp(t, "inc") == 0) {
+        type = UMCT_INCREMENTAL;
+    } else if (strcmp(t, "gauge") == 0) {
+        type = UMCT_GAUGE;
+    } else if (strcmp(t, "histogram") == 0) {
+        type = UMCT_HISTOGRAM;
+    } else {
+        return luaL_argerror(L,
+                             2,
+                             "'inc', 'gauge' or 'histogram' expected");
+    }
+    // lookup/create once; handle updates counter directly
+    umc_t *c = NULL;
+    // labeled (family member)
+    if (lua_istable(L, 3)) {
+        umc_label_t l[UMC_LABELS_MAX];
+        int nr = 0;
+        // keep converted values referenced
+        lua_newtable(L);
+        int keep = lua_gettop(L);
+        lua_pushnil(L);
+        while (lua_next(L, 3) != 0) {
+            if (lua_type(L, -2) != LUA_TSTRING || !lua_isstring(L, -1)) {
+                return luaL_argerror(L, 3, "string labels expected");
+            }
+            if (nr == UMC_LABELS_MAX) {
+                return luaL_argerror(L, 3, "too many labels");
+            }
+            lua_pushvalue(L, -1);
+            l[nr].value = lua_tostring(L, -1);
+            lua_rawseti(L, keep, nr + 1);
+            l[nr++].key = lua_tostring(L, -2);
+            lua_pop(L, 1);
+        }
+        umc_family_t *f = umc_new_family(UMD->perf, id, type, 0);
+        c = umc_family_get(UMD->perf, f, l, nr);
+        lua_pop(L, 1);
+
+    } else {
+        c = umc_new_counter(UMD->perf, id, type);
+    }
+    if (c == NULL) {
+        return 0;
+    }
+    umc_t **h = lua_newuserdata(L, sizeof(umc_t *));
+    *h = c;
+    // metatable (created once per lua state)
+    if (luaL_newmetatable(L, MINK_COUNTER_MT)) {
+        lua_pushstring(L, "__index");
+        lua_createtable(L, 0, 3);
+        for (const luaL_Reg *r = mink_counter_methods; r->name; r++) {
+            lua_pushstring(L, r->name);
+            lua_pushcfunction(L, r->func);
+            lua_rawset(L, -3);
+        }
+        lua_settable(L, -3);
+    }
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+/********************/
+/* perf counter set */
+/********************/
+int
+mink_lua_do_perf_set(lua_State *L)
+{
+    // counter name and value are required
+    if (lua_gettop(L) < 2) {
+        return 0;
+    }
+    // check types
+    if (!lua_isstring(L, 1) || !lua_isnumber(L, 2)) {
+        return 0;
+    }
+
+    // counter name
+    const char *id = lua_tostring(L, 1);
+    // counter value
+    int val = lua_tonumber(L, 2);
+    // crate counter if needed
+    umc_t *c = umc_new_counter(UMD->perf, id, UMCT_GAUGE);
+    // set perf counter
+    umc_set(c, val);
+
+    return 0;
 }
 
 /***********************/
 /* perf counters match */
 /***********************/
+// matched counter copy (counters are kept in
+// aligned chunks, so values are copied out)
+struct perf_match_d {
+    const char *idp;
+    enum umc_type type;
+    uint64_t last;
+    uint64_t max;
+    double rate;
+    umc_rates_t rates;
+    umc_hist_stats_t hist;
+};
+
 static void
 perf_match_cb(umc_t *c, void *arg)
 {
-    // create temp umc
-    umc_t umc;
+    struct perf_match_d pm;
     // copy id pointer (safe) and type
-    umc.idp = c->idp;
-    umc.type = c->type;
-    // copy last/max/ts_diff/delta values
-    umc.values.last.value = c->values.last.value;
-    umc.values.max = c->values.max;
-    umc.values.delta = c->values.delta;
-    umc.values.ts_diff = c->values.ts_diff;
+    pm.idp = c->idp;
+    pm.type = c->type;
+    // copy last/max values and rates
+    pm.last = c->values.last.value;
+    pm.max = c->values.max;
+    pm.rate = umc_get_rate(c, false);
+    // windowed/EWMA rates
+    umc_get_rates(c, &pm.rates, true);
+    // histogram percentiles
+    umc_get_hist(c, &pm.hist);
     // add to list
     UT_array *lst = arg;
-    utarray_push_back(lst, &umc);
+    utarray_push_back(lst, &pm);
 }
 
-int
-mink_lua_do_perf_match(lua_State *L)
+// push matched counters (table of rows)
+static void
+perf_push_results(lua_State *L, UT_array *lst)
 {
-    // counter name is required
-    if (lua_gettop(L) < 1 || !lua_isstring(L, 1)) {
-        return 0;
-    }
-    // counter name
-    const char *ptrn = lua_tostring(L, 1);
-    // tmp result
-    UT_array *lst;
-    UT_icd umc_icd = { sizeof(umc_t), NULL, NULL, NULL };
-    utarray_new(lst, &umc_icd);
-    umc_match(UMD->perf, ptrn, true, perf_match_cb, lst);
     // generate lua result table
     lua_newtable(L);
     // loop result
-    umc_t *umc_p = NULL;
-    for (umc_p = (umc_t *)utarray_front(lst); umc_p != NULL;
-         umc_p = (umc_t *)utarray_next(lst, umc_p)) {
-
+    struct perf_match_d *pm = NULL;
+    for (pm = (struct perf_match_d *)utarray_front(lst); pm != NULL;
+         pm = (struct perf_match_d *)utarray_next(lst, pm)) {
         // outer table key (counter id)
-        lua_pushstring(L, umc_p->idp);
+        lua_pushstring(L, pm->idp);
         // inner table (row)
         lua_newtable(L);
 
         // last
         lua_pushstring(L, "last");
-        lua_pushnumber(L, umc_p->values.last.value);
+        lua_pushnumber(L, pm->last);
         lua_settable(L, -3);
         // max
-        if (umc_p->type == UMCT_GAUGE) {
+        if (pm->type != UMCT_INCREMENTAL) {
             lua_pushstring(L, "max");
-            lua_pushnumber(L, umc_p->values.max);
+            lua_pushnumber(L, pm->max);
             lua_settable(L, -3);
         }
         // rate
-        if (umc_p->type == UMCT_INCREMENTAL) {
+        if (pm->type == UMCT_INCREMENTAL) {
             lua_pushstring(L, "rate");
-            lua_pushnumber(L, umc_get_rate(umc_p, false));
+            lua_pushnumber(L, pm->rate);
+            lua_settable(L, -3);
+            // windowed and EWMA rates
+            lua_pushstring(L, "rate_win");
+            lua_pushnumber(L, pm->rates.win);
+            lua_settable(L, -3);
+            lua_pushstring(L, "ewma_1s");
+            lua_pushnumber(L, pm->rates.ewma_1s);
+            lua_settable(L, -3);
+            lua_pushstring(L, "ewma_10s");
+            lua_pushnumber(L, pm->rates.ewma_10s);
+            lua_settable(L, -3);
+            lua_pushstring(L, "ewma_60s");
+            lua_pushnumber(L, pm->rates.ewma_60s);
+            lua_settable(L, -3);
+        }
+        // histogram count and percentiles
+        if (pm->type == UMCT_HISTOGRAM) {
+            lua_pushstring(L, "count");
+            lua_pushnumber(L, pm->hist.count);
+            lua_settable(L, -3);
+            lua_pushstring(L, "p50");
+            lua_pushnumber(L, pm->hist.p50);
+            lua_settable(L, -3);
+            lua_pushstring(L, "p90");
+            lua_pushnumber(L, pm->hist.p90);
+            lua_settable(L, -3);
+            lua_pushstring(L, "p99");
+            lua_pushnumber(L, pm->hist.p99);
+            lua_settable(L, -3);
+            lua_pushstring(L, "p999");
+            lua_pushnumber(L, pm->hist.p999);
             lua_settable(L, -3);
         }
 
         // set outer table row
         lua_settable(L, -3);
     }
+}
+
+int
+mink_lua_do_perf_match(lua_State *L)
+{
+    // counter name is required
+    if (lua_gettop(L) < 1 || !lua_isstring(L, 1)) {
+        return 0;
+    }
+    // counter name
+    const char *ptrn = lua_tostring(L, 1);
+    // tmp result
+    UT_array *lst;
+    UT_icd umc_icd = { sizeof(struct perf_match_d), NULL, NULL, NULL };
+    utarray_new(lst, &umc_icd);
+    umc_match(UMD->perf, ptrn, true, perf_match_cb, lst);
+    perf_push_results(L, lst);
+
+    // cleanup
+    utarray_free(lst);
+
+    // one table
+    return 1;
+}
+
+// M.perf_family(name); family members without pattern matching
+int
+mink_lua_do_perf_family(lua_State *L)
+{
+    umc_family_t *f = umc_get_family(UMD->perf, luaL_checkstring(L, 1));
+    // tmp result
+    UT_array *lst;
+    UT_icd umc_icd = { sizeof(struct perf_match_d), NULL, NULL, NULL };
+    utarray_new(lst, &umc_icd);
+    umc_family_iter(f, perf_match_cb, lst);
+    perf_push_results(L, lst);
 
     // cleanup
     utarray_free(lst);
@@ -617,41 +1295,50 @@ mink_lua_do_db_set(lua_State *L)
         return 0;
     }
 
-    // get values
+    // get values (binary safe)
+    size_t k_sz = 0;
+    size_t v_sz = 0;
     const char *db = lua_tostring(L, 1);
-    const char *k = lua_tostring(L, 2);
-    const char *v = lua_tostring(L, 3);
+    const char *k = lua_tolstring(L, 2, &k_sz);
+    const char *v = lua_tolstring(L, 3, &v_sz);
     uint8_t perm = 0;
-    // default = in-mem dbm
-    const char *dbm_name = "mink_dbm_mem";
 
     // perm flag
     if (lua_gettop(L) > 3 && lua_isnumber(L, 4)) {
         perm = (uint8_t)lua_tonumber(L, 4);
-        // switch to permanent dbm
-        if (perm == 1) {
-            dbm_name = "mink_dbm_perm";
-        }
     }
 
-    // get dbm
-    lua_pushstring(L, dbm_name);
-    lua_gettable(L, LUA_REGISTRYINDEX);
-    umdb_mngrd_t *dbm = lua_touserdata(L, -1);
-    lua_pop(L, 1);
+    // permanent dbm
+    if (perm == 1) {
+        // get dbm
+        lua_pushstring(L, "mink_dbm_perm");
+        lua_gettable(L, LUA_REGISTRYINDEX);
+        umdb_mngrd_t *dbm = lua_touserdata(L, -1);
+        lua_pop(L, 1);
 
-    // init storage
-    int r = umdb_mngr_store_init(dbm, db);
-    if (r != 0) {
-        return 0;
-    }
+        // init storage (once per dbm)
+        int r = umdb_mngr_store_init(dbm, db);
+        if (r != 0) {
+            return 0;
+        }
 
-    // set data
-    r = umdb_mngr_store_set(dbm, db, k, v);
-    if (r != 0) {
+        // set data (storage table might have been removed, init
+        // and retry once)
+        r = umdb_mngr_store_set(dbm, db, k, v);
+        if (r > 1 && umdb_mngr_store_init(dbm, db) == 0) {
+            umdb_mngr_store_set(dbm, db, k, v);
+        }
         return 0;
     }
 
+    // default = in-mem dbm
+    lua_pushstring(L, "mink_dbm_mem");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umkv_t *kv = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    // set data
+    umkv_set(kv, db, k, k_sz, v, v_sz);
     return 0;
 }
 
@@ -671,47 +1358,453 @@ mink_lua_do_db_get(lua_State *L)
         return 0;
     }
 
-    // get values
+    // get values (binary safe)
+    size_t k_sz = 0;
     const char *db = lua_tostring(L, 1);
-    const char *k = lua_tostring(L, 2);
+    const char *k = lua_tolstring(L, 2, &k_sz);
     uint8_t perm = 0;
-    // default = in-mem dbm
-    const char *dbm_name = "mink_dbm_mem";
 
     // perm flag
     if (lua_gettop(L) > 2 && lua_isnumber(L, 3)) {
         perm = (uint8_t)lua_tonumber(L, 3);
-        // switch to permanent dbm
-        if (perm == 1) {
-            dbm_name = "mink_dbm_perm";
+    }
+
+    // output buffer
+    char *ob = NULL;
+    size_t ob_sz = 0;
+
+    // permanent dbm
+    if (perm == 1) {
+        // get dbm
+        lua_pushstring(L, "mink_dbm_perm");
+        lua_gettable(L, LUA_REGISTRYINDEX);
+        umdb_mngrd_t *dbm = lua_touserdata(L, -1);
+        lua_pop(L, 1);
+
+        // init storage (once per dbm)
+        int r = umdb_mngr_store_init(dbm, db);
+        if (r != 0) {
+            return 0;
+        }
+
+        // get data (storage table might have been removed, init
+        // and retry once)
+        r = umdb_mngr_store_get(dbm, db, k, &ob, &ob_sz);
+        if (r > 1 && r != 8 && umdb_mngr_store_init(dbm, db) == 0) {
+            r = umdb_mngr_store_get(dbm, db, k, &ob, &ob_sz);
         }
+        if (r != 0) {
+            if (ob_sz > 0) {
+                free(ob);
+            }
+            return 0;
+        }
+
+        lua_pushstring(L, ob);
+        free(ob);
+        return 1;
     }
 
-    // get dbm
-    lua_pushstring(L, dbm_name);
+    // default = in-mem dbm
+    lua_pushstring(L, "mink_dbm_mem");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umkv_t *kv = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    // get data
+    if (umkv_get(kv, db, k, k_sz, &ob, &ob_sz) != 0) {
+        return 0;
+    }
+
+    lua_pushlstring(L, ob, ob_sz);
+    free(ob);
+    return 1;
+}
+
+/*************************/
+/* user data (multi-key) */
+/*************************/
+// perm flag argument
+static uint8_t
+db_perm_flag(lua_State *L, int idx)
+{
+    if (lua_gettop(L) >= idx && lua_isnumber(L, idx)) {
+        return (uint8_t)lua_tonumber(L, idx);
+    }
+    return 0;
+}
+
+// permanent dbm (storage initialized once per dbm)
+static umdb_mngrd_t *
+db_perm_get(lua_State *L, const char *db)
+{
+    lua_pushstring(L, "mink_dbm_perm");
     lua_gettable(L, LUA_REGISTRYINDEX);
     umdb_mngrd_t *dbm = lua_touserdata(L, -1);
     lua_pop(L, 1);
+    if (umdb_mngr_store_init(dbm, db) != 0) {
+        return NULL;
+    }
+    return dbm;
+}
 
-    // init storage
-    int r = umdb_mngr_store_init(dbm, db);
-    if (r != 0) {
+// in-mem dbm
+static umkv_t *
+db_mem_get(lua_State *L)
+{
+    lua_pushstring(L, "mink_dbm_mem");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umkv_t *kv = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return kv;
+}
+
+// add key/value to result table (top of the stack)
+static void
+db_push_cb(const char *k, const char *v, void *arg)
+{
+    lua_State *L = arg;
+    lua_pushstring(L, v);
+    lua_setfield(L, -2, k);
+}
+
+static void
+db_kv_push_cb(const char *k,
+              size_t k_sz,
+              const char *v,
+              size_t v_sz,
+              void *arg)
+{
+    lua_State *L = arg;
+    lua_pushlstring(L, k, k_sz);
+    lua_pushlstring(L, v, v_sz);
+    lua_rawset(L, -3);
+}
+
+int
+mink_lua_do_db_mget(lua_State *L)
+{
+    // db name and key list are required
+    if (lua_gettop(L) < 2 || !lua_isstring(L, 1) || !lua_istable(L, 2)) {
         return 0;
     }
+    const char *db = lua_tostring(L, 1);
+    uint8_t perm = db_perm_flag(L, 3);
+
+    // keys (converted copies are kept in a scratch table,
+    // string pointers remain valid until return)
+    size_t nr = lua_rawlen(L, 2);
+    const char **keys = malloc((nr + 1) * sizeof(char *));
+    size_t *k_szs = malloc((nr + 1) * sizeof(size_t));
+    if (keys == NULL || k_szs == NULL) {
+        free(keys);
+        free(k_szs);
+        return 0;
+    }
+    lua_createtable(L, nr, 0);
+    int sc = lua_gettop(L);
+    size_t n = 0;
+    for (size_t i = 1; i <= nr; i++) {
+        lua_rawgeti(L, 2, i);
+        if (lua_isstring(L, -1)) {
+            keys[n] = lua_tolstring(L, -1, &k_szs[n]);
+            lua_rawseti(L, sc, ++n);
+        } else {
+            lua_pop(L, 1);
+        }
+    }
 
-    // get data
-    char *ob = NULL;
-    size_t ob_sz = 0;
-    r = umdb_mngr_store_get(dbm, db, k, &ob, &ob_sz);
-    if (r != 0) {
-        if (ob_sz > 0) {
-            free(ob);
+    // result table (missing keys are not included)
+    lua_newtable(L);
+    int r = 0;
+
+    // permanent dbm (one read transaction)
+    if (perm == 1) {
+        umdb_mngrd_t *dbm = db_perm_get(L, db);
+        r = dbm != NULL ? umdb_mngr_store_mget(dbm, db, keys, n, &db_push_cb, L)
+                        : 1;
+        // storage table might have been removed, init and
+        // retry once
+        if (r == 3 && umdb_mngr_store_init(dbm, db) == 0) {
+            r = umdb_mngr_store_mget(dbm, db, keys, n, &db_push_cb, L);
         }
+
+    // default = in-mem dbm
+    } else {
+        r = umkv_mget(db_mem_get(L), db, keys, k_szs, n, &db_kv_push_cb, L);
+    }
+
+    // cleanup
+    free(keys);
+    free(k_szs);
+    return r == 0 ? 1 : 0;
+}
+
+int
+mink_lua_do_db_mset(lua_State *L)
+{
+    // db name and key/value table are required
+    if (lua_gettop(L) < 2 || !lua_isstring(L, 1) || !lua_istable(L, 2)) {
         return 0;
     }
+    const char *db = lua_tostring(L, 1);
+    uint8_t perm = db_perm_flag(L, 3);
 
-    lua_pushstring(L, ob);
-    free(ob);
+    // number of pairs
+    size_t nr = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 2) != 0) {
+        ++nr;
+        lua_pop(L, 1);
+    }
+    const char **keys = malloc((nr + 1) * sizeof(char *));
+    const char **values = malloc((nr + 1) * sizeof(char *));
+    size_t *k_szs = malloc((nr + 1) * sizeof(size_t));
+    size_t *v_szs = malloc((nr + 1) * sizeof(size_t));
+    if (keys == NULL || values == NULL || k_szs == NULL || v_szs == NULL) {
+        free(keys);
+        free(values);
+        free(k_szs);
+        free(v_szs);
+        return 0;
+    }
+
+    // string keys; values are converted in a scratch table
+    // (string pointers remain valid until return)
+    lua_createtable(L, nr, 0);
+    int sc = lua_gettop(L);
+    size_t n = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 2) != 0) {
+        if (lua_type(L, -2) == LUA_TSTRING && lua_isstring(L, -1)) {
+            keys[n] = lua_tolstring(L, -2, &k_szs[n]);
+            lua_pushvalue(L, -1);
+            values[n] = lua_tolstring(L, -1, &v_szs[n]);
+            lua_rawseti(L, sc, ++n);
+        }
+        lua_pop(L, 1);
+    }
+
+    // permanent dbm (one transaction)
+    if (perm == 1) {
+        umdb_mngrd_t *dbm = db_perm_get(L, db);
+        if (dbm != NULL) {
+            // storage table might have been removed, init and
+            // retry once (failed transaction is rolled back)
+            int r = umdb_mngr_store_mset(dbm, db, keys, values, n);
+            if (r > 1 && umdb_mngr_store_init(dbm, db) == 0) {
+                umdb_mngr_store_mset(dbm, db, keys, values, n);
+            }
+        }
+
+    // default = in-mem dbm
+    } else {
+        umkv_mset(db_mem_get(L), db, keys, k_szs, values, v_szs, n);
+    }
+
+    // cleanup
+    free(keys);
+    free(values);
+    free(k_szs);
+    free(v_szs);
+    return 0;
+}
+
+int
+mink_lua_do_db_scan(lua_State *L)
+{
+    // db name and key prefix are required
+    if (lua_gettop(L) < 2 || !lua_isstring(L, 1) || !lua_isstring(L, 2)) {
+        return 0;
+    }
+    size_t p_sz = 0;
+    const char *db = lua_tostring(L, 1);
+    const char *p = lua_tolstring(L, 2, &p_sz);
+    int limit = 0;
+    if (lua_gettop(L) > 2 && lua_isnumber(L, 3)) {
+        limit = (int)lua_tonumber(L, 3);
+    }
+    uint8_t perm = db_perm_flag(L, 4);
+
+    // result table
+    lua_newtable(L);
+    int r = 0;
+
+    // permanent dbm (ordered by key)
+    if (perm == 1) {
+        umdb_mngrd_t *dbm = db_perm_get(L, db);
+        r = dbm != NULL ?
+                umdb_mngr_store_scan(dbm, db, p, limit, &db_push_cb, L) :
+                1;
+        // storage table might have been removed, init and
+        // retry once
+        if (r == 3 && umdb_mngr_store_init(dbm, db) == 0) {
+            r = umdb_mngr_store_scan(dbm, db, p, limit, &db_push_cb, L);
+        }
+
+    // default = in-mem dbm (unordered)
+    } else {
+        r = umkv_scan(db_mem_get(L), db, p, p_sz, limit, &db_kv_push_cb, L);
+        r = r < 0 ? 1 : 0;
+    }
+
+    return r == 0 ? 1 : 0;
+}
+
+int
+mink_lua_do_db_del(lua_State *L)
+{
+    // db name and key are required
+    if (lua_gettop(L) < 2 || !lua_isstring(L, 1) || !lua_isstring(L, 2)) {
+        return 0;
+    }
+    size_t k_sz = 0;
+    const char *db = lua_tostring(L, 1);
+    const char *k = lua_tolstring(L, 2, &k_sz);
+    uint8_t perm = db_perm_flag(L, 3);
+
+    // permanent dbm
+    if (perm == 1) {
+        umdb_mngrd_t *dbm = db_perm_get(L, db);
+        if (dbm == NULL) {
+            return 0;
+        }
+        // storage table might have been removed, init and
+        // retry once
+        int r = umdb_mngr_store_del(dbm, db, k);
+        if (r > 1 && umdb_mngr_store_init(dbm, db) == 0) {
+            umdb_mngr_store_del(dbm, db, k);
+        }
+        return 0;
+    }
+
+    // default = in-mem dbm
+    umkv_del(db_mem_get(L), db, k, k_sz);
+    return 0;
+}
+
+/****************************/
+/* user data (atomic r/m/w) */
+/****************************/
+int
+mink_lua_do_db_incr(lua_State *L)
+{
+    // db name and key are required
+    if (lua_gettop(L) < 2 || !lua_isstring(L, 1) || !lua_isstring(L, 2)) {
+        return 0;
+    }
+    size_t k_sz = 0;
+    const char *db = lua_tostring(L, 1);
+    const char *k = lua_tolstring(L, 2, &k_sz);
+    // increment (default = 1)
+    int64_t delta = 1;
+    if (lua_gettop(L) > 2 && lua_isnumber(L, 3)) {
+        delta = (int64_t)lua_tonumber(L, 3);
+    }
+    uint8_t perm = db_perm_flag(L, 4);
+    int64_t nv = 0;
+    int r = 0;
+
+    // permanent dbm (one upsert statement)
+    if (perm == 1) {
+        umdb_mngrd_t *dbm = db_perm_get(L, db);
+        if (dbm == NULL) {
+            return 0;
+        }
+        // storage table might have been removed, init and
+        // retry once
+        r = umdb_mngr_store_incr(dbm, db, k, delta, &nv);
+        if (r > 1 && umdb_mngr_store_init(dbm, db) == 0) {
+            r = umdb_mngr_store_incr(dbm, db, k, delta, &nv);
+        }
+
+    // default = in-mem dbm
+    } else {
+        r = umkv_incr(db_mem_get(L), db, k, k_sz, delta, &nv);
+    }
+    if (r != 0) {
+        return 0;
+    }
+
+    // new value
+    lua_pushinteger(L, nv);
     return 1;
 }
 
+int
+mink_lua_do_db_cas(lua_State *L)
+{
+    // db name, key, expected value (nil = key must not
+    // exist) and new value are required
+    if (lua_gettop(L) < 4 || !lua_isstring(L, 1) || !lua_isstring(L, 2) ||
+        !(lua_isnil(L, 3) || lua_isstring(L, 3)) || !lua_isstring(L, 4)) {
+        return 0;
+    }
+    size_t k_sz = 0;
+    size_t old_sz = 0;
+    size_t v_sz = 0;
+    const char *db = lua_tostring(L, 1);
+    const char *k = lua_tolstring(L, 2, &k_sz);
+    const char *old = lua_isnil(L, 3) ? NULL : lua_tolstring(L, 3, &old_sz);
+    const char *v = lua_tolstring(L, 4, &v_sz);
+    uint8_t perm = db_perm_flag(L, 5);
+    int r = 0;
+
+    // permanent dbm (one statement)
+    if (perm == 1) {
+        umdb_mngrd_t *dbm = db_perm_get(L, db);
+        if (dbm == NULL) {
+            return 0;
+        }
+        // storage table might have been removed, init and
+        // retry once
+        r = umdb_mngr_store_cas(dbm, db, k, old, v);
+        if (r > 1 && r != 8 && umdb_mngr_store_init(dbm, db) == 0) {
+            r = umdb_mngr_store_cas(dbm, db, k, old, v);
+        }
+        if (r != 0 && r != 8) {
+            return 0;
+        }
+
+    // default = in-mem dbm
+    } else {
+        r = umkv_cas(db_mem_get(L), db, k, k_sz, old, old_sz, v, v_sz);
+        if (r != 0 && r != 3) {
+            return 0;
+        }
+    }
+
+    // value set
+    lua_pushboolean(L, r == 0);
+    return 1;
+}
+
+int
+mink_lua_do_db_watch(lua_State *L)
+{
+    // db name, key (or prefix ending with '*') and
+    // signal name are required
+    if (lua_gettop(L) < 3 || !lua_isstring(L, 1) || !lua_isstring(L, 2) ||
+        !lua_isstring(L, 3)) {
+        return 0;
+    }
+    const char *db = lua_tostring(L, 1);
+    const char *k = lua_tostring(L, 2);
+    const char *sig = lua_tostring(L, 3);
+
+    // permanent dbm and key change dispatcher (signal
+    // handlers that change watched keys are notified
+    // again, unchanged values are not)
+    lua_pushstring(L, "mink_dbm_perm");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umdb_mngrd_t *dbm = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    lua_pushstring(L, "mink_dbm_watch");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    struct umlua_watchd *wd = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    // watch registered
+    lua_pushboolean(L, umlua_watch_add(wd, dbm, db, k, sig) == 0);
+    return 1;
+}
@@ -0,0 +1,503 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <luaconf.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <umlua.h>
+
+/*
+ * MessagePack subset used for passing Lua values between Lua states:
+ * nil, booleans, integers, doubles, strings (str/bin) arrays and maps
+ */
+
+#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM == 501
+#    define lua_rawlen(L, i) lua_objlen(L, i)
+#    define lua_absindex(L, i) \
+        ((i) > 0 || (i) <= LUA_REGISTRYINDEX ? (i) : lua_gettop(L) + (i) + 1)
+#endif
+
+// max nesting level (also prevents cyclic tables)
+#define MP_MAX_DEPTH 32
+
+/*****************/
+/* output buffer */
+/*****************/
+struct mp_buff {
+    char *b;
+    size_t len;
+    size_t cap;
+};
+
+static int
+mp_reserve(struct mp_buff *mb, size_t sz)
+{
+    if (mb->len + sz <= mb->cap) {
+        return 0;
+    }
+    size_t cap = (mb->cap > 0 ? mb->cap : 64);
+    while (cap < mb->len + sz) {
+        cap *= 2;
+    }
+    char *b = realloc(mb->b, cap);
+    if (b == NULL) {
+        return 1;
+    }
+    mb->b = b;
+    mb->cap = cap;
+    return 0;
+}
+
+static int
+mp_put(struct mp_buff *mb, const void *d, size_t sz)
+{
+    if (mp_reserve(mb, sz)) {
+        return 1;
+    }
+    memcpy(mb->b + mb->len, d, sz);
+    mb->len += sz;
+    return 0;
+}
+
+// type byte followed by big-endian value of 'sz' bytes
+static int
+mp_put_be(struct mp_buff *mb, uint8_t t, uint64_t v, int sz)
+{
+    uint8_t b[9];
+    b[0] = t;
+    for (int i = 0; i < sz; i++) {
+        b[sz - i] = (uint8_t)(v >> (i * 8));
+    }
+    return mp_put(mb, b, sz + 1);
+}
+
+/************/
+/* encoding */
+/************/
+static int
+mp_enc_int(struct mp_buff *mb, int64_t v)
+{
+    // fixint
+    if (v >= 0 && v <= 0x7f) {
+        uint8_t b = v;
+        return mp_put(mb, &b, 1);
+    }
+    if (v < 0 && v >= -32) {
+        uint8_t b = (uint8_t)(int8_t)v;
+        return mp_put(mb, &b, 1);
+    }
+    // unsigned
+    if (v > 0) {
+        if (v <= UINT8_MAX) {
+            return mp_put_be(mb, 0xcc, v, 1);
+        }
+        if (v <= UINT16_MAX) {
+            return mp_put_be(mb, 0xcd, v, 2);
+        }
+        if (v <= UINT32_MAX) {
+            return mp_put_be(mb, 0xce, v, 4);
+        }
+        return mp_put_be(mb, 0xcf, v, 8);
+    }
+    // signed
+    if (v >= INT8_MIN) {
+        return mp_put_be(mb, 0xd0, (uint8_t)v, 1);
+    }
+    if (v >= INT16_MIN) {
+        return mp_put_be(mb, 0xd1, (uint16_t)v, 2);
+    }
+    if (v >= INT32_MIN) {
+        return mp_put_be(mb, 0xd2, (uint32_t)v, 4);
+    }
+    return mp_put_be(mb, 0xd3, (uint64_t)v, 8);
+}
+
+static int
+mp_enc_number(lua_State *L, int idx, struct mp_buff *mb)
+{
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(L, idx)) {
+        return mp_enc_int(mb, lua_tointeger(L, idx));
+    }
+#endif
+    lua_Number n = lua_tonumber(L, idx);
+#if LUA_VERSION_NUM < 503
+    // integral numbers
+    if (n == floor(n) && n >= -9007199254740992.0 &&
+        n <= 9007199254740992.0) {
+        return mp_enc_int(mb, (int64_t)n);
+    }
+#endif
+    double d = n;
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    return mp_put_be(mb, 0xcb, u, 8);
+}
+
+static int
+mp_enc_str(struct mp_buff *mb, const char *s, size_t sz)
+{
+    int r;
+    if (sz < 32) {
+        uint8_t b = 0xa0 | sz;
+        r = mp_put(mb, &b, 1);
+    } else if (sz <= UINT8_MAX) {
+        r = mp_put_be(mb, 0xd9, sz, 1);
+    } else if (sz <= UINT16_MAX) {
+        r = mp_put_be(mb, 0xda, sz, 2);
+    } else {
+        r = mp_put_be(mb, 0xdb, sz, 4);
+    }
+    return (r ? r : mp_put(mb, s, sz));
+}
+
+static int
+mp_enc_hdr(struct mp_buff *mb, bool map, size_t n)
+{
+    if (n < 16) {
+        uint8_t b = (map ? 0x80 : 0x90) | n;
+        return mp_put(mb, &b, 1);
+    }
+    if (n <= UINT16_MAX) {
+        return mp_put_be(mb, (map ? 0xde : 0xdc), n, 2);
+    }
+    return mp_put_be(mb, (map ? 0xdf : 0xdd), n, 4);
+}
+
+static int mp_enc_value(lua_State *L, int idx, struct mp_buff *mb, int depth);
+
+static int
+mp_enc_table(lua_State *L, int idx, struct mp_buff *mb, int depth)
+{
+    if (depth >= MP_MAX_DEPTH || !lua_checkstack(L, 3)) {
+        return 2;
+    }
+    // array check; keys must be 1..n
+    size_t n = lua_rawlen(L, idx);
+    size_t cnt = 0;
+    bool arr = true;
+    lua_pushnil(L);
+    while (lua_next(L, idx) != 0) {
+        ++cnt;
+        if (arr) {
+            if (lua_type(L, -2) != LUA_TNUMBER) {
+                arr = false;
+            } else {
+                lua_Number k = lua_tonumber(L, -2);
+                if (k != floor(k) || k < 1 || k > n) {
+                    arr = false;
+                }
+            }
+        }
+        lua_pop(L, 1);
+    }
+    // empty tables are encoded as maps
+    arr = arr && cnt == n && n > 0;
+
+    // array
+    if (arr) {
+        if (mp_enc_hdr(mb, false, n)) {
+            return 1;
+        }
+        for (size_t i = 1; i <= n; i++) {
+            lua_rawgeti(L, idx, i);
+            int r = mp_enc_value(L, lua_gettop(L), mb, depth + 1);
+            lua_pop(L, 1);
+            if (r) {
+                return r;
+            }
+        }
+        return 0;
+    }
+
+    // map
+    if (mp_enc_hdr(mb, true, cnt)) {
+        return 1;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, idx) != 0) {
+        int top = lua_gettop(L);
+        int r = mp_enc_value(L, top - 1, mb, depth + 1);
+        if (!r) {
+            r = mp_enc_value(L, top, mb, depth + 1);
+        }
+        if (r) {
+            lua_pop(L, 2);
+            return r;
+        }
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+static int
+mp_enc_value(lua_State *L, int idx, struct mp_buff *mb, int depth)
+{
+    uint8_t b;
+    switch (lua_type(L, idx)) {
+    case LUA_TNIL:
+        b = 0xc0;
+        return mp_put(mb, &b, 1);
+    case LUA_TBOOLEAN:
+        b = (lua_toboolean(L, idx) ? 0xc3 : 0xc2);
+        return mp_put(mb, &b, 1);
+    case LUA_TNUMBER:
+        return mp_enc_number(L, idx, mb);
+    case LUA_TSTRING: {
+        size_t sz = 0;
+        const char *s = lua_tolstring(L, idx, &sz);
+        return mp_enc_str(mb, s, sz);
+    }
+    case LUA_TTABLE:
+        return mp_enc_table(L, idx, mb, depth);
+    // M.get_args() view (copied)
+    case LUA_TUSERDATA: {
+        if (!umlua_args_totable(L, idx)) {
+            return 3;
+        }
+        int r = mp_enc_table(L, lua_gettop(L), mb, depth);
+        lua_pop(L, 1);
+        return r;
+    }
+    // functions, other userdata and threads cannot leave
+    // the lua state
+    default:
+        return 3;
+    }
+}
+
+int
+umlua_mp_encode(lua_State *L, int idx, char **out, size_t *out_sz)
+{
+    if (L == NULL || out == NULL || out_sz == NULL) {
+        return 1;
+    }
+    struct mp_buff mb = { NULL, 0, 0 };
+    int r = mp_enc_value(L, lua_absindex(L, idx), &mb, 0);
+    if (r) {
+        free(mb.b);
+        return r;
+    }
+    *out = mb.b;
+    *out_sz = mb.len;
+    return 0;
+}
+
+/************/
+/* decoding */
+/************/
+struct mp_rd {
+    const uint8_t *b;
+    size_t sz;
+    size_t pos;
+};
+
+static int
+mp_get_be(struct mp_rd *rd, int sz, uint64_t *v)
+{
+    if (rd->pos + sz > rd->sz) {
+        return 1;
+    }
+    *v = 0;
+    for (int i = 0; i < sz; i++) {
+        *v = (*v << 8) | rd->b[rd->pos++];
+    }
+    return 0;
+}
+
+static int mp_dec_value(lua_State *L, struct mp_rd *rd, int depth);
+
+static int
+mp_dec_str(lua_State *L, struct mp_rd *rd, size_t sz)
+{
+    if (rd->pos + sz > rd->sz) {
+        return 1;
+    }
+    lua_pushlstring(L, (const char *)rd->b + rd->pos, sz);
+    rd->pos += sz;
+    return 0;
+}
+
+static int
+mp_dec_array(lua_State *L, struct mp_rd *rd, size_t n, int depth)
+{
+    // each element needs at least one byte
+    if (n > rd->sz - rd->pos) {
+        return 1;
+    }
+    lua_createtable(L, n, 0);
+    for (size_t i = 1; i <= n; i++) {
+        if (mp_dec_value(L, rd, depth + 1)) {
+            return 1;
+        }
+        lua_rawseti(L, -2, i);
+    }
+    return 0;
+}
+
+static int
+mp_dec_map(lua_State *L, struct mp_rd *rd, size_t n, int depth)
+{
+    // each pair needs at least two bytes
+    if (n > (rd->sz - rd->pos) / 2) {
+        return 1;
+    }
+    lua_createtable(L, 0, n);
+    for (size_t i = 0; i < n; i++) {
+        if (mp_dec_value(L, rd, depth + 1) ||
+            mp_dec_value(L, rd, depth + 1)) {
+            return 1;
+        }
+        // nil keys cannot be stored
+        if (lua_isnil(L, -2)) {
+            lua_pop(L, 2);
+            continue;
+        }
+        lua_rawset(L, -3);
+    }
+    return 0;
+}
+
+static int
+mp_dec_value(lua_State *L, struct mp_rd *rd, int depth)
+{
+    if (depth >= MP_MAX_DEPTH || rd->pos >= rd->sz || !lua_checkstack(L, 3)) {
+        return 1;
+    }
+    uint8_t t = rd->b[rd->pos++];
+    uint64_t v = 0;
+
+    // fixint
+    if (t <= 0x7f) {
+        lua_pushinteger(L, t);
+        return 0;
+    }
+    if (t >= 0xe0) {
+        lua_pushinteger(L, (int8_t)t);
+        return 0;
+    }
+    // fixmap, fixarray, fixstr
+    if ((t & 0xf0) == 0x80) {
+        return mp_dec_map(L, rd, t & 0x0f, depth);
+    }
+    if ((t & 0xf0) == 0x90) {
+        return mp_dec_array(L, rd, t & 0x0f, depth);
+    }
+    if ((t & 0xe0) == 0xa0) {
+        return mp_dec_str(L, rd, t & 0x1f);
+    }
+
+    switch (t) {
+    case 0xc0:
+        lua_pushnil(L);
+        return 0;
+    case 0xc2:
+    case 0xc3:
+        lua_pushboolean(L, t == 0xc3);
+        return 0;
+    // bin/str
+    case 0xc4:
+    case 0xd9:
+        return mp_get_be(rd, 1, &v) || mp_dec_str(L, rd, v);
+    case 0xc5:
+    case 0xda:
+        return mp_get_be(rd, 2, &v) || mp_dec_str(L, rd, v);
+    case 0xc6:
+    case 0xdb:
+        return mp_get_be(rd, 4, &v) || mp_dec_str(L, rd, v);
+    // float
+    case 0xca: {
+        if (mp_get_be(rd, 4, &v)) {
+            return 1;
+        }
+        uint32_t u = v;
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        lua_pushnumber(L, f);
+        return 0;
+    }
+    case 0xcb: {
+        if (mp_get_be(rd, 8, &v)) {
+            return 1;
+        }
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        lua_pushnumber(L, d);
+        return 0;
+    }
+    // unsigned
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+        if (mp_get_be(rd, 1 << (t - 0xcc), &v)) {
+            return 1;
+        }
+        lua_pushinteger(L, (lua_Integer)v);
+        return 0;
+    // signed
+    case 0xd0:
+        if (mp_get_be(rd, 1, &v)) {
+            return 1;
+        }
+        lua_pushinteger(L, (int8_t)v);
+        return 0;
+    case 0xd1:
+        if (mp_get_be(rd, 2, &v)) {
+            return 1;
+        }
+        lua_pushinteger(L, (int16_t)v);
+        return 0;
+    case 0xd2:
+        if (mp_get_be(rd, 4, &v)) {
+            return 1;
+        }
+        lua_pushinteger(L, (int32_t)v);
+        return 0;
+    case 0xd3:
+        if (mp_get_be(rd, 8, &v)) {
+            return 1;
+        }
+        lua_pushinteger(L, (lua_Integer)(int64_t)v);
+        return 0;
+    // array/map
+    case 0xdc:
+        return mp_get_be(rd, 2, &v) || mp_dec_array(L, rd, v, depth);
+    case 0xdd:
+        return mp_get_be(rd, 4, &v) || mp_dec_array(L, rd, v, depth);
+    case 0xde:
+        return mp_get_be(rd, 2, &v) || mp_dec_map(L, rd, v, depth);
+    case 0xdf:
+        return mp_get_be(rd, 4, &v) || mp_dec_map(L, rd, v, depth);
+    // ext types are not used
+    default:
+        return 1;
+    }
+}
+
+int
+umlua_mp_decode(lua_State *L, const char *b, size_t sz)
+{
+    if (L == NULL || b == NULL) {
+        return 1;
+    }
+    int top = lua_gettop(L);
+    struct mp_rd rd = { (const uint8_t *)b, sz, 0 };
+    // malformed or trailing data
+    if (mp_dec_value(L, &rd, 0) || rd.pos != sz) {
+        lua_settop(L, top);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <umlua.h>
+
+/*
+ * Permanent DB key change dispatcher (M.db_watch):
+ *  - key changes are queued by umdb watch callbacks
+ *  - pending changes of the same signal, db and key are
+ *    merged (first old value, latest new value); changes
+ *    back to the old value are dropped
+ *  - signals are run by the dispatcher thread, in queue order
+ */
+
+// max number of pending notifications (new keys are
+// dropped and counted in lua.watch.dropped when reached)
+#define UMLUA_WATCH_MAX 4096
+
+static void
+wev_free(struct umlua_wev *e)
+{
+    free(e->key);
+    free(e->old);
+    free(e->v);
+    free(e);
+}
+
+static char *
+wev_strdup(const char *s)
+{
+    return s != NULL ? strdup(s) : NULL;
+}
+
+// same value (NULL = missing)
+static bool
+wev_same(const char *a, const char *b)
+{
+    return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+// umdb watch callback (DB manager locks held, queue only)
+static void
+watch_cb(const umdb_watch_t *w, const char *k, const char *old, const char *v)
+{
+    struct umlua_watchd *wd = w->arg;
+    // dedup key (signal, db and data key)
+    size_t s_sz = strlen(w->name) + 1;
+    size_t d_sz = strlen(w->db) + 1;
+    size_t k_sz = strlen(k);
+    size_t sz = s_sz + d_sz + k_sz;
+    char *key = malloc(sz + 1);
+    if (key == NULL) {
+        umc_inc(wd->dropped, 1);
+        return;
+    }
+    memcpy(key, w->name, s_sz);
+    memcpy(key + s_sz, w->db, d_sz);
+    memcpy(key + s_sz + d_sz, k, k_sz + 1);
+
+    pthread_mutex_lock(&wd->mtx);
+    if (wd->stop) {
+        pthread_mutex_unlock(&wd->mtx);
+        free(key);
+        return;
+    }
+    struct umlua_wev *e = NULL;
+    HASH_FIND(hh, wd->pending, key, sz, e); // GCOVR_EXCL_BR_LINE
+    // merge with pending notification (keep first old value)
+    if (e != NULL) {
+        free(key);
+        char *nv = wev_strdup(v);
+        if (v != NULL && nv == NULL) {
+            pthread_mutex_unlock(&wd->mtx);
+            umc_inc(wd->dropped, 1);
+            return;
+        }
+        free(e->v);
+        e->v = nv;
+        // changed back to old value (nothing to notify)
+        if (wev_same(e->old, e->v)) {
+            HASH_DEL(wd->pending, e); // GCOVR_EXCL_BR_LINE
+            wev_free(e);
+            pthread_cond_broadcast(&wd->cond);
+        }
+
+    // new notification
+    } else if (HASH_COUNT(wd->pending) < UMLUA_WATCH_MAX) {
+        wd->full = false;
+        e = calloc(1, sizeof(struct umlua_wev));
+        if (e == NULL) {
+            pthread_mutex_unlock(&wd->mtx);
+            free(key);
+            umc_inc(wd->dropped, 1);
+            return;
+        }
+        e->key = key;
+        e->key_sz = sz;
+        e->old = wev_strdup(old);
+        e->v = wev_strdup(v);
+        if ((old != NULL && e->old == NULL) || (v != NULL && e->v == NULL)) {
+            pthread_mutex_unlock(&wd->mtx);
+            wev_free(e);
+            umc_inc(wd->dropped, 1);
+            return;
+        }
+        // GCOVR_EXCL_BR_START
+        HASH_ADD_KEYPTR(hh,
+                        wd->pending,
+                        e->key,
+                        e->key_sz,
+                        e);
+        // GCOVR_EXCL_BR_STOP
+        pthread_cond_broadcast(&wd->cond);
+
+    // queue full
+    } else {
+        free(key);
+        umc_inc(wd->dropped, 1);
+        if (!wd->full) {
+            wd->full = true;
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [db_watch queue full (%d), dropping "
+                    "notifications]",
+                    UMLUA_WATCH_MAX);
+        }
+    }
+    pthread_mutex_unlock(&wd->mtx);
+}
+
+// run signal (named columns: db, key, old, new)
+static void
+watch_dispatch(struct umlua_watchd *wd, struct umlua_wev *e)
+{
+    const char *sig = e->key;
+    const char *db = sig + strlen(sig) + 1;
+    const char *k = db + strlen(db) + 1;
+
+    // create std data
+    umplg_data_std_t e_d = { .items = NULL };
+    umplg_data_std_items_t items = { .table = NULL };
+    umplg_data_std_item_t it_db = { .name = "db", .value = (char *)db };
+    umplg_data_std_item_t it_k = { .name = "key", .value = (char *)k };
+    umplg_data_std_item_t it_old = { .name = "old", .value = e->old };
+    umplg_data_std_item_t it_v = { .name = "new", .value = e->v };
+    // init std data
+    umplg_stdd_init(&e_d);
+    umplg_stdd_item_add(&items, &it_db);
+    umplg_stdd_item_add(&items, &it_k);
+    // missing values (new or deleted key) are nil
+    if (e->old != NULL) {
+        umplg_stdd_item_add(&items, &it_old);
+    }
+    if (e->v != NULL) {
+        umplg_stdd_item_add(&items, &it_v);
+    }
+    umplg_stdd_items_add(&e_d, &items);
+    // output buffer (allocated in signal handler)
+    char *b = NULL;
+    size_t b_sz = 0;
+    // process signal (result is not used)
+    umplg_proc_signal(wd->pm, sig, &e_d, &b, &b_sz, 0, NULL);
+    // cleanup
+    free(b);
+    HASH_CLEAR(hh, items.table);
+    umplg_stdd_free(&e_d);
+}
+
+static void *
+th_watch(void *arg)
+{
+    struct umlua_watchd *wd = arg;
+    pthread_mutex_lock(&wd->mtx);
+    while (!wd->stop) {
+        // oldest pending notification
+        struct umlua_wev *e = wd->pending;
+        if (e == NULL) {
+            pthread_cond_wait(&wd->cond, &wd->mtx);
+            continue;
+        }
+        HASH_DEL(wd->pending, e); // GCOVR_EXCL_BR_LINE
+        wd->busy = true;
+        // run signal unlocked (handlers might change
+        // watched keys)
+        pthread_mutex_unlock(&wd->mtx);
+        watch_dispatch(wd, e);
+        wev_free(e);
+        pthread_mutex_lock(&wd->mtx);
+        wd->busy = false;
+        pthread_cond_broadcast(&wd->cond);
+    }
+    pthread_mutex_unlock(&wd->mtx);
+    return NULL;
+}
+
+struct umlua_watchd *
+umlua_watch_new(umplg_mngr_t *pm)
+{
+    struct umlua_watchd *wd = calloc(1, sizeof(struct umlua_watchd));
+    if (wd == NULL) {
+        return NULL;
+    }
+    wd->pm = pm;
+    if (UMD != NULL) {
+        wd->dropped = umc_new_counter(UMD->perf,
+                                      "lua.watch.dropped",
+                                      UMCT_INCREMENTAL);
+    }
+    pthread_mutex_init(&wd->mtx, NULL);
+    pthread_cond_init(&wd->cond, NULL);
+    if (pthread_create(&wd->th, NULL, &th_watch, wd) != 0) {
+        pthread_cond_destroy(&wd->cond);
+        pthread_mutex_destroy(&wd->mtx);
+        free(wd);
+        return NULL;
+    }
+    return wd;
+}
+
+void
+umlua_watch_stop(struct umlua_watchd *wd)
+{
+    if (wd == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&wd->mtx);
+    if (wd->stop) {
+        pthread_mutex_unlock(&wd->mtx);
+        return;
+    }
+    wd->stop = true;
+    pthread_cond_broadcast(&wd->cond);
+    pthread_mutex_unlock(&wd->mtx);
+    pthread_join(wd->th, NULL);
+
+    // drop pending notifications
+    struct umlua_wev *e = NULL;
+    struct umlua_wev *tmp = NULL;
+    pthread_mutex_lock(&wd->mtx);
+    HASH_ITER(hh, wd->pending, e, tmp) {
+        HASH_DEL(wd->pending, e); // GCOVR_EXCL_BR_LINE
+        wev_free(e);
+    }
+    pthread_cond_broadcast(&wd->cond);
+    pthread_mutex_unlock(&wd->mtx);
+}
+
+void
+umlua_watch_free(struct umlua_watchd *wd)
+{
+    if (wd == NULL) {
+        return;
+    }
+    umlua_watch_stop(wd);
+    pthread_cond_destroy(&wd->cond);
+    pthread_mutex_destroy(&wd->mtx);
+    free(wd);
+}
+
+int
+umlua_watch_add(struct umlua_watchd *wd,
+                umdb_mngrd_t *dbm,
+                const char *db,
+                const char *k,
+                const char *sig)
+{
+    if (wd == NULL || dbm == NULL || sig == NULL) {
+        return 1;
+    }
+    return umdb_mngr_watch(dbm, db, k, sig, &watch_cb, wd);
+}
+
+void
+umlua_watch_wait(struct umlua_watchd *wd)
+{
+    if (wd == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&wd->mtx);
+    while (!wd->stop && (wd->pending != NULL || wd->busy)) {
+        pthread_cond_wait(&wd->cond, &wd->mtx);
+    }
+    pthread_mutex_unlock(&wd->mtx);
+}
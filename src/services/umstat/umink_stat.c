@@ -0,0 +1,165 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <umink_pkg_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <fnmatch.h>
+#include <umcshm.h>
+
+// program name and description
+static const char *UMS_TYPE = "umink-stat";
+static const char *UMS_DESCRIPTION = "umINK counter segment reader";
+
+// output options
+typedef struct {
+    const char *ptrn;
+    int matched;
+} umstat_opts_t;
+
+// help
+static void
+print_help()
+{
+    printf("%s - %s\n\nOptions:\n", UMS_TYPE, UMS_DESCRIPTION);
+    printf(" %s\n %s\n %s\n %s\n %s\n",
+           "-?    help",
+           "-f    counter segment file (e.g. /dev/shm/umink.cnt)",
+           "-m    counter id pattern (default: *)",
+           "-w    repeat every N seconds",
+           "-v    display version");
+}
+
+// counter type label
+static const char *
+type_str(uint32_t type)
+{
+    switch (type) {
+    case UMCT_INCREMENTAL:
+        return "inc";
+    case UMCT_GAUGE:
+        return "gauge";
+    case UMCT_HISTOGRAM:
+        return "histogram";
+    default:
+        return "unknown";
+    }
+}
+
+// print slot
+static void
+print_slot(const umcshm_slot_t *s, void *arg)
+{
+    umstat_opts_t *o = arg;
+#if !defined(FNM_EXTMATCH)
+#define FNM_EXTMATCH 0
+#endif
+    if (fnmatch(o->ptrn, s->name, FNM_CASEFOLD | FNM_EXTMATCH) != 0) {
+        return;
+    }
+    ++o->matched;
+
+    printf("%s %s value=%" PRIu64, s->name, type_str(s->type), s->value);
+    switch (s->type) {
+    case UMCT_INCREMENTAL:
+        printf(" rate=%.2f rate_win=%.2f ewma_1s=%.2f ewma_10s=%.2f "
+               "ewma_60s=%.2f",
+               s->rate,
+               s->rate_win,
+               s->ewma_1s,
+               s->ewma_10s,
+               s->ewma_60s);
+        break;
+    case UMCT_GAUGE:
+        printf(" max=%" PRIu64, s->max);
+        break;
+    case UMCT_HISTOGRAM:
+        printf(" max=%" PRIu64 " count=%" PRIu64 " p50=%" PRIu64
+               " p90=%" PRIu64 " p99=%" PRIu64 " p999=%" PRIu64,
+               s->max,
+               s->count,
+               s->p50,
+               s->p90,
+               s->p99,
+               s->p999);
+        break;
+    default:
+        break;
+    }
+    printf("\n");
+}
+
+// main
+int
+main(int argc, char **argv)
+{
+    const char *path = NULL;
+    umstat_opts_t o = { .ptrn = "*", .matched = 0 };
+    int w = 0;
+    int opt;
+
+    // get args
+    while ((opt = getopt(argc, argv, "?f:m:w:v")) != -1) {
+        switch (opt) {
+        // segment file
+        case 'f':
+            path = optarg;
+            break;
+
+        // pattern
+        case 'm':
+            o.ptrn = optarg;
+            break;
+
+        // watch interval
+        case 'w':
+            w = atoi(optarg);
+            break;
+
+        // version
+        case 'v':
+            printf("%s\n", UMINK_VERSION);
+            exit(EXIT_SUCCESS);
+            break;
+
+        default:
+            print_help();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (path == NULL) {
+        print_help();
+        exit(EXIT_FAILURE);
+    }
+
+    // open segment
+    umcshm_reader_t *rd = umcshm_open(path);
+    if (rd == NULL) {
+        fprintf(stderr, "ERROR: Cannot open counter segment [%s]\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    // read (once or periodically)
+    do {
+        o.matched = 0;
+        umcshm_read_all(rd, &print_slot, &o);
+        if (w > 0) {
+            printf("\n");
+            fflush(stdout);
+            sleep(w);
+        }
+    } while (w > 0);
+
+    umcshm_close(rd);
+    return o.matched > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,580 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <umcexp.h>
+
+#ifdef UNIT_TESTING
+#include <cmocka_tests.h>
+#endif
+
+// poll timeout (stop check)
+#define UMCEXP_POLL_MSEC 100
+
+/*****************/
+/* output buffer */
+/*****************/
+typedef struct {
+    char *b;
+    size_t sz;
+    size_t cap;
+    bool err;
+} outbuf_t;
+
+static void
+ob_printf(outbuf_t *ob, const char *fmt, ...)
+{
+    if (ob->err) {
+        return;
+    }
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(ob->b + ob->sz, ob->cap - ob->sz, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            ob->err = true;
+            return;
+        }
+        if (ob->sz + n < ob->cap) {
+            ob->sz += n;
+            return;
+        }
+        // grow
+        size_t cap = ob->cap * 2 + n + 1;
+        char *b = realloc(ob->b, cap);
+        if (b == NULL) {
+            ob->err = true;
+            return;
+        }
+        ob->b = b;
+        ob->cap = cap;
+    }
+}
+
+/************/
+/* snapshot */
+/************/
+// counter snapshot (read without context lock)
+typedef struct {
+    umc_t *c;
+    // metric name (labels stripped)
+    char name[UMC_NAME_MAX + sizeof(UMCEXP_PREFIX)];
+    // labels of family members (without braces)
+    const char *lbl;
+    int lbl_sz;
+} exp_counter_t;
+
+// OpenMetrics metric name ([a-zA-Z_:][a-zA-Z0-9_:]*) and
+// labels of family members (name{key="value",...})
+static void
+metric_name(exp_counter_t *ec)
+{
+    const char *id = ec->c->idp;
+    const char *lb = strchr(id, '{');
+    int l = lb != NULL ? lb - id : (int)strlen(id);
+    ec->lbl = NULL;
+    ec->lbl_sz = 0;
+    if (lb != NULL && id[strlen(id) - 1] == '}') {
+        ec->lbl = lb + 1;
+        ec->lbl_sz = strlen(lb) - 2;
+    }
+    snprintf(ec->name, sizeof(ec->name), "%s%.*s", UMCEXP_PREFIX, l, id);
+    for (char *p = ec->name + strlen(UMCEXP_PREFIX); *p != '\0'; p++) {
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+              (*p >= '0' && *p <= '9') || *p == '_' || *p == ':')) {
+            *p = '_';
+        }
+    }
+}
+
+// sort by metric name (family members are grouped)
+static int
+exp_counter_cmp(const void *a, const void *b)
+{
+    const exp_counter_t *ea = a;
+    const exp_counter_t *eb = b;
+    int r = strcmp(ea->name, eb->name);
+    return r != 0 ? r : strcmp(ea->c->idp, eb->c->idp);
+}
+
+// sample labels with optional extra label
+static const char *
+labels(char *b, size_t b_sz, const exp_counter_t *ec, const char *extra)
+{
+    if (ec->lbl_sz == 0 && extra == NULL) {
+        return "";
+    }
+    snprintf(b,
+             b_sz,
+             "{%.*s%s%s}",
+             ec->lbl_sz,
+             ec->lbl != NULL ? ec->lbl : "",
+             ec->lbl_sz > 0 && extra != NULL ? "," : "",
+             extra != NULL ? extra : "");
+    return b;
+}
+
+// format metric family (group of counters with the same name)
+static void
+format_family(outbuf_t *ob, exp_counter_t *ec, size_t nr)
+{
+    const char *n = ec[0].name;
+    char lb[UMC_NAME_MAX + 64];
+
+    switch (ec[0].c->type) {
+    case UMCT_INCREMENTAL:
+        ob_printf(ob, "# TYPE %s counter\n", n);
+        for (size_t i = 0; i < nr; i++) {
+            ob_printf(ob,
+                      "%s_total%s %" PRIu64 "\n",
+                      n,
+                      labels(lb, sizeof(lb), &ec[i], NULL),
+                      umc_peek(ec[i].c));
+        }
+        // rates (counter lock only; folds sharded values)
+        ob_printf(ob, "# TYPE %s_rate gauge\n", n);
+        for (size_t i = 0; i < nr; i++) {
+            umc_t *c = ec[i].c;
+            umc_rates_t r;
+            umc_get_rates(c, &r, true);
+            char w[32];
+            snprintf(w, sizeof(w), "window=\"%ds\"", UMC_WIN_SZ);
+            const char *ws[] = { "window=\"last\"",
+                                 w,
+                                 "window=\"ewma_1s\"",
+                                 "window=\"ewma_10s\"",
+                                 "window=\"ewma_60s\"" };
+            double wv[] = {
+                umc_get_rate(c, true), r.win, r.ewma_1s, r.ewma_10s, r.ewma_60s
+            };
+            for (int j = 0; j < 5; j++) {
+                ob_printf(ob,
+                          "%s_rate%s %f\n",
+                          n,
+                          labels(lb, sizeof(lb), &ec[i], ws[j]),
+                          wv[j]);
+            }
+        }
+        break;
+
+    case UMCT_GAUGE:
+        ob_printf(ob, "# TYPE %s gauge\n", n);
+        for (size_t i = 0; i < nr; i++) {
+            ob_printf(ob,
+                      "%s%s %" PRIu64 "\n",
+                      n,
+                      labels(lb, sizeof(lb), &ec[i], NULL),
+                      umc_peek(ec[i].c));
+        }
+        ob_printf(ob, "# TYPE %s_max gauge\n", n);
+        for (size_t i = 0; i < nr; i++) {
+            ob_printf(ob,
+                      "%s_max%s %" PRIu64 "\n",
+                      n,
+                      labels(lb, sizeof(lb), &ec[i], NULL),
+                      __atomic_load_n(&ec[i].c->values.max, __ATOMIC_RELAXED));
+        }
+        break;
+
+    case UMCT_HISTOGRAM:
+        // log-linear buckets are exported as quantiles
+        ob_printf(ob, "# TYPE %s summary\n", n);
+        for (size_t i = 0; i < nr; i++) {
+            umc_hist_stats_t hs;
+            umc_get_hist(ec[i].c, &hs);
+            const char *qs[] = { "quantile=\"0.5\"",
+                                 "quantile=\"0.9\"",
+                                 "quantile=\"0.99\"",
+                                 "quantile=\"0.999\"" };
+            uint64_t qv[] = { hs.p50, hs.p90, hs.p99, hs.p999 };
+            for (int j = 0; j < 4; j++) {
+                ob_printf(ob,
+                          "%s%s %" PRIu64 "\n",
+                          n,
+                          labels(lb, sizeof(lb), &ec[i], qs[j]),
+                          qv[j]);
+            }
+            const char *l = labels(lb, sizeof(lb), &ec[i], NULL);
+            ob_printf(ob, "%s_sum%s %" PRIu64 "\n", n, l, hs.sum);
+            ob_printf(ob, "%s_count%s %" PRIu64 "\n", n, l, hs.count);
+        }
+        ob_printf(ob, "# TYPE %s_max gauge\n", n);
+        for (size_t i = 0; i < nr; i++) {
+            ob_printf(ob,
+                      "%s_max%s %" PRIu64 "\n",
+                      n,
+                      labels(lb, sizeof(lb), &ec[i], NULL),
+                      __atomic_load_n(&ec[i].c->values.max, __ATOMIC_RELAXED));
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+char *
+umcexp_snapshot(umc_ctx_t *ctx, size_t *sz)
+{
+    if (ctx == NULL || sz == NULL) {
+        return NULL;
+    }
+
+    // collect counters (append-only, no context lock)
+    size_t nr = umc_count(ctx);
+    exp_counter_t *lst = malloc((nr > 0 ? nr : 1) * sizeof(exp_counter_t));
+    if (lst == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < nr; i++) {
+        lst[i].c = umc_at(ctx, i);
+        metric_name(&lst[i]);
+    }
+    qsort(lst, nr, sizeof(exp_counter_t), &exp_counter_cmp);
+
+    // format
+    outbuf_t ob = { .b = malloc(4096), .sz = 0, .cap = 4096, .err = false };
+    if (ob.b == NULL) {
+        free(lst);
+        return NULL;
+    }
+    ob.b[0] = '\0';
+    for (size_t i = 0; i < nr;) {
+        size_t j = i + 1;
+        while (j < nr && strcmp(lst[j].name, lst[i].name) == 0 &&
+               lst[j].c->type == lst[i].c->type) {
+            ++j;
+        }
+        format_family(&ob, &lst[i], j - i);
+        i = j;
+    }
+    ob_printf(&ob, "# EOF\n");
+    free(lst);
+
+    if (ob.err) {
+        free(ob.b);
+        return NULL;
+    }
+    *sz = ob.sz;
+    return ob.b;
+}
+
+/***********/
+/* clients */
+/***********/
+static void
+client_close(umcexp_client_t *cl)
+{
+    close(cl->fd);
+    free(cl->rsp);
+    cl->fd = -1;
+    cl->rsp = NULL;
+    cl->rsp_sz = 0;
+    cl->rsp_off = 0;
+    cl->req_sz = 0;
+}
+
+// build HTTP response
+static void
+client_respond(umcexp_t *exp, umcexp_client_t *cl)
+{
+    size_t b_sz = 0;
+    char *b = umcexp_snapshot(exp->ctx, &b_sz);
+    const char *st = b != NULL ? "200 OK" : "500 Internal Server Error";
+    char hdr[256];
+    int hl = snprintf(hdr,
+                      sizeof(hdr),
+                      "HTTP/1.1 %s\r\n"
+                      "Content-Type: application/openmetrics-text; "
+                      "version=1.0.0; charset=utf-8\r\n"
+                      "Content-Length: %zu\r\n"
+                      "Connection: close\r\n\r\n",
+                      st,
+                      b_sz);
+    cl->rsp = malloc(hl + b_sz);
+    if (cl->rsp == NULL) {
+        free(b);
+        client_close(cl);
+        return;
+    }
+    memcpy(cl->rsp, hdr, hl);
+    if (b != NULL) {
+        memcpy(cl->rsp + hl, b, b_sz);
+    }
+    cl->rsp_sz = hl + b_sz;
+    cl->rsp_off = 0;
+    free(b);
+}
+
+static void
+client_read(umcexp_t *exp, umcexp_client_t *cl)
+{
+    ssize_t n = recv(cl->fd,
+                     cl->req + cl->req_sz,
+                     sizeof(cl->req) - cl->req_sz - 1,
+                     0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        client_close(cl);
+        return;
+    }
+    cl->req_sz += n;
+    cl->req[cl->req_sz] = '\0';
+    // wait for end of request headers (any path is served)
+    if (strstr(cl->req, "\r\n\r\n") != NULL ||
+        strstr(cl->req, "\n\n") != NULL ||
+        cl->req_sz == sizeof(cl->req) - 1) {
+        client_respond(exp, cl);
+    }
+}
+
+static void
+client_write(umcexp_client_t *cl)
+{
+    ssize_t n = send(cl->fd,
+                     cl->rsp + cl->rsp_off,
+                     cl->rsp_sz - cl->rsp_off,
+                     MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        client_close(cl);
+        return;
+    }
+    cl->rsp_off += n;
+    if (cl->rsp_off == cl->rsp_sz) {
+        client_close(cl);
+    }
+}
+
+static void
+client_accept(umcexp_t *exp)
+{
+    int fd = accept(exp->fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    for (int i = 0; i < UMCEXP_CLIENTS; i++) {
+        if (exp->clients[i].fd < 0) {
+            exp->clients[i].fd = fd;
+            return;
+        }
+    }
+    // too many clients
+    close(fd);
+}
+
+static void *
+th_umcexp(void *arg)
+{
+    umcexp_t *exp = arg;
+    struct pollfd pfd[UMCEXP_CLIENTS + 1];
+    int idx[UMCEXP_CLIENTS + 1];
+
+    while (!__atomic_load_n(&exp->stop, __ATOMIC_ACQUIRE)) {
+        // listening socket
+        int n = 0;
+        pfd[n].fd = exp->fd;
+        pfd[n].events = POLLIN;
+        idx[n++] = -1;
+        // clients
+        for (int i = 0; i < UMCEXP_CLIENTS; i++) {
+            umcexp_client_t *cl = &exp->clients[i];
+            if (cl->fd < 0) {
+                continue;
+            }
+            pfd[n].fd = cl->fd;
+            pfd[n].events = cl->rsp != NULL ? POLLOUT : POLLIN;
+            idx[n++] = i;
+        }
+        if (poll(pfd, n, UMCEXP_POLL_MSEC) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (pfd[i].revents == 0) {
+                continue;
+            }
+            if (idx[i] < 0) {
+                client_accept(exp);
+                continue;
+            }
+            umcexp_client_t *cl = &exp->clients[idx[i]];
+            if (pfd[i].revents & (POLLERR | POLLNVAL)) {
+                client_close(cl);
+            } else if (cl->rsp != NULL) {
+                client_write(cl);
+            } else {
+                client_read(exp, cl);
+            }
+        }
+    }
+    return NULL;
+}
+
+/*************/
+/* listening */
+/*************/
+static int
+listen_unix(const char *path)
+{
+    struct sockaddr_un sa;
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int
+listen_tcp(const char *addr)
+{
+    // "host:port" or "port"
+    char host[256] = { 0 };
+    const char *port = strrchr(addr, ':');
+    if (port != NULL) {
+        size_t hl = port - addr;
+        if (hl >= sizeof(host)) {
+            return -1;
+        }
+        memcpy(host, addr, hl);
+        ++port;
+    } else {
+        port = addr;
+    }
+
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+umcexp_t *
+umcexp_new(umc_ctx_t *ctx, const char *addr)
+{
+    if (ctx == NULL || addr == NULL) {
+        return NULL;
+    }
+
+    // create listening socket
+    int fd = -1;
+    const char *path = NULL;
+    if (strncmp(addr, "unix:", 5) == 0) {
+        path = addr + 5;
+        fd = listen_unix(path);
+    } else if (strncmp(addr, "tcp:", 4) == 0) {
+        fd = listen_tcp(addr + 4);
+    }
+    if (fd < 0) {
+        return NULL;
+    }
+    if (listen(fd, UMCEXP_CLIENTS) != 0) {
+        close(fd);
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // exporter
+    umcexp_t *exp = calloc(1, sizeof(umcexp_t));
+    if (exp == NULL) {
+        close(fd);
+        if (path != NULL) {
+            unlink(path);
+        }
+        return NULL;
+    }
+    exp->ctx = ctx;
+    exp->fd = fd;
+    exp->path = path != NULL ? strdup(path) : NULL;
+    for (int i = 0; i < UMCEXP_CLIENTS; i++) {
+        exp->clients[i].fd = -1;
+    }
+
+    // exporter thread
+    if (pthread_create(&exp->th, NULL, &th_umcexp, exp) != 0) {
+        close(fd);
+        if (exp->path != NULL) {
+            unlink(exp->path);
+        }
+        free(exp->path);
+        free(exp);
+        return NULL;
+    }
+
+    return exp;
+}
+
+void
+umcexp_free(umcexp_t *exp)
+{
+    if (exp == NULL) {
+        return;
+    }
+    __atomic_store_n(&exp->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(exp->th, NULL);
+    for (int i = 0; i < UMCEXP_CLIENTS; i++) {
+        if (exp->clients[i].fd >= 0) {
+            client_close(&exp->clients[i]);
+        }
+    }
+    close(exp->fd);
+    if (exp->path != NULL) {
+        unlink(exp->path);
+    }
+    free(exp->path);
+    free(exp);
+}
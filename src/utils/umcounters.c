@@ -10,6 +10,10 @@
 
 #include <config.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
 #include <umcounters.h>
 #include <fnmatch.h>
 
@@ -17,6 +21,225 @@
 #include <cmocka_tests.h>
 #endif
 
+// next per-thread shard index
+static int shard_next = 0;
+// current thread's shard index
+static __thread int shard_idx = -1;
+
+// EWMA time constants (seconds)
+static const double win_tau[3] = { 1, 10, 60 };
+
+// pattern characters ending the literal prefix (incl. extglob)
+static const char *ptrn_special = "*?[\\+@!(";
+
+#if !defined(FNM_EXTMATCH)
+#define FNM_EXTMATCH 0
+#endif
+
+static void update_value(umc_t *c, uint64_t val);
+static void family_free(umc_family_t *f);
+static void index_add(umc_ctx_t *ctx, umc_t *c);
+static void tnode_free(umc_tnode_t *nd);
+
+/***************/
+/* rate window */
+/***************/
+// current monotonic ts in nsec
+static uint64_t
+now_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static umc_win_t *
+win_new(void)
+{
+    umc_win_t *w = calloc(1, sizeof(umc_win_t));
+    if (w != NULL) {
+        w->start_nsec = now_nsec();
+        w->sec = w->start_nsec / 1000000000;
+    }
+    return w;
+}
+
+// decay EWMA values from bucket second to sec
+static void
+win_ewma(const umc_win_t *w, uint64_t sec, double *ewma)
+{
+    for (int i = 0; i < 3; i++) {
+        ewma[i] = w->ewma[i];
+    }
+    if (sec <= w->sec) {
+        return;
+    }
+    // completed bucket, followed by idle seconds
+    double v = w->buckets[w->sec % UMC_WIN_SZ];
+    uint64_t idle = sec - w->sec - 1;
+    for (int i = 0; i < 3; i++) {
+        ewma[i] += (1 - exp(-1 / win_tau[i])) * (v - ewma[i]);
+        if (idle > 0) {
+            ewma[i] *= exp(-(double)idle / win_tau[i]);
+        }
+    }
+}
+
+// move window forward to sec
+static void
+win_advance(umc_win_t *w, uint64_t sec)
+{
+    if (sec <= w->sec) {
+        return;
+    }
+    win_ewma(w, sec, w->ewma);
+    // clear buckets of skipped seconds
+    uint64_t n = sec - w->sec;
+    if (n > UMC_WIN_SZ) {
+        n = UMC_WIN_SZ;
+    }
+    for (uint64_t i = 1; i <= n; i++) {
+        w->buckets[(w->sec + i) % UMC_WIN_SZ] = 0;
+    }
+    w->sec = sec;
+}
+
+// account value delta (increment path)
+static inline void
+win_add(umc_win_t *w, uint64_t ts_nsec, uint64_t delta)
+{
+    uint64_t sec = ts_nsec / 1000000000;
+    if (sec != w->sec) {
+        win_advance(w, sec);
+    }
+    w->buckets[w->sec % UMC_WIN_SZ] += delta;
+}
+
+// calculate rates at ts_nsec (window is not modified)
+static void
+win_rates(const umc_win_t *w, uint64_t ts_nsec, umc_rates_t *r)
+{
+    uint64_t sec = ts_nsec / 1000000000;
+    double ewma[3];
+    win_ewma(w, sec, ewma);
+    r->ewma_1s = ewma[0];
+    r->ewma_10s = ewma[1];
+    r->ewma_60s = ewma[2];
+
+    // sum buckets still inside the window
+    uint64_t sum = 0;
+    uint64_t first = sec + 1 > UMC_WIN_SZ ? sec + 1 - UMC_WIN_SZ : 0;
+    if (w->sec + 1 > UMC_WIN_SZ && w->sec + 1 - UMC_WIN_SZ > first) {
+        first = w->sec + 1 - UMC_WIN_SZ;
+    }
+    for (uint64_t s = first; s <= w->sec; s++) {
+        sum += w->buckets[s % UMC_WIN_SZ];
+    }
+    // window span (shorter for new counters)
+    uint64_t span = (UMC_WIN_SZ - 1) * 1000000000ULL + ts_nsec % 1000000000;
+    if (ts_nsec - w->start_nsec < span) {
+        span = ts_nsec - w->start_nsec;
+    }
+    r->win = span > 0 ? sum / (double)span * 1000000000 : 0;
+}
+
+
+// get current thread's shard
+static inline umc_shard_t *
+shard_get(umc_t *c)
+{
+    if (shard_idx < 0) {
+        shard_idx = UM_ATOMIC_F_ADD(&shard_next, 1) % UMC_SHARDS;
+    }
+    return &c->shards[shard_idx];
+}
+
+// aggregate shards (counter mutex locked)
+static void
+shard_fold(umc_t *c)
+{
+    if (c->shards == NULL) {
+        return;
+    }
+    uint64_t sum = 0;
+    for (int i = 0; i < UMC_SHARDS; i++) {
+        sum += __atomic_load_n(&c->shards[i].value, __ATOMIC_RELAXED);
+    }
+    // update only if changed (keep rate timestamps)
+    if (sum != c->values.last.value) {
+        update_value(c, sum);
+    }
+}
+
+/*************/
+/* histogram */
+/*************/
+// bucket index (log-linear)
+static inline int
+hist_idx(uint64_t val)
+{
+    if (val < UMC_HIST_SUB) {
+        return val;
+    }
+    int shift = 63 - __builtin_clzll(val) - UMC_HIST_SUB_BITS;
+    return shift * UMC_HIST_SUB + (val >> shift);
+}
+
+// highest value that maps to bucket index
+static uint64_t
+hist_upper(int idx)
+{
+    if (idx < UMC_HIST_SUB) {
+        return idx;
+    }
+    int shift = idx / UMC_HIST_SUB - 1;
+    uint64_t sub = idx % UMC_HIST_SUB + UMC_HIST_SUB;
+    return ((sub + 1) << shift) - 1;
+}
+
+// record value (lock-free)
+static void
+hist_record(umc_t *c, uint64_t val)
+{
+    umc_hist_t *h = c->hist;
+    __atomic_fetch_add(&h->buckets[hist_idx(val)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, val, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->values.last.value, val, __ATOMIC_RELAXED);
+    // update max
+    uint64_t m = __atomic_load_n(&c->values.max, __ATOMIC_RELAXED);
+    while (val > m && !__atomic_compare_exchange_n(&c->values.max,
+                                                   &m,
+                                                   val,
+                                                   true,
+                                                   __ATOMIC_RELAXED,
+                                                   __ATOMIC_RELAXED)) {
+    }
+}
+
+// percentiles from bucket snapshot
+static void
+hist_percentiles(const uint64_t *b,
+                 uint64_t total,
+                 const double *q,
+                 uint64_t *res,
+                 int nr)
+{
+    uint64_t acc = 0;
+    int i = 0;
+    for (int k = 0; k < nr; k++) {
+        // rank of the percentile (1-based)
+        uint64_t rank = (uint64_t)(q[k] / 100 * total + 0.5);
+        if (rank < 1) {
+            rank = 1;
+        }
+        while (i < UMC_HIST_SZ && acc + b[i] < rank) {
+            acc += b[i++];
+        }
+        res[k] = i < UMC_HIST_SZ ? hist_upper(i) : hist_upper(i - 1);
+    }
+}
+
 umc_ctx_t *
 umc_new_ctx()
 {
@@ -32,47 +255,262 @@ umc_free_ctx(umc_ctx_t *ctx)
         return;
     }
 
-    umc_t *c;
-    umc_t *tmp;
+    umc_name_t *n;
+    umc_name_t *tmp;
+    umc_family_t *f;
+    umc_family_t *ftmp;
 
-    // loop counters
     pthread_mutex_lock(&ctx->mtx);
-    HASH_ITER(hh, ctx->counters, c, tmp)
+    // families
+    HASH_ITER(hh, ctx->families, f, ftmp)
     {
-        HASH_DEL(ctx->counters, c); // GCOVR_EXCL_BR_LINE
+        HASH_DEL(ctx->families, f); // GCOVR_EXCL_BR_LINE
+        family_free(f);
+    }
+    // name prefix index
+    tnode_free(ctx->index);
+    // name index
+    HASH_ITER(hh, ctx->names, n, tmp)
+    {
+        HASH_DEL(ctx->names, n); // GCOVR_EXCL_BR_LINE
+        free(n);
+    }
+    // loop counters
+    for (uint32_t i = 0; i < ctx->nr; i++) {
+        umc_t *c = umc_at(ctx, i);
         pthread_mutex_destroy(&c->mtx);
-        free(c);
+        free(c->shards);
+        free(c->win);
+        free(c->hist);
+    }
+    for (int i = 0; i < UMC_CHUNKS && ctx->chunks[i] != NULL; i++) {
+        free(ctx->chunks[i]);
+    }
+    // name arena blocks (linked via first pointer)
+    while (ctx->arena != NULL) {
+        char *prev = *(char **)ctx->arena;
+        free(ctx->arena);
+        ctx->arena = prev;
     }
     pthread_mutex_unlock(&ctx->mtx);
     pthread_mutex_destroy(&ctx->mtx);
     free(ctx);
 }
 
+/********************/
+/* names and chunks */
+/********************/
+// copy id to name arena (context mutex locked)
+static const char *
+name_intern(umc_ctx_t *ctx, const char *id)
+{
+    size_t l = strnlen(id, UMC_NAME_MAX - 1);
+    // new arena block
+    if (ctx->arena == NULL || ctx->arena_off + l + 1 > UMC_ARENA_SZ) {
+        char *b = malloc(UMC_ARENA_SZ);
+        if (b == NULL) {
+            return NULL;
+        }
+        *(char **)b = ctx->arena;
+        ctx->arena = b;
+        ctx->arena_off = sizeof(char *);
+    }
+    char *res = ctx->arena + ctx->arena_off;
+    memcpy(res, id, l);
+    res[l] = '\0';
+    ctx->arena_off += l + 1;
+    return res;
+}
+
+// next free counter slot (context mutex locked)
+static umc_t *
+chunk_slot(umc_ctx_t *ctx)
+{
+    uint32_t ci = ctx->nr / UMC_CHUNK_SZ;
+    if (ci >= UMC_CHUNKS) {
+        return NULL;
+    }
+    if (ctx->chunks[ci] == NULL) {
+        umc_t *ch = aligned_alloc(64, UMC_CHUNK_SZ * sizeof(umc_t));
+        if (ch == NULL) {
+            return NULL;
+        }
+        memset(ch, 0, UMC_CHUNK_SZ * sizeof(umc_t));
+        __atomic_store_n(&ctx->chunks[ci], ch, __ATOMIC_RELEASE);
+    }
+    return &ctx->chunks[ci][ctx->nr % UMC_CHUNK_SZ];
+}
+
+/*********************/
+/* name prefix index */
+/*********************/
+// find child node by segment (case insensitive)
+static umc_tnode_t *
+tnode_child(umc_tnode_t *head, const char *seg, size_t sz)
+{
+    for (umc_tnode_t *nd = head; nd != NULL; nd = nd->next) {
+        if (nd->seg_sz == sz && strncasecmp(nd->seg, seg, sz) == 0) {
+            return nd;
+        }
+    }
+    return NULL;
+}
+
+// append counter index (context mutex locked); a full array
+// is copied to a new block, previous blocks are kept until
+// the context is freed (readers might still use them)
+static int
+tnode_add(umc_tnode_t *nd, uint32_t idx)
+{
+    if (nd->nr == nd->cap) {
+        uint32_t cap = nd->cap > 0 ? nd->cap * 2 : 4;
+        void **b = malloc(sizeof(void *) + cap * sizeof(uint32_t));
+        if (b == NULL) {
+            return 1;
+        }
+        b[0] = nd->idx != NULL ? (void **)nd->idx - 1 : NULL;
+        uint32_t *arr = (uint32_t *)(b + 1);
+        if (nd->nr > 0) {
+            memcpy(arr, nd->idx, nd->nr * sizeof(uint32_t));
+        }
+        nd->cap = cap;
+        __atomic_store_n(&nd->idx, arr, __ATOMIC_RELEASE);
+    }
+    nd->idx[nd->nr] = idx;
+    __atomic_store_n(&nd->nr, nd->nr + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// add counter to name prefix index (context mutex locked)
+static void
+index_add(umc_ctx_t *ctx, umc_t *c)
+{
+    umc_tnode_t **head = &ctx->index;
+    const char *s = c->idp;
+    const char *e;
+    for (int d = 0; d < UMC_INDEX_DEPTH && (e = strchr(s, '.')) != NULL;
+         d++) {
+        umc_tnode_t *nd = tnode_child(*head, s, e - s);
+        if (nd == NULL) {
+            nd = calloc(1, sizeof(umc_tnode_t));
+            if (nd == NULL) {
+                __atomic_store_n(&ctx->index_err, 1, __ATOMIC_RELEASE);
+                return;
+            }
+            nd->seg = s;
+            nd->seg_sz = e - s;
+            nd->next = *head;
+            __atomic_store_n(head, nd, __ATOMIC_RELEASE);
+        }
+        if (tnode_add(nd, c->idx) != 0) {
+            __atomic_store_n(&ctx->index_err, 1, __ATOMIC_RELEASE);
+            return;
+        }
+        head = &nd->child;
+        s = e + 1;
+    }
+}
+
+static void
+tnode_free(umc_tnode_t *nd)
+{
+    while (nd != NULL) {
+        umc_tnode_t *next = nd->next;
+        tnode_free(nd->child);
+        // index array blocks (linked via first pointer)
+        void **b = nd->idx != NULL ? (void **)nd->idx - 1 : NULL;
+        while (b != NULL) {
+            void **prev = b[0];
+            free(b);
+            b = prev;
+        }
+        free(nd);
+        nd = next;
+    }
+}
+
+uint32_t
+umc_count(umc_ctx_t *ctx)
+{
+    if (ctx == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&ctx->nr, __ATOMIC_ACQUIRE);
+}
+
+umc_t *
+umc_at(umc_ctx_t *ctx, uint32_t idx)
+{
+    if (ctx == NULL || idx >= umc_count(ctx)) {
+        return NULL;
+    }
+    umc_t *ch = __atomic_load_n(&ctx->chunks[idx / UMC_CHUNK_SZ],
+                                __ATOMIC_ACQUIRE);
+    return &ch[idx % UMC_CHUNK_SZ];
+}
+
 umc_t *
 umc_new_counter(umc_ctx_t *ctx, const char *id, enum umc_type type)
+{
+    return umc_new_counter_ex(ctx, id, type, 0);
+}
+
+umc_t *
+umc_new_counter_ex(umc_ctx_t *ctx,
+                   const char *id,
+                   enum umc_type type,
+                   int flags)
 {
     if (ctx == NULL || id == NULL) {
         return NULL;
     }
 
     // check for duplicates
-    umc_t *c = NULL;
+    umc_name_t *n = NULL;
 
     pthread_mutex_lock(&ctx->mtx);
 
-    HASH_FIND_STR(ctx->counters, id, c); // GCOVR_EXCL_BR_LINE
-    if (c != NULL) {
+    HASH_FIND_STR(ctx->names, id, n); // GCOVR_EXCL_BR_LINE
+    if (n != NULL) {
         pthread_mutex_unlock(&ctx->mtx);
-        return c;
+        return n->c;
     }
 
-    // create counter
-    c = calloc(1, sizeof(umc_t));
-    snprintf(c->id, sizeof(c->id), "%s", id);
-    c->idp = c->id;
+    // create counter (zeroed chunk slot)
+    umc_t *c = chunk_slot(ctx);
+    n = calloc(1, sizeof(umc_name_t));
+    const char *idp = name_intern(ctx, id);
+    if (c == NULL || n == NULL || idp == NULL) {
+        pthread_mutex_unlock(&ctx->mtx);
+        free(n);
+        return NULL;
+    }
+    c->idp = idp;
+    c->idx = ctx->nr;
     c->type = type;
+    // sharding is only used for incremental counters
+    if ((flags & UMCF_SHARDED) && type == UMCT_INCREMENTAL) {
+        c->shards = aligned_alloc(64, UMC_SHARDS * sizeof(umc_shard_t));
+        if (c->shards != NULL) {
+            memset(c->shards, 0, UMC_SHARDS * sizeof(umc_shard_t));
+            c->flags = flags;
+        }
+    }
+    // rate window is only used for incremental counters
+    if (type == UMCT_INCREMENTAL) {
+        c->win = win_new();
+    // histogram buckets
+    } else if (type == UMCT_HISTOGRAM) {
+        c->hist = calloc(1, sizeof(umc_hist_t));
+    }
     pthread_mutex_init(&c->mtx, NULL);
-    HASH_ADD_STR(ctx->counters, id, c); // GCOVR_EXCL_BR_LINE
+    // name index
+    n->id = idp;
+    n->c = c;
+    HASH_ADD_KEYPTR(hh, ctx->names, idp, strlen(idp), n); // GCOVR_EXCL_BR_LINE
+    index_add(ctx, c);
+    // publish (lock-free iteration)
+    __atomic_store_n(&ctx->nr, ctx->nr + 1, __ATOMIC_RELEASE);
 
     pthread_mutex_unlock(&ctx->mtx);
 
@@ -87,11 +525,22 @@ umc_get(umc_ctx_t *ctx, const char *id, bool lock)
     }
 
     umc_t *c = NULL;
+    umc_name_t *n = NULL;
     if (lock) {
         pthread_mutex_lock(&ctx->mtx);
     }
 
-    HASH_FIND_STR(ctx->counters, id, c); // GCOVR_EXCL_BR_LINE
+    HASH_FIND_STR(ctx->names, id, n); // GCOVR_EXCL_BR_LINE
+    if (n != NULL) {
+        c = n->c;
+    }
+
+    // aggregate sharded value
+    if (c != NULL && c->shards != NULL) {
+        pthread_mutex_lock(&c->mtx);
+        shard_fold(c);
+        pthread_mutex_unlock(&c->mtx);
+    }
 
     if (lock) {
         pthread_mutex_unlock(&ctx->mtx);
@@ -109,9 +558,11 @@ update_value(umc_t *c, uint64_t val)
     if (val <= pv && c->type != UMCT_GAUGE) {
         return;
     }
-    c->values.last.value = val;
+    // lock-free readers (umc_peek, histogram max), avoid
+    // torn 64-bit stores on 32-bit targets
+    __atomic_store_n(&c->values.last.value, val, __ATOMIC_RELAXED);
     // update max value and timestamp
-    c->values.max = val > pv ? val : pv;
+    __atomic_store_n(&c->values.max, val > pv ? val : pv, __ATOMIC_RELAXED);
     // rate is only used for incremental counters
     if (c->type != UMCT_INCREMENTAL) {
         return;
@@ -119,14 +570,16 @@ update_value(umc_t *c, uint64_t val)
     // get previous and current ts in nsec
     uint64_t p_ts_nsec = c->values.last.ts_nsec;
     // get current ts in nsec
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-    uint64_t ts_nsec = ts.tv_sec * 1e9 + ts.tv_nsec;
+    uint64_t ts_nsec = now_nsec();
     // calculate rate
     c->values.ts_diff = ts_nsec - p_ts_nsec;
     c->values.delta = val - pv;
     // update timestamp
     c->values.last.ts_nsec = ts_nsec;
+    // update rate window
+    if (c->win != NULL) {
+        win_add(c->win, ts_nsec, val - pv);
+    }
 }
 
 void
@@ -136,6 +589,17 @@ umc_inc(umc_t *c, uint64_t val)
         return;
     }
 
+    // histograms only record values (umc_set)
+    if (c->hist != NULL) {
+        return;
+    }
+
+    // sharded (lock-free)
+    if (c->shards != NULL) {
+        __atomic_fetch_add(&shard_get(c)->value, val, __ATOMIC_RELAXED);
+        return;
+    }
+
     pthread_mutex_lock(&c->mtx);
     update_value(c, c->values.last.value + val);
     pthread_mutex_unlock(&c->mtx);
@@ -149,11 +613,7 @@ umc_get_inc(umc_ctx_t *ctx, const char *id, uint64_t val, bool lock)
     }
 
     umc_t *c = umc_get(ctx, id, false);
-    if (c != NULL) {
-        pthread_mutex_lock(&c->mtx);
-        update_value(c, c->values.last.value + val);
-        pthread_mutex_unlock(&c->mtx);
-    }
+    umc_inc(c, val);
 
     if (lock && ctx) {
         pthread_mutex_unlock(&ctx->mtx);
@@ -162,14 +622,43 @@ umc_get_inc(umc_ctx_t *ctx, const char *id, uint64_t val, bool lock)
     return c;
 }
 
+// set value (counter mutex locked)
+static void
+set_value(umc_t *c, uint64_t val)
+{
+    // histogram (lock not required)
+    if (c->hist != NULL) {
+        hist_record(c, val);
+        return;
+    }
+    // sharded; move total forward via current thread's shard
+    if (c->shards != NULL) {
+        shard_fold(c);
+        if (val > c->values.last.value) {
+            __atomic_fetch_add(&shard_get(c)->value,
+                               val - c->values.last.value,
+                               __ATOMIC_RELAXED);
+            shard_fold(c);
+        }
+        return;
+    }
+    update_value(c, val);
+}
+
 void
 umc_set(umc_t *c, uint64_t val)
 {
-    if (c != NULL) {
-        pthread_mutex_lock(&c->mtx);
-        update_value(c, val);
-        pthread_mutex_unlock(&c->mtx);
+    if (c == NULL) {
+        return;
     }
+    // histogram (lock-free)
+    if (c->hist != NULL) {
+        hist_record(c, val);
+        return;
+    }
+    pthread_mutex_lock(&c->mtx);
+    set_value(c, val);
+    pthread_mutex_unlock(&c->mtx);
 }
 
 umc_t *
@@ -189,7 +678,7 @@ umc_get_set(umc_ctx_t *ctx, const char *id, uint64_t val, bool lock)
     // update rate and unupdate ts
     if (c != NULL) {
         pthread_mutex_lock(&c->mtx);
-        update_value(c, val);
+        set_value(c, val);
         pthread_mutex_unlock(&c->mtx);
     }
 
@@ -200,33 +689,466 @@ umc_get_set(umc_ctx_t *ctx, const char *id, uint64_t val, bool lock)
     return c;
 }
 
+int
+umc_get_hist(umc_t *c, umc_hist_stats_t *hs)
+{
+    if (hs == NULL) {
+        return 1;
+    }
+    memset(hs, 0, sizeof(umc_hist_stats_t));
+    if (c == NULL || c->hist == NULL) {
+        return 1;
+    }
+
+    // bucket snapshot (concurrent recording allowed)
+    uint64_t b[UMC_HIST_SZ];
+    uint64_t total = 0;
+    for (int i = 0; i < UMC_HIST_SZ; i++) {
+        b[i] = __atomic_load_n(&c->hist->buckets[i], __ATOMIC_RELAXED);
+        total += b[i];
+    }
+    hs->count = total;
+    hs->sum = __atomic_load_n(&c->hist->sum, __ATOMIC_RELAXED);
+    hs->max = __atomic_load_n(&c->values.max, __ATOMIC_RELAXED);
+    if (total == 0) {
+        return 0;
+    }
+
+    // percentiles
+    const double q[] = { 50, 90, 99, 99.9 };
+    uint64_t res[4];
+    hist_percentiles(b, total, q, res, 4);
+    hs->p50 = res[0] < hs->max ? res[0] : hs->max;
+    hs->p90 = res[1] < hs->max ? res[1] : hs->max;
+    hs->p99 = res[2] < hs->max ? res[2] : hs->max;
+    hs->p999 = res[3] < hs->max ? res[3] : hs->max;
+
+    return 0;
+}
+
+uint64_t
+umc_get_percentile(umc_t *c, double q)
+{
+    if (c == NULL || c->hist == NULL) {
+        return 0;
+    }
+
+    // bucket snapshot
+    uint64_t b[UMC_HIST_SZ];
+    uint64_t total = 0;
+    for (int i = 0; i < UMC_HIST_SZ; i++) {
+        b[i] = __atomic_load_n(&c->hist->buckets[i], __ATOMIC_RELAXED);
+        total += b[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t res;
+    hist_percentiles(b, total, &q, &res, 1);
+    uint64_t m = __atomic_load_n(&c->values.max, __ATOMIC_RELAXED);
+    return res < m ? res : m;
+}
+
+uint64_t
+umc_peek(umc_t *c)
+{
+    if (c == NULL) {
+        return 0;
+    }
+    if (c->shards == NULL) {
+        return __atomic_load_n(&c->values.last.value, __ATOMIC_RELAXED);
+    }
+    uint64_t sum = 0;
+    for (int i = 0; i < UMC_SHARDS; i++) {
+        sum += __atomic_load_n(&c->shards[i].value, __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+void
+umc_restore(umc_t *c, uint64_t val)
+{
+    if (c == NULL || c->type != UMCT_INCREMENTAL) {
+        return;
+    }
+    pthread_mutex_lock(&c->mtx);
+    // sharded value is the sum of all slots
+    if (c->shards != NULL) {
+        __atomic_add_fetch(&c->shards[0].value, val, __ATOMIC_RELAXED);
+    }
+    val += c->values.last.value;
+    __atomic_store_n(&c->values.last.value, val, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->values.max, val, __ATOMIC_RELAXED);
+    c->values.last.ts_nsec = now_nsec();
+    pthread_mutex_unlock(&c->mtx);
+}
+
+// match single counter
+static int
+match_one(umc_t *c, const char *ptrn, umc_cb_t cb, void *arg)
+{
+    if (fnmatch(ptrn, c->idp, FNM_CASEFOLD | FNM_EXTMATCH) != 0) {
+        return 0;
+    }
+    // aggregate sharded value
+    if (c->shards != NULL) {
+        pthread_mutex_lock(&c->mtx);
+        shard_fold(c);
+        pthread_mutex_unlock(&c->mtx);
+    }
+    cb(c, arg);
+    return 1;
+}
+
+void
+umc_snapshot(umc_ctx_t *ctx, umc_snap_t *snap)
+{
+    if (snap == NULL) {
+        return;
+    }
+    snap->ctx = ctx;
+    snap->nr = umc_count(ctx);
+}
+
+int
+umc_snap_match(const umc_snap_t *snap,
+               const char *ptrn,
+               umc_cb_t cb,
+               void *arg)
+{
+    if (snap == NULL || snap->ctx == NULL || ptrn == NULL || cb == NULL) {
+        return 0;
+    }
+    umc_ctx_t *ctx = snap->ctx;
+
+    // prefix index node (complete segments of the literal prefix)
+    umc_tnode_t *nd = NULL;
+    if (!__atomic_load_n(&ctx->index_err, __ATOMIC_ACQUIRE)) {
+        const char *end = ptrn + strcspn(ptrn, ptrn_special);
+        umc_tnode_t *head = __atomic_load_n(&ctx->index, __ATOMIC_ACQUIRE);
+        const char *s = ptrn;
+        const char *e;
+        for (int d = 0;
+             d < UMC_INDEX_DEPTH && (e = memchr(s, '.', end - s)) != NULL;
+             d++) {
+            nd = tnode_child(head, s, e - s);
+            // no counters with this prefix
+            if (nd == NULL) {
+                return 0;
+            }
+            head = __atomic_load_n(&nd->child, __ATOMIC_ACQUIRE);
+            s = e + 1;
+        }
+    }
+
+    int res = 0;
+    // indexed candidates (ascending, newer than snapshot skipped)
+    if (nd != NULL) {
+        uint32_t nr = __atomic_load_n(&nd->nr, __ATOMIC_ACQUIRE);
+        uint32_t *idx = __atomic_load_n(&nd->idx, __ATOMIC_ACQUIRE);
+        for (uint32_t i = 0; i < nr && idx[i] < snap->nr; i++) {
+            res += match_one(umc_at(ctx, idx[i]), ptrn, cb, arg);
+        }
+
+    // all counters (dense chunks)
+    } else {
+        for (uint32_t i = 0; i < snap->nr; i++) {
+            res += match_one(umc_at(ctx, i), ptrn, cb, arg);
+        }
+    }
+
+    return res;
+}
+
 int
 umc_match(umc_ctx_t *ctx, const char *ptrn, bool lock, umc_cb_t cb, void *arg)
 {
-    umc_t *c;
-    umc_t *tmp;
+    // snapshot based (context mutex not needed)
+    (void)lock;
+    umc_snap_t snap;
+    umc_snapshot(ctx, &snap);
+    umc_snap_match(&snap, ptrn, cb, arg);
+    return 0;
+}
 
-    if (lock) {
-        pthread_mutex_lock(&ctx->mtx);
+/************/
+/* families */
+/************/
+// sort labels by name (small sets, insertion sort)
+static void
+labels_sort(umc_label_t *l, int nr)
+{
+    for (int i = 1; i < nr; i++) {
+        umc_label_t t = l[i];
+        int j = i - 1;
+        while (j >= 0 && strcmp(l[j].key, t.key) > 0) {
+            l[j + 1] = l[j];
+            --j;
+        }
+        l[j + 1] = t;
+    }
+}
+
+// label set hash (FNV-1a, sorted labels)
+static uint64_t
+labels_hash(const umc_label_t *l, int nr)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < nr; i++) {
+        for (const char *p = l[i].key;; p++) {
+            h = (h ^ (unsigned char)*p) * 0x100000001b3ULL;
+            if (*p == '\0') {
+                break;
+            }
+        }
+        for (const char *p = l[i].value;; p++) {
+            h = (h ^ (unsigned char)*p) * 0x100000001b3ULL;
+            if (*p == '\0') {
+                break;
+            }
+        }
     }
+    return h;
+}
 
-    // loop counters
-    HASH_ITER(hh, ctx->counters, c, tmp)
+static bool
+labels_equal(const umc_series_t *s, const umc_label_t *l, int nr)
+{
+    if (s->nr != nr) {
+        return false;
+    }
+    for (int i = 0; i < nr; i++) {
+        if (strcmp(s->labels[i].key, l[i].key) != 0 ||
+            strcmp(s->labels[i].value, l[i].value) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// series counter id: name{key="value",...}
+static int
+series_id(char *b,
+          size_t b_sz,
+          const char *name,
+          const umc_label_t *l,
+          int nr)
+{
+    if (nr == 0) {
+        return snprintf(b, b_sz, "%s", name) < (int)b_sz ? 0 : 1;
+    }
+    size_t o = snprintf(b, b_sz, "%s{", name);
+    for (int i = 0; i < nr && o < b_sz; i++) {
+        o += snprintf(b + o, b_sz - o, "%s%s=\"", i ? "," : "", l[i].key);
+        // escape value
+        for (const char *p = l[i].value; *p != '\0' && o + 2 < b_sz; p++) {
+            if (*p == '"' || *p == '\\') {
+                b[o++] = '\\';
+                b[o++] = *p;
+            } else if (*p == '\n') {
+                b[o++] = '\\';
+                b[o++] = 'n';
+            } else {
+                b[o++] = *p;
+            }
+        }
+        if (o < b_sz) {
+            o += snprintf(b + o, b_sz - o, "\"");
+        }
+    }
+    if (o < b_sz) {
+        o += snprintf(b + o, b_sz - o, "}");
+    }
+    // truncated ids could collide
+    return o < b_sz ? 0 : 1;
+}
+
+static void
+series_free(umc_series_t *s)
+{
+    while (s != NULL) {
+        umc_series_t *n = s->next;
+        for (int i = 0; i < s->nr; i++) {
+            free((char *)s->labels[i].key);
+            free((char *)s->labels[i].value);
+        }
+        free(s);
+        s = n;
+    }
+}
+
+static void
+family_free(umc_family_t *f)
+{
+    umc_series_t *s;
+    umc_series_t *tmp;
+    HASH_ITER(hh, f->series, s, tmp)
     {
-        // match counter
-#if !defined(FNM_EXTMATCH)
-#define FNM_EXTMATCH 0
-#endif
-        if (fnmatch(ptrn, c->id, FNM_CASEFOLD | FNM_EXTMATCH) == 0) {
-            cb(c, arg);
+        HASH_DEL(f->series, s); // GCOVR_EXCL_BR_LINE
+        series_free(s);
+    }
+    pthread_rwlock_destroy(&f->lock);
+    free(f->counters);
+    free(f->name);
+    free(f);
+}
+
+umc_family_t *
+umc_new_family(umc_ctx_t *ctx, const char *name, enum umc_type type, int flags)
+{
+    if (ctx == NULL || name == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&ctx->mtx);
+    umc_family_t *f = NULL;
+    HASH_FIND_STR(ctx->families, name, f); // GCOVR_EXCL_BR_LINE
+    if (f == NULL) {
+        f = calloc(1, sizeof(umc_family_t));
+        if (f != NULL) {
+            f->name = strdup(name);
+            f->type = type;
+            f->flags = flags;
+            pthread_rwlock_init(&f->lock, NULL);
+            HASH_ADD_KEYPTR(hh, // GCOVR_EXCL_BR_LINE
+                            ctx->families,
+                            f->name,
+                            strlen(f->name),
+                            f);
         }
     }
+    pthread_mutex_unlock(&ctx->mtx);
 
-    if (lock) {
-        pthread_mutex_unlock(&ctx->mtx);
+    return f;
+}
+
+umc_family_t *
+umc_get_family(umc_ctx_t *ctx, const char *name)
+{
+    if (ctx == NULL || name == NULL) {
+        return NULL;
     }
+    umc_family_t *f = NULL;
+    pthread_mutex_lock(&ctx->mtx);
+    HASH_FIND_STR(ctx->families, name, f); // GCOVR_EXCL_BR_LINE
+    pthread_mutex_unlock(&ctx->mtx);
+    return f;
+}
 
-    return 0;
+// find series (family lock held)
+static umc_series_t *
+series_find(umc_family_t *f, uint64_t key, const umc_label_t *l, int nr)
+{
+    umc_series_t *s = NULL;
+    HASH_FIND(hh, f->series, &key, sizeof(key), s); // GCOVR_EXCL_BR_LINE
+    while (s != NULL && !labels_equal(s, l, nr)) {
+        s = s->next;
+    }
+    return s;
+}
+
+umc_t *
+umc_family_get(umc_ctx_t *ctx,
+               umc_family_t *f,
+               const umc_label_t *labels,
+               int nr)
+{
+    if (ctx == NULL || f == NULL || nr < 0 || nr > UMC_LABELS_MAX ||
+        (nr > 0 && labels == NULL)) {
+        return NULL;
+    }
+
+    // canonical label set
+    umc_label_t l[UMC_LABELS_MAX];
+    for (int i = 0; i < nr; i++) {
+        if (labels[i].key == NULL || labels[i].value == NULL) {
+            return NULL;
+        }
+        l[i] = labels[i];
+    }
+    labels_sort(l, nr);
+    uint64_t key = labels_hash(l, nr);
+
+    // lookup (shared lock)
+    pthread_rwlock_rdlock(&f->lock);
+    umc_series_t *s = series_find(f, key, l, nr);
+    pthread_rwlock_unlock(&f->lock);
+    if (s != NULL) {
+        return s->c;
+    }
+
+    // create
+    pthread_rwlock_wrlock(&f->lock);
+    s = series_find(f, key, l, nr);
+    if (s != NULL) {
+        pthread_rwlock_unlock(&f->lock);
+        return s->c;
+    }
+    char id[UMC_NAME_MAX];
+    if (series_id(id, sizeof(id), f->name, l, nr) != 0) {
+        pthread_rwlock_unlock(&f->lock);
+        return NULL;
+    }
+    // grow member list
+    if (f->nr == f->cap) {
+        uint32_t cap = f->cap ? f->cap * 2 : 16;
+        umc_t **m = realloc(f->counters, cap * sizeof(umc_t *));
+        if (m == NULL) {
+            pthread_rwlock_unlock(&f->lock);
+            return NULL;
+        }
+        f->counters = m;
+        f->cap = cap;
+    }
+    umc_t *c = umc_new_counter_ex(ctx, id, f->type, f->flags);
+    s = calloc(1, sizeof(umc_series_t));
+    if (c == NULL || s == NULL) {
+        pthread_rwlock_unlock(&f->lock);
+        free(s);
+        return NULL;
+    }
+    s->key = key;
+    s->nr = nr;
+    s->c = c;
+    for (int i = 0; i < nr; i++) {
+        s->labels[i].key = strdup(l[i].key);
+        s->labels[i].value = strdup(l[i].value);
+    }
+    // chain hash collisions
+    umc_series_t *hs = NULL;
+    HASH_FIND(hh, f->series, &key, sizeof(key), hs); // GCOVR_EXCL_BR_LINE
+    if (hs != NULL) {
+        s->next = hs->next;
+        hs->next = s;
+    } else {
+        HASH_ADD(hh, f->series, key, sizeof(key), s); // GCOVR_EXCL_BR_LINE
+    }
+    f->counters[f->nr++] = c;
+    pthread_rwlock_unlock(&f->lock);
+
+    return c;
+}
+
+int
+umc_family_iter(umc_family_t *f, umc_cb_t cb, void *arg)
+{
+    if (f == NULL || cb == NULL) {
+        return 0;
+    }
+    pthread_rwlock_rdlock(&f->lock);
+    int nr = f->nr;
+    for (int i = 0; i < nr; i++) {
+        umc_t *c = f->counters[i];
+        // aggregate sharded value
+        if (c->shards != NULL) {
+            pthread_mutex_lock(&c->mtx);
+            shard_fold(c);
+            pthread_mutex_unlock(&c->mtx);
+        }
+        cb(c, arg);
+    }
+    pthread_rwlock_unlock(&f->lock);
+    return nr;
 }
 
 double
@@ -235,6 +1157,7 @@ umc_get_rate(umc_t *c, bool lock)
 
     if (lock) {
         pthread_mutex_lock(&c->mtx);
+        shard_fold(c);
     }
     uint64_t tdiff = c->values.ts_diff;
     uint64_t delta = c->values.delta;
@@ -249,6 +1172,29 @@ umc_get_rate(umc_t *c, bool lock)
     return 0;
 }
 
+int
+umc_get_rates(umc_t *c, umc_rates_t *r, bool lock)
+{
+    if (r == NULL) {
+        return 1;
+    }
+    memset(r, 0, sizeof(umc_rates_t));
+    if (c == NULL || c->win == NULL) {
+        return 1;
+    }
+
+    if (lock) {
+        pthread_mutex_lock(&c->mtx);
+        shard_fold(c);
+    }
+    win_rates(c->win, now_nsec(), r);
+    if (lock) {
+        pthread_mutex_unlock(&c->mtx);
+    }
+
+    return 0;
+}
+
 void
 umc_lag_start(umc_lag_t *lag)
 {
@@ -0,0 +1,219 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <umcpst.h>
+
+#ifdef UNIT_TESTING
+#include <cmocka_tests.h>
+#endif
+
+// first slot
+static inline umcpst_slot_t *
+slots(umcpst_hdr_t *hdr)
+{
+    return (umcpst_slot_t *)(hdr + 1);
+}
+
+/********/
+/* sync */
+/********/
+void
+umcpst_sync(umcpst_t *pst, bool wait)
+{
+    if (pst == NULL) {
+        return;
+    }
+    umcpst_hdr_t *hdr = pst->hdr;
+    uint32_t nr = hdr->nr;
+
+    // new counters (slot index is the counter index)
+    uint32_t n = umc_count(pst->ctx);
+    if (n > hdr->capacity) {
+        n = hdr->capacity;
+    }
+    for (; nr < n; nr++) {
+        umc_t *c = umc_at(pst->ctx, nr);
+        umcpst_slot_t *s = &slots(hdr)[nr];
+        s->type = c->type;
+        s->flags = c->flags;
+        snprintf(s->name, sizeof(s->name), "%s", c->idp);
+    }
+    // slot is complete before it is counted
+    __atomic_store_n(&hdr->nr, nr, __ATOMIC_RELEASE);
+
+    // update values
+    for (uint32_t i = 0; i < nr; i++) {
+        __atomic_store_n(&slots(hdr)[i].value,
+                         umc_peek(umc_at(pst->ctx, i)),
+                         __ATOMIC_RELAXED);
+    }
+    ++hdr->gen;
+
+    // write-back
+    msync(hdr, pst->sz, wait ? MS_SYNC : MS_ASYNC);
+}
+
+static void *
+th_umcpst(void *arg)
+{
+    umcpst_t *pst = arg;
+    while (!__atomic_load_n(&pst->stop, __ATOMIC_ACQUIRE)) {
+        umcpst_sync(pst, false);
+        // sleep in short steps (stop check)
+        for (int t = 0; t < pst->interval &&
+                        !__atomic_load_n(&pst->stop, __ATOMIC_ACQUIRE);
+             t += 100) {
+            int ms = pst->interval - t < 100 ? pst->interval - t : 100;
+            usleep(ms * 1000);
+        }
+    }
+    return NULL;
+}
+
+/***********/
+/* restore */
+/***********/
+// check existing store layout
+static bool
+hdr_valid(umcpst_hdr_t *hdr, size_t sz)
+{
+    return hdr->magic == UMCPST_MAGIC && hdr->version == UMCPST_VERSION &&
+           hdr->slot_sz == sizeof(umcpst_slot_t) && hdr->nr <= hdr->capacity &&
+           sizeof(umcpst_hdr_t) + (size_t)hdr->capacity * hdr->slot_sz == sz;
+}
+
+// re-create stored counters (empty context)
+static uint32_t
+restore(umcpst_t *pst)
+{
+    umcpst_hdr_t *hdr = pst->hdr;
+    uint32_t i;
+    for (i = 0; i < hdr->nr; i++) {
+        umcpst_slot_t *s = &slots(hdr)[i];
+        s->name[sizeof(s->name) - 1] = '\0';
+        umc_t *c = umc_new_counter_ex(pst->ctx, s->name, s->type, s->flags);
+        // duplicate or invalid slot; drop the rest
+        if (c == NULL || c->idx != i) {
+            break;
+        }
+        umc_restore(c, s->value);
+    }
+    hdr->nr = i;
+    return i;
+}
+
+umcpst_t *
+umcpst_new(umc_ctx_t *ctx, const char *path, uint32_t capacity, int interval)
+{
+    if (ctx == NULL || path == NULL || umc_count(ctx) > 0) {
+        return NULL;
+    }
+    if (capacity == 0) {
+        capacity = UMCPST_MAX;
+    }
+    if (interval <= 0) {
+        interval = UMCPST_INTERVAL;
+    }
+
+    // open or create store file
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // existing store (keep its capacity)
+    size_t sz = st.st_size;
+    bool init = true;
+    if (sz > sizeof(umcpst_hdr_t)) {
+        umcpst_hdr_t hdr;
+        if (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+            hdr_valid(&hdr, sz)) {
+            init = false;
+        }
+    }
+    // new store (or incompatible layout)
+    if (init) {
+        sz = sizeof(umcpst_hdr_t) + capacity * sizeof(umcpst_slot_t);
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, sz) != 0) {
+            close(fd);
+            return NULL;
+        }
+    }
+    void *m = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        return NULL;
+    }
+
+    umcpst_t *pst = calloc(1, sizeof(umcpst_t));
+    char *p = strdup(path);
+    if (pst == NULL || p == NULL) {
+        munmap(m, sz);
+        free(p);
+        free(pst);
+        return NULL;
+    }
+    pst->path = p;
+    pst->ctx = ctx;
+    pst->hdr = m;
+    pst->sz = sz;
+    pst->interval = interval;
+
+    // header (mapping is zero filled)
+    if (init) {
+        pst->hdr->version = UMCPST_VERSION;
+        pst->hdr->slot_sz = sizeof(umcpst_slot_t);
+        pst->hdr->capacity = capacity;
+        pst->hdr->magic = UMCPST_MAGIC;
+        msync(m, sz, MS_SYNC);
+
+    // re-create counters
+    } else {
+        pst->restored = restore(pst);
+    }
+
+    // sync thread
+    if (pthread_create(&pst->th, NULL, &th_umcpst, pst) != 0) {
+        munmap(m, sz);
+        free(pst->path);
+        free(pst);
+        return NULL;
+    }
+
+    return pst;
+}
+
+void
+umcpst_free(umcpst_t *pst)
+{
+    if (pst == NULL) {
+        return;
+    }
+    __atomic_store_n(&pst->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(pst->th, NULL);
+    // final values
+    umcpst_sync(pst, true);
+    munmap(pst->hdr, pst->sz);
+    free(pst->path);
+    free(pst);
+}
@@ -0,0 +1,315 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <umcshm.h>
+
+#ifdef UNIT_TESTING
+#include <cmocka_tests.h>
+#endif
+
+// reader retries for a slot being written
+#define UMCSHM_READ_RETRIES 100
+
+// first slot
+static inline umcshm_slot_t *
+slots(umcshm_hdr_t *hdr)
+{
+    return (umcshm_slot_t *)(hdr + 1);
+}
+
+// current monotonic ts in nsec
+static uint64_t
+now_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*************/
+/* publisher */
+/*************/
+// write slot values (seqlock)
+static void
+slot_write(umcshm_slot_t *s, umc_t *c, bool init)
+{
+    // collect values before entering the write section
+    umcshm_slot_t v;
+    v.value = umc_peek(c);
+    v.max = __atomic_load_n(&c->values.max, __ATOMIC_RELAXED);
+    // counter lock only (folds sharded values)
+    v.rate = umc_get_rate(c, true);
+    umc_rates_t r;
+    umc_get_rates(c, &r, true);
+    v.rate_win = r.win;
+    v.ewma_1s = r.ewma_1s;
+    v.ewma_10s = r.ewma_10s;
+    v.ewma_60s = r.ewma_60s;
+    umc_hist_stats_t hs;
+    umc_get_hist(c, &hs);
+    v.count = hs.count;
+    v.p50 = hs.p50;
+    v.p90 = hs.p90;
+    v.p99 = hs.p99;
+    v.p999 = hs.p999;
+
+    // begin (odd sequence)
+    uint32_t seq = s->seq;
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (init) {
+        s->type = c->type;
+        snprintf(s->name, sizeof(s->name), "%s", c->idp);
+    }
+    memcpy(&s->value,
+           &v.value,
+           sizeof(umcshm_slot_t) - offsetof(umcshm_slot_t, value));
+    // end (even sequence)
+    __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void
+umcshm_publish(umcshm_t *shm)
+{
+    if (shm == NULL) {
+        return;
+    }
+    umcshm_hdr_t *hdr = shm->hdr;
+    uint32_t nr = hdr->nr;
+
+    // new counters (slot index is the counter index)
+    uint32_t n = umc_count(shm->ctx);
+    if (n > hdr->capacity) {
+        n = hdr->capacity;
+    }
+    for (; nr < n; nr++) {
+        slot_write(&slots(hdr)[nr], umc_at(shm->ctx, nr), true);
+    }
+
+    // update values
+    for (uint32_t i = 0; i < hdr->nr; i++) {
+        slot_write(&slots(hdr)[i], umc_at(shm->ctx, i), false);
+    }
+    // publish new slots
+    __atomic_store_n(&hdr->nr, nr, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->ts_nsec, now_nsec(), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hdr->gen, 1, __ATOMIC_RELEASE);
+}
+
+static void *
+th_umcshm(void *arg)
+{
+    umcshm_t *shm = arg;
+    while (!__atomic_load_n(&shm->stop, __ATOMIC_ACQUIRE)) {
+        umcshm_publish(shm);
+        // sleep in short steps (stop check)
+        for (int t = 0; t < shm->interval &&
+                        !__atomic_load_n(&shm->stop, __ATOMIC_ACQUIRE);
+             t += 100) {
+            int ms = shm->interval - t < 100 ? shm->interval - t : 100;
+            usleep(ms * 1000);
+        }
+    }
+    return NULL;
+}
+
+umcshm_t *
+umcshm_new(umc_ctx_t *ctx, const char *path, uint32_t capacity, int interval)
+{
+    if (ctx == NULL || path == NULL) {
+        return NULL;
+    }
+    if (capacity == 0) {
+        capacity = UMCSHM_MAX;
+    }
+    if (interval <= 0) {
+        interval = UMCSHM_INTERVAL;
+    }
+
+    // create segment file (new file; never follow a link
+    // planted in a shared directory)
+    size_t sz = sizeof(umcshm_hdr_t) + capacity * sizeof(umcshm_slot_t);
+    unlink(path);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, sz) != 0) {
+        close(fd);
+        unlink(path);
+        return NULL;
+    }
+    void *m = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        unlink(path);
+        return NULL;
+    }
+
+    // publisher
+    umcshm_t *shm = calloc(1, sizeof(umcshm_t));
+    if (shm == NULL || (shm->path = strdup(path)) == NULL) {
+        munmap(m, sz);
+        unlink(path);
+        free(shm);
+        return NULL;
+    }
+    shm->ctx = ctx;
+    shm->hdr = m;
+    shm->sz = sz;
+    shm->interval = interval;
+
+    // header (mapping is zero filled)
+    shm->hdr->version = UMCSHM_VERSION;
+    shm->hdr->slot_sz = sizeof(umcshm_slot_t);
+    shm->hdr->capacity = capacity;
+    shm->hdr->pid = getpid();
+    // magic last; readers check it first
+    __atomic_store_n(&shm->hdr->magic, UMCSHM_MAGIC, __ATOMIC_RELEASE);
+
+    // publisher thread
+    if (pthread_create(&shm->th, NULL, &th_umcshm, shm) != 0) {
+        munmap(m, sz);
+        unlink(path);
+        free(shm->path);
+        free(shm);
+        return NULL;
+    }
+
+    return shm;
+}
+
+void
+umcshm_free(umcshm_t *shm)
+{
+    if (shm == NULL) {
+        return;
+    }
+    __atomic_store_n(&shm->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(shm->th, NULL);
+    munmap(shm->hdr, shm->sz);
+    unlink(shm->path);
+    free(shm->path);
+    free(shm);
+}
+
+/**********/
+/* reader */
+/**********/
+umcshm_reader_t *
+umcshm_open(const char *path)
+{
+    if (path == NULL) {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(umcshm_hdr_t)) {
+        close(fd);
+        return NULL;
+    }
+    void *m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        return NULL;
+    }
+
+    // check layout
+    umcshm_hdr_t *hdr = m;
+    size_t sz = st.st_size;
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != UMCSHM_MAGIC ||
+        hdr->version != UMCSHM_VERSION ||
+        hdr->slot_sz != sizeof(umcshm_slot_t) ||
+        sizeof(umcshm_hdr_t) + (size_t)hdr->capacity * hdr->slot_sz > sz) {
+        munmap(m, sz);
+        return NULL;
+    }
+
+    umcshm_reader_t *rd = malloc(sizeof(umcshm_reader_t));
+    if (rd == NULL) {
+        munmap(m, sz);
+        return NULL;
+    }
+    rd->hdr = hdr;
+    rd->sz = sz;
+    return rd;
+}
+
+void
+umcshm_close(umcshm_reader_t *rd)
+{
+    if (rd == NULL) {
+        return;
+    }
+    munmap(rd->hdr, rd->sz);
+    free(rd);
+}
+
+uint32_t
+umcshm_count(umcshm_reader_t *rd)
+{
+    if (rd == NULL) {
+        return 0;
+    }
+    uint32_t nr = __atomic_load_n(&rd->hdr->nr, __ATOMIC_ACQUIRE);
+    return nr < rd->hdr->capacity ? nr : rd->hdr->capacity;
+}
+
+int
+umcshm_read(umcshm_reader_t *rd, uint32_t idx, umcshm_slot_t *out)
+{
+    if (rd == NULL || out == NULL || idx >= umcshm_count(rd)) {
+        return 1;
+    }
+    umcshm_slot_t *s = &slots(rd->hdr)[idx];
+    for (int i = 0; i < UMCSHM_READ_RETRIES; i++) {
+        uint32_t s1 = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(out, s, sizeof(umcshm_slot_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == s1) {
+            out->name[sizeof(out->name) - 1] = '\0';
+            return 0;
+        }
+    }
+    return 2;
+}
+
+int
+umcshm_read_all(umcshm_reader_t *rd, umcshm_cb_t cb, void *arg)
+{
+    if (rd == NULL || cb == NULL) {
+        return 0;
+    }
+    int res = 0;
+    umcshm_slot_t s;
+    uint32_t nr = umcshm_count(rd);
+    for (uint32_t i = 0; i < nr; i++) {
+        if (umcshm_read(rd, i, &s) == 0) {
+            cb(&s, arg);
+            ++res;
+        }
+    }
+    return res;
+}
@@ -8,9 +8,12 @@
  *
  */
 
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <umdb.h>
 
 #ifdef UNIT_TESTING
@@ -50,25 +53,307 @@ static const char *SQL_STORAGE_SET =
 // get custom user data
 static const char *SQL_STORAGE_GET = "SELECT v FROM %s WHERE k = ?";
 
+// delete custom user data
+static const char *SQL_STORAGE_DEL = "DELETE FROM %s WHERE k = ?";
+
+// increment custom user data (new value is returned)
+static const char *SQL_STORAGE_INCR =
+    "INSERT INTO %s VALUES (?1, ?2) ON CONFLICT(k) "
+    "DO UPDATE SET v = CAST(v AS INTEGER) + ?2 RETURNING v";
+
+// compare-and-set custom user data (row is returned if set)
+static const char *SQL_STORAGE_CAS =
+    "UPDATE %s SET v = ?3 WHERE k = ?1 AND v = ?2 RETURNING v";
+
+// set custom user data if missing (row is returned if set)
+static const char *SQL_STORAGE_CAS_NEW =
+    "INSERT INTO %s VALUES (?1, ?3) ON CONFLICT(k) DO NOTHING RETURNING v";
+
+// find custom user data by key prefix (numeric keys are not
+// stored as text, a range on k would skip them)
+static const char *SQL_STORAGE_SCAN =
+    "SELECT k, v FROM %s WHERE substr(k, 1, length(?1)) = ?1 "
+    "ORDER BY k LIMIT ?2";
+
+static void wb_stop(umdb_mngrd_t *m);
+
+/*******************/
+/* statement cache */
+/*******************/
+// forget initialized storage (cache lock held)
+static void
+store_forget(umdb_mngrd_t *m, const char *name)
+{
+    umdb_store_t *st = NULL;
+    HASH_FIND_STR(m->stores, name, st); // GCOVR_EXCL_BR_LINE
+    if (st != NULL) {
+        HASH_DEL(m->stores, st); // GCOVR_EXCL_BR_LINE
+        free(st->name);
+        free(st);
+    }
+}
+
+// get cached or new statement (cache owned by caller)
+static umdb_stmt_t *
+stmt_get(sqlite3 *db, umdb_stmt_t **stmts, enum query_type qt, const char *tbl)
+{
+    // cache key
+    size_t sz = snprintf(NULL, 0, "%d:%s", qt, tbl != NULL ? tbl : "");
+    char key[sz + 1];
+    snprintf(key, sz + 1, "%d:%s", qt, tbl != NULL ? tbl : "");
+
+    // cached (move to the end, most recently used)
+    umdb_stmt_t *e = NULL;
+    HASH_FIND_STR(*stmts, key, e); // GCOVR_EXCL_BR_LINE
+    if (e != NULL) {
+        HASH_DELETE(hh, *stmts, e); // GCOVR_EXCL_BR_LINE
+        // GCOVR_EXCL_BR_START
+        HASH_ADD_KEYPTR(hh, *stmts, e->key, strlen(e->key), e);
+        // GCOVR_EXCL_BR_STOP
+        return e;
+    }
+
+    // sql (table names cannot be changed with bind methods)
+    const char *sql = NULL;
+    switch (qt) {
+    case USER_AUTH:
+        sql = SQL_USER_AUTH;
+        break;
+    case USER_GET:
+        sql = SQL_USER_GET;
+        break;
+    case STORE_SET:
+        sql = SQL_STORAGE_SET;
+        break;
+    case STORE_GET:
+        sql = SQL_STORAGE_GET;
+        break;
+    case STORE_DEL:
+        sql = SQL_STORAGE_DEL;
+        break;
+    case STORE_SCAN:
+        sql = SQL_STORAGE_SCAN;
+        break;
+    case STORE_INCR:
+        sql = SQL_STORAGE_INCR;
+        break;
+    case STORE_CAS:
+        sql = SQL_STORAGE_CAS;
+        break;
+    case STORE_CAS_NEW:
+        sql = SQL_STORAGE_CAS_NEW;
+        break;
+    default:
+        return NULL;
+    }
+    sz = snprintf(NULL, 0, sql, tbl);
+    char q[sz + 1];
+    snprintf(q, sz + 1, sql, tbl);
+
+    // prepare statement
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v3(db,
+                           q,
+                           -1,
+                           SQLITE_PREPARE_PERSISTENT,
+                           &stmt,
+                           NULL) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    // evict least recently used
+    if (HASH_COUNT(*stmts) >= UMDB_STMT_MAX) {
+        umdb_stmt_t *lru = *stmts;
+        HASH_DELETE(hh, *stmts, lru); // GCOVR_EXCL_BR_LINE
+        sqlite3_finalize(lru->stmt);
+        free(lru->key);
+        free(lru);
+    }
+
+    // add to cache
+    e = malloc(sizeof(umdb_stmt_t));
+    e->key = strdup(key);
+    e->stmt = stmt;
+    // GCOVR_EXCL_BR_START
+    HASH_ADD_KEYPTR(hh, *stmts, e->key, strlen(e->key), e);
+    // GCOVR_EXCL_BR_STOP
+    return e;
+}
+
+// reset statement for reuse; statements that cannot be
+// reset are removed from cache
+static int
+stmt_put(umdb_stmt_t **stmts, umdb_stmt_t *e)
+{
+    int r = 0;
+    if (sqlite3_clear_bindings(e->stmt)) {
+        r = 1;
+    }
+    if (sqlite3_reset(e->stmt)) {
+        r = 2;
+    }
+    if (r != 0) {
+        HASH_DELETE(hh, *stmts, e); // GCOVR_EXCL_BR_LINE
+        sqlite3_finalize(e->stmt);
+        free(e->key);
+        free(e);
+    }
+    return r;
+}
+
+// free cached statements
+static void
+stmt_free_all(umdb_stmt_t **stmts)
+{
+    umdb_stmt_t *e;
+    umdb_stmt_t *tmp;
+    HASH_ITER(hh, *stmts, e, tmp)
+    {
+        HASH_DEL(*stmts, e); // GCOVR_EXCL_BR_LINE
+        sqlite3_finalize(e->stmt);
+        free(e->key);
+        free(e);
+    }
+}
+
+/********************/
+/* read connections */
+/********************/
+// thread without read connection (limit reached)
+static umdb_conn_t conn_none;
+
+// thread exit (connection can be taken by another thread)
+static void
+conn_release(void *arg)
+{
+    umdb_conn_t *c = arg;
+    if (c != &conn_none) {
+        __atomic_store_n(&c->used, 0, __ATOMIC_RELEASE);
+    }
+}
+
+// get thread-local read connection (NULL = use writer)
+static umdb_conn_t *
+conn_get(umdb_mngrd_t *m)
+{
+    umdb_conn_t *c = pthread_getspecific(m->rd_key);
+    if (c != NULL) {
+        return c != &conn_none ? c : NULL;
+    }
+
+    pthread_mutex_lock(&m->mtx);
+    // connection released by exited thread
+    for (c = m->readers; c != NULL; c = c->next) {
+        if (!__atomic_load_n(&c->used, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    // new connection (in-memory DB is private to writer)
+    if (c == NULL && !m->mem && m->readers_nr < UMDB_READERS_MAX) {
+        sqlite3 *db = NULL;
+        int flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX;
+        if (sqlite3_open_v2(m->path, &db, flags, NULL) == SQLITE_OK) {
+            sqlite3_busy_timeout(db, UMDB_BUSY_TIMEOUT);
+            c = calloc(1, sizeof(umdb_conn_t));
+            c->db = db;
+            c->next = m->readers;
+            m->readers = c;
+            ++m->readers_nr;
+        } else {
+            sqlite3_close_v2(db);
+        }
+    }
+    if (c != NULL) {
+        __atomic_store_n(&c->used, 1, __ATOMIC_RELEASE);
+    }
+    pthread_setspecific(m->rd_key, c != NULL ? c : &conn_none);
+    pthread_mutex_unlock(&m->mtx);
+
+    return c;
+}
+
+// begin read (thread-local connection or locked writer)
+static umdb_conn_t *
+rd_begin(umdb_mngrd_t *m, sqlite3 **db, umdb_stmt_t ***stmts)
+{
+    umdb_conn_t *c = conn_get(m);
+    if (c != NULL) {
+        *db = c->db;
+        *stmts = &c->stmts;
+    } else {
+        pthread_mutex_lock(&m->mtx);
+        *db = m->db;
+        *stmts = &m->stmts;
+    }
+    return c;
+}
+
+// end read; forget storage if its table might have been removed
+static void
+rd_end(umdb_mngrd_t *m, umdb_conn_t *c, const char *forget)
+{
+    if (c != NULL && forget != NULL) {
+        pthread_mutex_lock(&m->mtx);
+    }
+    if (forget != NULL) {
+        store_forget(m, forget);
+    }
+    if (c == NULL || forget != NULL) {
+        pthread_mutex_unlock(&m->mtx);
+    }
+}
+
+// DB busy or locked (not a statement or schema error)
+static bool
+rd_busy(int sr)
+{
+    return (sr & 0xff) == SQLITE_BUSY || (sr & 0xff) == SQLITE_LOCKED;
+}
+
+// step read statement; busy DB (e.g. concurrent commit or
+// WAL recovery) is retried a few times
+static int
+rd_step(sqlite3_stmt *stmt)
+{
+    int sr = sqlite3_step(stmt);
+    for (int i = 0; i < UMDB_READ_RETRIES && rd_busy(sr); i++) {
+        sqlite3_reset(stmt);
+        struct timespec ts = { 0, 1000000 };
+        nanosleep(&ts, NULL);
+        sr = sqlite3_step(stmt);
+    }
+    return sr;
+}
+
 umdb_mngrd_t *
 umdb_mngr_new(const char *db, bool mem)
 {
     if (!mem && db == NULL) {
         return NULL;
     }
+    umdb_mngrd_t *m = calloc(1, sizeof(umdb_mngrd_t));
+    if (m == NULL) {
+        return NULL;
+    }
     sqlite3 *db_p = NULL;
-    if (!sqlite3_open_v2(db,
-                         &db_p,
-                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_FULLMUTEX |
-                             (mem ? SQLITE_OPEN_MEMORY : 0),
-                         NULL)) {
-        umdb_mngrd_t *m = malloc(sizeof(umdb_mngrd_t));
-        m->db = db_p;
-        return m;
+    if (sqlite3_open_v2(mem ? ":memory:" : db,
+                        &db_p,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_FULLMUTEX |
+                            (mem ? SQLITE_OPEN_MEMORY : 0),
+                        NULL)) {
+        sqlite3_close_v2(db_p);
+        free(m);
+        return NULL;
     }
-
-    sqlite3_close_v2(db_p);
-    return NULL;
+    // readers might hold locks (rollback journal)
+    sqlite3_busy_timeout(db_p, UMDB_BUSY_TIMEOUT);
+    m->db = db_p;
+    m->path = strdup(mem ? ":memory:" : db);
+    m->mem = mem;
+    pthread_key_create(&m->rd_key, &conn_release);
+    pthread_mutex_init(&m->mtx, NULL);
+    return m;
 }
 
 void
@@ -77,9 +362,42 @@ umdb_mngr_free(umdb_mngrd_t *m)
     if (m == NULL) {
         return;
     }
+    // commit pending writes
+    wb_stop(m);
+    // read connections
+    pthread_key_delete(m->rd_key);
+    while (m->readers != NULL) {
+        umdb_conn_t *c = m->readers;
+        m->readers = c->next;
+        stmt_free_all(&c->stmts);
+        sqlite3_close_v2(c->db);
+        free(c);
+    }
+    // cached statements
+    stmt_free_all(&m->stmts);
+    // initialized storages
+    umdb_store_t *st;
+    umdb_store_t *st_tmp;
+    HASH_ITER(hh, m->stores, st, st_tmp)
+    {
+        HASH_DEL(m->stores, st); // GCOVR_EXCL_BR_LINE
+        free(st->name);
+        free(st);
+    }
+    // key watches
+    while (m->watches != NULL) {
+        umdb_watch_t *w = m->watches;
+        m->watches = w->next;
+        free(w->db);
+        free(w->key);
+        free(w->name);
+        free(w);
+    }
     if (m->db) {
         sqlite3_close_v2(m->db);
     }
+    pthread_mutex_destroy(&m->mtx);
+    free(m->path);
     free(m);
 }
 
@@ -97,44 +415,47 @@ umdb_mngr_uauth(umdb_mngrd_t *m,
     if (m == NULL || m->db == NULL || res == NULL || u == NULL || p == NULL) {
         return 1;
     }
-    // prepare statement
-    sqlite3_stmt *stmt = NULL;
-    int r = sqlite3_prepare_v2(m->db, SQL_USER_AUTH, -1, &stmt, NULL);
-    if (r != SQLITE_OK) {
+    // prepared statement (read connection)
+    sqlite3 *db = NULL;
+    umdb_stmt_t **stmts = NULL;
+    umdb_conn_t *c = rd_begin(m, &db, &stmts);
+    umdb_stmt_t *e = stmt_get(db, stmts, USER_AUTH, NULL);
+    if (e == NULL) {
+        rd_end(m, c, NULL);
         return 2;
     }
+    sqlite3_stmt *stmt = e->stmt;
 
-    // username
+    // bind username, pwd, username
+    int r = 0;
     if (sqlite3_bind_text(stmt, 1, u, strlen(u), SQLITE_STATIC)) {
-        return 3;
-    }
-    // pwd
-    if (sqlite3_bind_text(stmt, 2, p, strlen(p), SQLITE_STATIC)) {
-        return 4;
-    }
-    // username
-    if (sqlite3_bind_text(stmt, 3, u, strlen(u), SQLITE_STATIC)) {
-        return 5;
+        r = 3;
+    } else if (sqlite3_bind_text(stmt, 2, p, strlen(p), SQLITE_STATIC)) {
+        r = 4;
+    } else if (sqlite3_bind_text(stmt, 3, u, strlen(u), SQLITE_STATIC)) {
+        r = 5;
     }
 
     // step
     int usr_flags = 0;
     int usr_id = -1;
     int auth = -1;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    int sr = r == 0 ? rd_step(stmt) : SQLITE_DONE;
+    if (sr == SQLITE_ROW) {
         usr_id = sqlite3_column_int(stmt, 0);
         usr_flags = sqlite3_column_int(stmt, 1);
         auth = sqlite3_column_int(stmt, 3);
+    // step error (not an unknown user)
+    } else if (sr != SQLITE_DONE) {
+        r = 6;
     }
-    // cleanup
-    if (sqlite3_clear_bindings(stmt)) {
-        return 6;
-    }
-    if (sqlite3_reset(stmt)) {
-        return 7;
+    // cleanup (reset for reuse)
+    if (stmt_put(stmts, e) && r == 0) {
+        r = 7;
     }
-    if (sqlite3_finalize(stmt)) {
-        return 8;
+    rd_end(m, c, NULL);
+    if (r != 0) {
+        return r;
     }
 
     // user auth result
@@ -152,35 +473,42 @@ umdb_mngr_uget(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u)
     if (m == NULL || m->db == NULL || res == NULL || u == NULL) {
         return 1;
     }
-    // prepare statement
-    sqlite3_stmt *stmt = NULL;
-    int r = sqlite3_prepare_v2(m->db, SQL_USER_GET, -1, &stmt, NULL);
-    if (r != SQLITE_OK) {
+    // prepared statement (read connection)
+    sqlite3 *db = NULL;
+    umdb_stmt_t **stmts = NULL;
+    umdb_conn_t *c = rd_begin(m, &db, &stmts);
+    umdb_stmt_t *e = stmt_get(db, stmts, USER_GET, NULL);
+    if (e == NULL) {
+        rd_end(m, c, NULL);
         return 2;
     }
+    sqlite3_stmt *stmt = e->stmt;
 
     // username
+    int r = 0;
     if (sqlite3_bind_text(stmt, 1, u, strlen(u), SQLITE_STATIC)) {
-        return 3;
+        r = 3;
     }
 
     // step
     int usr_flags = 0;
     int usr_id = -1;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    int sr = r == 0 ? rd_step(stmt) : SQLITE_DONE;
+    if (sr == SQLITE_ROW) {
         usr_id = sqlite3_column_int(stmt, 0);
         usr_flags = sqlite3_column_int(stmt, 3);
+    // step error (not an unknown user)
+    } else if (sr != SQLITE_DONE) {
+        r = 6;
     }
 
-    // cleanup
-    if (sqlite3_clear_bindings(stmt)) {
-        return 6;
+    // cleanup (reset for reuse)
+    if (stmt_put(stmts, e) && r == 0) {
+        r = 7;
     }
-    if (sqlite3_reset(stmt)) {
-        return 7;
-    }
-    if (sqlite3_finalize(stmt)) {
-        return 8;
+    rd_end(m, c, NULL);
+    if (r != 0) {
+        return r;
     }
 
     // user get result
@@ -192,64 +520,833 @@ umdb_mngr_uget(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u)
     return 0;
 }
 
-int
-umdb_mngr_store_set(umdb_mngrd_t *m,
-                    const char *db,
-                    const char *k,
-                    const char *v)
+// set custom storage data (cache lock held)
+static int
+store_set(umdb_mngrd_t *m, const char *db, const char *k, const char *v)
 {
-    // sanity check
-    if (m == NULL || db == NULL || k == NULL || v == NULL) {
-        return 1;
+    // prepared statement
+    umdb_stmt_t *e = stmt_get(m->db, &m->stmts, STORE_SET, db);
+    if (e == NULL) {
+        // missing table (removed or never initialized)
+        store_forget(m, db);
+        return 2;
     }
+    sqlite3_stmt *stmt = e->stmt;
 
-    // prepare query
-    size_t sz = snprintf(NULL, 0, SQL_STORAGE_SET, db);
-    char s[sz + 1];
-    snprintf(s, sz + 1, SQL_STORAGE_SET, db);
+    // key, value and updated value (on conflict)
+    int r = 0;
+    if (sqlite3_bind_text(stmt, 1, k, strlen(k), SQLITE_STATIC)) {
+        r = 3;
+    } else if (sqlite3_bind_text(stmt, 2, v, strlen(v), SQLITE_STATIC)) {
+        r = 4;
+    } else if (sqlite3_bind_text(stmt, 3, v, strlen(v), SQLITE_STATIC)) {
+        r = 5;
+    }
 
-    // prepare statement
-    sqlite3_stmt *stmt = NULL;
-    int r = sqlite3_prepare_v2(m->db, s, -1, &stmt, NULL);
-    if (r != SQLITE_OK) {
+    // step
+    if (r == 0 && sqlite3_step(stmt) != SQLITE_DONE) {
+        r = 9;
+    }
+
+    // cleanup (reset for reuse)
+    if (stmt_put(&m->stmts, e) && r == 0) {
+        r = 7;
+    }
+    // table might have been removed
+    if (r == 9 || r == 7) {
+        store_forget(m, db);
+    }
+    return r;
+}
+
+// delete custom storage data (cache lock held)
+static int
+store_del(umdb_mngrd_t *m, const char *db, const char *k)
+{
+    // prepared statement
+    umdb_stmt_t *e = stmt_get(m->db, &m->stmts, STORE_DEL, db);
+    if (e == NULL) {
+        // missing table (removed or never initialized)
+        store_forget(m, db);
         return 2;
     }
+    sqlite3_stmt *stmt = e->stmt;
 
     // key
+    int r = 0;
     if (sqlite3_bind_text(stmt, 1, k, strlen(k), SQLITE_STATIC)) {
+        r = 3;
+    }
+
+    // step
+    if (r == 0 && sqlite3_step(stmt) != SQLITE_DONE) {
+        r = 9;
+    }
+
+    // cleanup (reset for reuse)
+    if (stmt_put(&m->stmts, e) && r == 0) {
+        r = 7;
+    }
+    // table might have been removed
+    if (r == 9 || r == 7) {
+        store_forget(m, db);
+    }
+    return r;
+}
+
+// get custom storage data (read connection)
+static int
+store_get(umdb_mngrd_t *m,
+          const char *db,
+          const char *k,
+          char **out,
+          size_t *out_sz)
+{
+    // prepared statement (read connection)
+    sqlite3 *rdb = NULL;
+    umdb_stmt_t **stmts = NULL;
+    umdb_conn_t *c = rd_begin(m, &rdb, &stmts);
+    umdb_stmt_t *e = stmt_get(rdb, stmts, STORE_GET, db);
+    if (e == NULL) {
+        // missing table (removed or never initialized)
+        rd_end(m, c, db);
         return 3;
     }
+    sqlite3_stmt *stmt = e->stmt;
 
-    // value
-    if (sqlite3_bind_text(stmt, 2, v, strlen(v), SQLITE_STATIC)) {
+    // key
+    if (sqlite3_bind_text(stmt, 1, k, strlen(k), SQLITE_STATIC)) {
+        stmt_put(stmts, e);
+        rd_end(m, c, NULL);
         return 4;
     }
 
-    // updated value (on conflict)
-    if (sqlite3_bind_text(stmt, 3, v, strlen(v), SQLITE_STATIC)) {
-        return 5;
+    // get value
+    int r = 0;
+    *out_sz = 0;
+    int sr = rd_step(stmt);
+    if (sr == SQLITE_ROW) {
+        const unsigned char *v = sqlite3_column_text(stmt, 0);
+        r = strlen((const char *)v);
+        *out = strdup((const char *)v);
+        *out_sz = r + 1;
     }
 
-    // step
-    r = sqlite3_step(stmt);
+    // cleanup (reset for reuse); table might have been removed
+    // (busy DB is an error, storage is kept)
+    int rr = stmt_put(stmts, e);
+    rd_end(m, c, rr != 0 && !rd_busy(sr) ? db : NULL);
+    if (sr != SQLITE_ROW && sr != SQLITE_DONE) {
+        return 9;
+    }
+    if (rr != 0) {
+        return 4 + rr;
+    }
 
-    // cleanup
-    if (sqlite3_clear_bindings(stmt)) {
-        return 6;
+    return (r > 0 ? 0 : 8);
+}
+
+// get custom storage data using writer connection (cache
+// lock held); NULL if missing
+static char *
+store_peek(umdb_mngrd_t *m, const char *db, const char *k)
+{
+    umdb_stmt_t *e = stmt_get(m->db, &m->stmts, STORE_GET, db);
+    if (e == NULL) {
+        return NULL;
     }
-    if (sqlite3_reset(stmt)) {
-        return 7;
+    char *v = NULL;
+    if (sqlite3_bind_text(e->stmt, 1, k, strlen(k), SQLITE_STATIC) ==
+            SQLITE_OK &&
+        sqlite3_step(e->stmt) == SQLITE_ROW) {
+        const char *cv = (const char *)sqlite3_column_text(e->stmt, 0);
+        if (cv != NULL) {
+            v = strdup(cv);
+        }
     }
-    if (sqlite3_finalize(stmt)) {
-        return 8;
+    stmt_put(&m->stmts, e);
+    return v;
+}
+
+// increment custom storage data (cache lock held)
+static int
+store_incr(umdb_mngrd_t *m,
+           const char *db,
+           const char *k,
+           int64_t delta,
+           int64_t *out)
+{
+    // prepared statement
+    umdb_stmt_t *e = stmt_get(m->db, &m->stmts, STORE_INCR, db);
+    if (e == NULL) {
+        // missing table (removed or never initialized)
+        store_forget(m, db);
+        return 2;
     }
+    sqlite3_stmt *stmt = e->stmt;
 
-    if (r != SQLITE_DONE){
-        return 9;
+    // key and increment
+    int r = 0;
+    if (sqlite3_bind_text(stmt, 1, k, strlen(k), SQLITE_STATIC)) {
+        r = 3;
+    } else if (sqlite3_bind_int64(stmt, 2, delta)) {
+        r = 4;
+    }
+
+    // step (new value is returned)
+    if (r == 0 && sqlite3_step(stmt) != SQLITE_ROW) {
+        r = 9;
+    } else if (r == 0) {
+        if (out != NULL) {
+            *out = sqlite3_column_int64(stmt, 0);
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            r = 9;
+        }
+    }
+
+    // cleanup (reset for reuse)
+    if (stmt_put(&m->stmts, e) && r == 0) {
+        r = 7;
+    }
+    // table might have been removed
+    if (r == 9 || r == 7) {
+        store_forget(m, db);
+    }
+    return r;
+}
+
+// compare-and-set custom storage data (cache lock held)
+static int
+store_cas(umdb_mngrd_t *m,
+          const char *db,
+          const char *k,
+          const char *old,
+          const char *v)
+{
+    // prepared statement (update or insert if missing)
+    enum query_type qt = old != NULL ? STORE_CAS : STORE_CAS_NEW;
+    umdb_stmt_t *e = stmt_get(m->db, &m->stmts, qt, db);
+    if (e == NULL) {
+        // missing table (removed or never initialized)
+        store_forget(m, db);
+        return 2;
+    }
+    sqlite3_stmt *stmt = e->stmt;
+
+    // key, expected value and new value
+    int r = 0;
+    if (sqlite3_bind_text(stmt, 1, k, strlen(k), SQLITE_STATIC)) {
+        r = 3;
+    } else if (old != NULL &&
+               sqlite3_bind_text(stmt, 2, old, strlen(old), SQLITE_STATIC)) {
+        r = 4;
+    } else if (sqlite3_bind_text(stmt, 3, v, strlen(v), SQLITE_STATIC)) {
+        r = 5;
+    }
+
+    // step (row is returned if value was set)
+    if (r == 0) {
+        int sr = sqlite3_step(stmt);
+        if (sr == SQLITE_ROW) {
+            sr = sqlite3_step(stmt);
+        } else {
+            r = 8;
+        }
+        if (sr != SQLITE_DONE) {
+            r = 9;
+        }
+    }
+
+    // cleanup (reset for reuse)
+    if (stmt_put(&m->stmts, e) && (r == 0 || r == 8)) {
+        r = 7;
+    }
+    // table might have been removed
+    if (r == 9 || r == 7) {
+        store_forget(m, db);
+    }
+    return r;
+}
+
+/****************/
+/* write-behind */
+/****************/
+static void
+wbe_free(umdb_wbe_t *e)
+{
+    free(e->key);
+    free(e->v);
+    free(e);
+}
+
+// overlay key (storage name and data key)
+static size_t
+wb_key(const char *db, const char *k, char *out)
+{
+    size_t db_sz = strlen(db);
+    size_t k_sz = strlen(k);
+    if (out != NULL) {
+        memcpy(out, db, db_sz + 1);
+        memcpy(out + db_sz + 1, k, k_sz);
+    }
+    return db_sz + 1 + k_sz;
+}
+
+// add or replace pending set; NULL value is a pending
+// delete (overlay lock held)
+static int
+wb_put(umdb_wb_t *wb, const char *db, const char *k, const char *v)
+{
+    size_t sz = wb_key(db, k, NULL);
+    char key[sz];
+    wb_key(db, k, key);
+
+    umdb_wbe_t *e = NULL;
+    HASH_FIND(hh, wb->pending, key, sz, e); // GCOVR_EXCL_BR_LINE
+    char *nv = v != NULL ? strdup(v) : NULL;
+    if (v != NULL && nv == NULL) {
+        return 1;
+    }
+    // newer value (coalesced)
+    if (e != NULL) {
+        free(e->v);
+        e->v = nv;
+        return 0;
+    }
+    e = malloc(sizeof(umdb_wbe_t));
+    // terminated data key (commit)
+    char *ek = malloc(sz + 1);
+    if (e == NULL || ek == NULL) {
+        free(e);
+        free(ek);
+        free(nv);
+        return 1;
+    }
+    memcpy(ek, key, sz);
+    ek[sz] = '\0';
+    e->key = ek;
+    e->key_sz = sz;
+    e->v = nv;
+    // GCOVR_EXCL_BR_START
+    HASH_ADD_KEYPTR(hh, wb->pending, e->key, e->key_sz, e);
+    // GCOVR_EXCL_BR_STOP
+    return 0;
+}
+
+// find entry in overlay (overlay lock held)
+static umdb_wbe_t *
+wb_get(umdb_wb_t *wb, const char *db, const char *k)
+{
+    size_t sz = wb_key(db, k, NULL);
+    char key[sz];
+    wb_key(db, k, key);
+
+    umdb_wbe_t *e = NULL;
+    HASH_FIND(hh, wb->pending, key, sz, e); // GCOVR_EXCL_BR_LINE
+    if (e == NULL) {
+        HASH_FIND(hh, wb->flushing, key, sz, e); // GCOVR_EXCL_BR_LINE
+    }
+    return e;
+}
+
+// free scan snapshot
+static void
+wb_scan_free(umdb_wbe_t *es, size_t nr)
+{
+    for (size_t i = 0; i < nr; i++) {
+        free(es[i].key);
+        free(es[i].v);
+    }
+    free(es);
+}
+
+// scan entry order (data key)
+static int
+wb_scan_cmp(const void *a, const void *b)
+{
+    return strcmp(((const umdb_wbe_t *)a)->key, ((const umdb_wbe_t *)b)->key);
+}
+
+// add copy of overlay entry to scan snapshot if it matches
+// storage and prefix (overlay lock held)
+static int
+wb_scan_add(umdb_wbe_t *e,
+            const char *db,
+            const char *p,
+            umdb_wbe_t *out,
+            size_t *nr)
+{
+    size_t db_sz = strlen(db);
+    if (e->key_sz <= db_sz || memcmp(e->key, db, db_sz + 1) != 0) {
+        return 0;
+    }
+    const char *k = e->key + db_sz + 1;
+    if (strncmp(k, p, strlen(p)) != 0) {
+        return 0;
+    }
+    umdb_wbe_t *se = &out[*nr];
+    se->key = strdup(k);
+    se->v = e->v != NULL ? strdup(e->v) : NULL;
+    if (se->key == NULL || (e->v != NULL && se->v == NULL)) {
+        free(se->key);
+        free(se->v);
+        return 1;
+    }
+    ++*nr;
+    return 0;
+}
+
+// ordered snapshot of overlay entries (pending before
+// flushing) matching storage and prefix; data keys are
+// copied to entry keys (overlay lock held)
+static int
+wb_scan(umdb_wb_t *wb,
+        const char *db,
+        const char *p,
+        umdb_wbe_t **out,
+        size_t *nr)
+{
+    *out = NULL;
+    *nr = 0;
+    size_t sz = HASH_COUNT(wb->pending) + HASH_COUNT(wb->flushing);
+    if (sz == 0) {
+        return 0;
+    }
+    umdb_wbe_t *res = calloc(sz, sizeof(umdb_wbe_t));
+    if (res == NULL) {
+        return 1;
+    }
+    int r = 0;
+    umdb_wbe_t *e;
+    umdb_wbe_t *tmp;
+    HASH_ITER(hh, wb->pending, e, tmp) {
+        if (r == 0) {
+            r = wb_scan_add(e, db, p, res, nr);
+        }
+    }
+    HASH_ITER(hh, wb->flushing, e, tmp) {
+        umdb_wbe_t *pe = NULL;
+        // GCOVR_EXCL_BR_START
+        HASH_FIND(hh, wb->pending, e->key, e->key_sz, pe);
+        // GCOVR_EXCL_BR_STOP
+        if (r == 0 && pe == NULL) {
+            r = wb_scan_add(e, db, p, res, nr);
+        }
+    }
+    if (r != 0) {
+        wb_scan_free(res, *nr);
+        *nr = 0;
+        return 1;
+    }
+    qsort(res, *nr, sizeof(umdb_wbe_t), &wb_scan_cmp);
+    *out = res;
+    return 0;
+}
+
+// current value (overlay or DB) for read-modify-set;
+// missing value is NULL (overlay lock held)
+static int
+wb_current(umdb_mngrd_t *m, const char *db, const char *k, char **out)
+{
+    *out = NULL;
+    umdb_wbe_t *e = wb_get(m->wb, db, k);
+    if (e != NULL) {
+        // pending delete is missing value
+        if (e->v != NULL) {
+            *out = strdup(e->v);
+        }
+        return 0;
+    }
+    size_t sz = 0;
+    int r = store_get(m, db, k, out, &sz);
+    if (r == 8) {
+        // empty value
+        if (sz > 0) {
+            free(*out);
+        }
+        *out = NULL;
+        r = 0;
+    }
+    return r;
+}
+
+// wake up commit thread if batch is full (overlay lock
+// held); returns number of pending writes
+static unsigned int
+wb_notify(umdb_wb_t *wb)
+{
+    unsigned int nr = HASH_COUNT(wb->pending);
+    if (nr >= wb->batch) {
+        pthread_cond_signal(&wb->cond);
+    }
+    return nr;
+}
+
+/***************/
+/* key watches */
+/***************/
+// next watch matching storage key
+static const umdb_watch_t *
+watch_next(const umdb_watch_t *w, const char *db, const char *k)
+{
+    for (; w != NULL; w = w->next) {
+        if (strcmp(w->db, db) != 0) {
+            continue;
+        }
+        if (w->prefix ? strncmp(k, w->key, w->key_sz) == 0 :
+                        strcmp(k, w->key) == 0) {
+            return w;
+        }
+    }
+    return NULL;
+}
+
+// key is watched
+static bool
+watch_match(umdb_mngrd_t *m, const char *db, const char *k)
+{
+    const umdb_watch_t *w = __atomic_load_n(&m->watches, __ATOMIC_ACQUIRE);
+    return w != NULL && watch_next(w, db, k) != NULL;
+}
+
+// old value of watched key (cache lock held, or overlay lock
+// in write-behind mode); false if key is not watched
+static bool
+watch_old(umdb_mngrd_t *m, const char *db, const char *k, char **old)
+{
+    *old = NULL;
+    if (!watch_match(m, db, k)) {
+        return false;
+    }
+    if (m->wb != NULL) {
+        wb_current(m, db, k, old);
+    } else {
+        *old = store_peek(m, db, k);
+    }
+    return true;
+}
+
+// notify watches about changed value (NULL = missing)
+static void
+watch_notify(umdb_mngrd_t *m,
+             const char *db,
+             const char *k,
+             const char *old,
+             const char *v)
+{
+    // unchanged
+    if (old == v || (old != NULL && v != NULL && strcmp(old, v) == 0)) {
+        return;
+    }
+    const umdb_watch_t *w = __atomic_load_n(&m->watches, __ATOMIC_ACQUIRE);
+    while ((w = watch_next(w, db, k)) != NULL) {
+        w->cb(w, k, old, v);
+        w = w->next;
+    }
+}
+
+int
+umdb_mngr_watch(umdb_mngrd_t *m,
+                const char *db,
+                const char *k,
+                const char *name,
+                umdb_watch_cb_t cb,
+                void *arg)
+{
+    // sanity check
+    if (m == NULL || db == NULL || k == NULL || name == NULL || cb == NULL) {
+        return 1;
+    }
+    size_t k_sz = strlen(k);
+    bool prefix = k_sz > 0 && k[k_sz - 1] == '*';
+    if (prefix) {
+        --k_sz;
     }
+
+    // already registered (registration is serialized)
+    pthread_mutex_lock(&m->mtx);
+    for (umdb_watch_t *w = m->watches; w != NULL; w = w->next) {
+        if (w->prefix == prefix && w->key_sz == k_sz &&
+            strncmp(w->key, k, k_sz) == 0 && strcmp(w->db, db) == 0 &&
+            strcmp(w->name, name) == 0 && w->cb == cb && w->arg == arg) {
+            pthread_mutex_unlock(&m->mtx);
+            return 0;
+        }
+    }
+
+    // new watch
+    umdb_watch_t *w = calloc(1, sizeof(umdb_watch_t));
+    if (w == NULL) {
+        pthread_mutex_unlock(&m->mtx);
+        return 2;
+    }
+    w->db = strdup(db);
+    w->key = strndup(k, k_sz);
+    w->name = strdup(name);
+    if (w->db == NULL || w->key == NULL || w->name == NULL) {
+        free(w->db);
+        free(w->key);
+        free(w->name);
+        free(w);
+        pthread_mutex_unlock(&m->mtx);
+        return 2;
+    }
+    w->key_sz = k_sz;
+    w->prefix = prefix;
+    w->cb = cb;
+    w->arg = arg;
+    w->next = m->watches;
+    // publish initialized watch (readers are not locked)
+    __atomic_store_n(&m->watches, w, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&m->mtx);
+
     return 0;
 }
 
+int
+umdb_mngr_wb_flush(umdb_mngrd_t *m)
+{
+    if (m == NULL || m->wb == NULL) {
+        return 1;
+    }
+    umdb_wb_t *wb = m->wb;
+
+    // take pending batch (readers still see it)
+    pthread_mutex_lock(&wb->flush_mtx);
+    pthread_mutex_lock(&wb->mtx);
+    umdb_wbe_t *batch = wb->pending;
+    wb->pending = NULL;
+    wb->flushing = batch;
+    pthread_mutex_unlock(&wb->mtx);
+    if (batch == NULL) {
+        pthread_mutex_unlock(&wb->flush_mtx);
+        return 0;
+    }
+
+    // one transaction per batch
+    int res = 0;
+    pthread_mutex_lock(&m->mtx);
+    if (sqlite3_exec(m->db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+        res = 2;
+    }
+    umdb_wbe_t *e;
+    umdb_wbe_t *tmp;
+    HASH_ITER(hh, batch, e, tmp)
+    {
+        if (res != 0) {
+            break;
+        }
+        // sets to removed storages (statement cannot be
+        // prepared) are dropped, other errors (e.g. busy DB)
+        // roll back the batch
+        const char *k = e->key + strlen(e->key) + 1;
+        int r = e->v != NULL ? store_set(m, e->key, k, e->v) :
+                               store_del(m, e->key, k);
+        if (r != 0 && r != 2) {
+            res = 3;
+        }
+    }
+    if (res == 0 && sqlite3_exec(m->db, "COMMIT", NULL, NULL, NULL)) {
+        res = 4;
+    }
+    if (res != 0) {
+        sqlite3_exec(m->db, "ROLLBACK", NULL, NULL, NULL);
+    }
+    pthread_mutex_unlock(&m->mtx);
+
+    // release batch (failed batch is queued again, unless
+    // replaced by newer sets)
+    pthread_mutex_lock(&wb->mtx);
+    HASH_ITER(hh, batch, e, tmp)
+    {
+        HASH_DEL(batch, e); // GCOVR_EXCL_BR_LINE
+        umdb_wbe_t *n = NULL;
+        if (res != 0) {
+            // GCOVR_EXCL_BR_START
+            HASH_FIND(hh, wb->pending, e->key, e->key_sz, n);
+            // GCOVR_EXCL_BR_STOP
+        }
+        if (res != 0 && n == NULL) {
+            // GCOVR_EXCL_BR_START
+            HASH_ADD_KEYPTR(hh, wb->pending, e->key, e->key_sz, e);
+            // GCOVR_EXCL_BR_STOP
+        } else {
+            wbe_free(e);
+        }
+    }
+    wb->flushing = NULL;
+    pthread_mutex_unlock(&wb->mtx);
+    pthread_mutex_unlock(&wb->flush_mtx);
+
+    return res;
+}
+
+static void *
+th_wb(void *arg)
+{
+    umdb_mngrd_t *m = arg;
+    umdb_wb_t *wb = m->wb;
+    pthread_mutex_lock(&wb->mtx);
+    while (!wb->stop) {
+        // wait for interval or full batch
+        if (HASH_COUNT(wb->pending) < wb->batch) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += wb->interval / 1000;
+            ts.tv_nsec += (long)(wb->interval % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            int r = 0;
+            while (!wb->stop && r != ETIMEDOUT &&
+                   HASH_COUNT(wb->pending) < wb->batch) {
+                r = pthread_cond_timedwait(&wb->cond, &wb->mtx, &ts);
+            }
+        }
+        pthread_mutex_unlock(&wb->mtx);
+        umdb_mngr_wb_flush(m);
+        pthread_mutex_lock(&wb->mtx);
+    }
+    pthread_mutex_unlock(&wb->mtx);
+    return NULL;
+}
+
+// stop commit thread and commit remaining sets
+static void
+wb_stop(umdb_mngrd_t *m)
+{
+    umdb_wb_t *wb = m->wb;
+    if (wb == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&wb->mtx);
+    wb->stop = 1;
+    pthread_cond_signal(&wb->cond);
+    pthread_mutex_unlock(&wb->mtx);
+    pthread_join(wb->th, NULL);
+    umdb_mngr_wb_flush(m);
+
+    // uncommitted (failed) sets
+    umdb_wbe_t *e;
+    umdb_wbe_t *tmp;
+    HASH_ITER(hh, wb->pending, e, tmp)
+    {
+        HASH_DEL(wb->pending, e); // GCOVR_EXCL_BR_LINE
+        wbe_free(e);
+    }
+    pthread_cond_destroy(&wb->cond);
+    pthread_mutex_destroy(&wb->flush_mtx);
+    pthread_mutex_destroy(&wb->mtx);
+    free(wb);
+    m->wb = NULL;
+}
+
+int
+umdb_mngr_wb_start(umdb_mngrd_t *m, int interval, unsigned int batch)
+{
+    if (m == NULL || m->wb != NULL) {
+        return 1;
+    }
+    umdb_wb_t *wb = calloc(1, sizeof(umdb_wb_t));
+    if (wb == NULL) {
+        return 2;
+    }
+    wb->interval = interval > 0 ? interval : UMDB_WB_INTERVAL;
+    wb->batch = batch > 0 ? batch : UMDB_WB_BATCH;
+    pthread_mutex_init(&wb->mtx, NULL);
+    pthread_mutex_init(&wb->flush_mtx, NULL);
+    pthread_cond_init(&wb->cond, NULL);
+    m->wb = wb;
+
+    // commit thread
+    if (pthread_create(&wb->th, NULL, &th_wb, m) != 0) {
+        m->wb = NULL;
+        pthread_cond_destroy(&wb->cond);
+        pthread_mutex_destroy(&wb->flush_mtx);
+        pthread_mutex_destroy(&wb->mtx);
+        free(wb);
+        return 3;
+    }
+    return 0;
+}
+
+int
+umdb_mngr_wal(umdb_mngrd_t *m)
+{
+    if (m == NULL || m->db == NULL) {
+        return 1;
+    }
+    // journal mode (result row contains the new mode)
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(m->db,
+                           "PRAGMA journal_mode=WAL",
+                           -1,
+                           &stmt,
+                           NULL) != SQLITE_OK) {
+        return 2;
+    }
+    int r = 3;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *mode = (const char *)sqlite3_column_text(stmt, 0);
+        r = (mode != NULL && strcmp(mode, "wal") == 0) ? 0 : 3;
+    }
+    sqlite3_finalize(stmt);
+    if (r != 0) {
+        return r;
+    }
+
+    // WAL is durable across crashes with NORMAL sync
+    if (sqlite3_exec(m->db, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL)) {
+        return 4;
+    }
+    return 0;
+}
+
+int
+umdb_mngr_store_set(umdb_mngrd_t *m,
+                    const char *db,
+                    const char *k,
+                    const char *v)
+{
+    // sanity check
+    if (m == NULL || db == NULL || k == NULL || v == NULL) {
+        return 1;
+    }
+
+    // write-behind (overlay)
+    umdb_wb_t *wb = m->wb;
+    char *old = NULL;
+    if (wb != NULL) {
+        pthread_mutex_lock(&wb->mtx);
+        bool wtc = watch_old(m, db, k, &old);
+        int r = wb_put(wb, db, k, v);
+        if (r == 0 && wtc) {
+            watch_notify(m, db, k, old, v);
+        }
+        unsigned int nr = wb_notify(wb);
+        pthread_mutex_unlock(&wb->mtx);
+        free(old);
+        // commit thread is behind (limit pending writes)
+        if (nr >= wb->batch * UMDB_WB_LIMIT) {
+            umdb_mngr_wb_flush(m);
+        }
+        return r == 0 ? 0 : 10;
+    }
+
+    pthread_mutex_lock(&m->mtx);
+    bool wtc = watch_old(m, db, k, &old);
+    int r = store_set(m, db, k, v);
+    if (r == 0 && wtc) {
+        watch_notify(m, db, k, old, v);
+    }
+    pthread_mutex_unlock(&m->mtx);
+    free(old);
+
+    return r;
+}
+
 int
 umdb_mngr_store_get(umdb_mngrd_t *m,
                     const char *db,
@@ -266,45 +1363,482 @@ umdb_mngr_store_get(umdb_mngrd_t *m,
         return 2;
     }
 
-    // prepare query
-    size_t sz = snprintf(NULL, 0, SQL_STORAGE_GET, db);
-    char s[sz + 1];
-    snprintf(s, sz + 1, SQL_STORAGE_GET, db);
+    // write-behind overlay (newer than DB)
+    if (m->wb != NULL) {
+        pthread_mutex_lock(&m->wb->mtx);
+        umdb_wbe_t *we = wb_get(m->wb, db, k);
+        int r = 0;
+        if (we != NULL && we->v != NULL) {
+            *out = strdup(we->v);
+            *out_sz = strlen(we->v) + 1;
+        } else if (we != NULL) {
+            // pending delete
+            *out_sz = 0;
+            r = 8;
+        }
+        pthread_mutex_unlock(&m->wb->mtx);
+        if (we != NULL) {
+            return r;
+        }
+    }
 
-    // prepare statement
-    sqlite3_stmt *stmt = NULL;
-    int r = sqlite3_prepare_v2(m->db, s, -1, &stmt, NULL);
-    if (r != SQLITE_OK) {
+    return store_get(m, db, k, out, out_sz);
+}
+
+int
+umdb_mngr_store_mget(umdb_mngrd_t *m,
+                     const char *db,
+                     const char **keys,
+                     size_t nr,
+                     umdb_kv_cb_t cb,
+                     void *arg)
+{
+    // sanity check
+    if (m == NULL || db == NULL || keys == NULL || cb == NULL) {
+        return 1;
+    }
+    if (nr == 0) {
+        return 0;
+    }
+    // keys found in write-behind overlay
+    bool *done = calloc(nr, sizeof(bool));
+    if (done == NULL) {
+        return 2;
+    }
+
+    // write-behind overlay (newer than DB)
+    size_t left = nr;
+    if (m->wb != NULL) {
+        pthread_mutex_lock(&m->wb->mtx);
+        for (size_t i = 0; i < nr; i++) {
+            umdb_wbe_t *we = keys[i] != NULL ? wb_get(m->wb, db, keys[i]) :
+                                               NULL;
+            if (we == NULL) {
+                continue;
+            }
+            // pending delete is skipped
+            if (we->v != NULL) {
+                cb(keys[i], we->v, arg);
+            }
+            done[i] = true;
+            --left;
+        }
+        pthread_mutex_unlock(&m->wb->mtx);
+    }
+    if (left == 0) {
+        free(done);
+        return 0;
+    }
+
+    // prepared statement (read connection)
+    sqlite3 *rdb = NULL;
+    umdb_stmt_t **stmts = NULL;
+    umdb_conn_t *c = rd_begin(m, &rdb, &stmts);
+    umdb_stmt_t *e = stmt_get(rdb, stmts, STORE_GET, db);
+    if (e == NULL) {
+        // missing table (removed or never initialized)
+        rd_end(m, c, db);
+        free(done);
         return 3;
     }
+    sqlite3_stmt *stmt = e->stmt;
 
-    // key
-    if (sqlite3_bind_text(stmt, 1, k, strlen(k), SQLITE_STATIC)) {
-        return 4;
+    // one read transaction, statement is reused for each key
+    int r = 0;
+    bool busy = false;
+    if (sqlite3_exec(rdb, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+        r = 4;
+    }
+    for (size_t i = 0; r == 0 && i < nr; i++) {
+        if (done[i] || keys[i] == NULL) {
+            continue;
+        }
+        if (sqlite3_bind_text(stmt, 1, keys[i], -1, SQLITE_STATIC)) {
+            r = 5;
+            break;
+        }
+        int sr = rd_step(stmt);
+        if (sr == SQLITE_ROW) {
+            const char *v = (const char *)sqlite3_column_text(stmt, 0);
+            if (v != NULL) {
+                cb(keys[i], v, arg);
+            }
+        } else if (sr != SQLITE_DONE) {
+            r = 9;
+            busy = rd_busy(sr);
+        }
+        if (sqlite3_reset(stmt) != SQLITE_OK && r == 0) {
+            r = 9;
+        }
+    }
+    if (r != 4) {
+        sqlite3_exec(rdb, "COMMIT", NULL, NULL, NULL);
     }
 
-    // get value
-    r = 0;
-    *out_sz = 0;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        const unsigned char *v = sqlite3_column_text(stmt, 0);
-        r = strlen((const char *)v);
-        *out = strdup((const char *)v);
-        *out_sz = r + 1;
+    // cleanup (reset for reuse); table might have been removed
+    // (busy DB is an error, storage is kept)
+    int rr = stmt_put(stmts, e);
+    rd_end(m, c, (rr != 0 || r == 9) && !busy ? db : NULL);
+    free(done);
+    if (r == 0 && rr != 0) {
+        r = 6 + rr;
     }
+    return r;
+}
 
-    // cleanup
-    if (sqlite3_clear_bindings(stmt)) {
-        return 5;
+int
+umdb_mngr_store_mset(umdb_mngrd_t *m,
+                     const char *db,
+                     const char **keys,
+                     const char **values,
+                     size_t nr)
+{
+    // sanity check
+    if (m == NULL || db == NULL || keys == NULL || values == NULL) {
+        return 1;
     }
-    if (sqlite3_reset(stmt)) {
-        return 6;
+    for (size_t i = 0; i < nr; i++) {
+        if (keys[i] == NULL || values[i] == NULL) {
+            return 1;
+        }
     }
-    if (sqlite3_finalize(stmt)) {
-        return 7;
+    if (nr == 0) {
+        return 0;
     }
 
-    return (r > 0 ? 0 : 8);
+    // write-behind (one overlay update; the commit thread
+    // takes all pending sets at once, same transaction)
+    umdb_wb_t *wb = m->wb;
+    if (wb != NULL) {
+        int r = 0;
+        pthread_mutex_lock(&wb->mtx);
+        for (size_t i = 0; r == 0 && i < nr; i++) {
+            char *old = NULL;
+            bool wtc = watch_old(m, db, keys[i], &old);
+            r = wb_put(wb, db, keys[i], values[i]);
+            if (r == 0 && wtc) {
+                watch_notify(m, db, keys[i], old, values[i]);
+            }
+            free(old);
+        }
+        unsigned int pnr = wb_notify(wb);
+        pthread_mutex_unlock(&wb->mtx);
+        // commit thread is behind (limit pending writes)
+        if (pnr >= wb->batch * UMDB_WB_LIMIT) {
+            umdb_mngr_wb_flush(m);
+        }
+        return r == 0 ? 0 : 10;
+    }
+
+    // old values of watched keys (notified after commit)
+    char **olds = NULL;
+    bool *wtc = NULL;
+    if (__atomic_load_n(&m->watches, __ATOMIC_ACQUIRE) != NULL) {
+        olds = calloc(nr, sizeof(char *));
+        wtc = calloc(nr, sizeof(bool));
+        if (olds == NULL || wtc == NULL) {
+            free(olds);
+            free(wtc);
+            return 2;
+        }
+    }
+
+    // one transaction
+    int r = 0;
+    pthread_mutex_lock(&m->mtx);
+    if (sqlite3_exec(m->db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+        r = 11;
+    }
+    for (size_t i = 0; r == 0 && i < nr; i++) {
+        if (wtc != NULL) {
+            wtc[i] = watch_old(m, db, keys[i], &olds[i]);
+        }
+        r = store_set(m, db, keys[i], values[i]);
+    }
+    if (r == 0 && sqlite3_exec(m->db, "COMMIT", NULL, NULL, NULL)) {
+        r = 12;
+    }
+    if (r != 0 && r != 11) {
+        sqlite3_exec(m->db, "ROLLBACK", NULL, NULL, NULL);
+    }
+    for (size_t i = 0; wtc != NULL && i < nr; i++) {
+        if (r == 0 && wtc[i]) {
+            watch_notify(m, db, keys[i], olds[i], values[i]);
+        }
+        free(olds[i]);
+    }
+    pthread_mutex_unlock(&m->mtx);
+    free(olds);
+    free(wtc);
+
+    return r;
+}
+
+int
+umdb_mngr_store_scan(umdb_mngrd_t *m,
+                     const char *db,
+                     const char *p,
+                     int limit,
+                     umdb_kv_cb_t cb,
+                     void *arg)
+{
+    // sanity check
+    if (m == NULL || db == NULL || p == NULL || cb == NULL) {
+        return 1;
+    }
+
+    // write-behind overlay snapshot (newer than DB, merged
+    // with ordered rows)
+    umdb_wbe_t *ov = NULL;
+    size_t ov_nr = 0;
+    if (m->wb != NULL) {
+        pthread_mutex_lock(&m->wb->mtx);
+        int wr = wb_scan(m->wb, db, p, &ov, &ov_nr);
+        pthread_mutex_unlock(&m->wb->mtx);
+        if (wr != 0) {
+            return 2;
+        }
+    }
+
+    // prepared statement (read connection)
+    sqlite3 *rdb = NULL;
+    umdb_stmt_t **stmts = NULL;
+    umdb_conn_t *c = rd_begin(m, &rdb, &stmts);
+    umdb_stmt_t *e = stmt_get(rdb, stmts, STORE_SCAN, db);
+    if (e == NULL) {
+        // missing table (removed or never initialized)
+        rd_end(m, c, db);
+        wb_scan_free(ov, ov_nr);
+        return 3;
+    }
+    sqlite3_stmt *stmt = e->stmt;
+
+    // prefix and limit (negative = no limit); overlay entries
+    // can replace or hide rows, fetch enough rows to fill limit
+    int r = 0;
+    int dlimit = -1;
+    if (limit > 0 && (size_t)limit <= (size_t)INT_MAX - ov_nr) {
+        dlimit = limit + (int)ov_nr;
+    }
+    if (sqlite3_bind_text(stmt, 1, p, -1, SQLITE_STATIC)) {
+        r = 4;
+    } else if (sqlite3_bind_int(stmt, 2, dlimit)) {
+        r = 5;
+    }
+
+    // rows (read lock is taken by the first step, only that
+    // one can be retried); overlay entries are merged in key
+    // order, pending deletes are skipped
+    int sr = SQLITE_DONE;
+    if (r == 0) {
+        sr = rd_step(stmt);
+    }
+    size_t oi = 0;
+    int nr = 0;
+    for (; r == 0 && sr == SQLITE_ROW; sr = sqlite3_step(stmt)) {
+        const char *k = (const char *)sqlite3_column_text(stmt, 0);
+        const char *v = (const char *)sqlite3_column_text(stmt, 1);
+        if (k == NULL || v == NULL) {
+            continue;
+        }
+        // newer overlay entries first
+        int cr = 1;
+        for (; oi < ov_nr && (cr = strcmp(ov[oi].key, k)) <= 0; oi++) {
+            if (ov[oi].v != NULL && (limit <= 0 || nr < limit)) {
+                cb(ov[oi].key, ov[oi].v, arg);
+                ++nr;
+            }
+            if (cr == 0) {
+                break;
+            }
+        }
+        // row replaced or deleted by overlay
+        if (cr == 0) {
+            oi++;
+        } else if (limit <= 0 || nr < limit) {
+            cb(k, v, arg);
+            ++nr;
+        }
+        if (limit > 0 && nr >= limit) {
+            sr = SQLITE_DONE;
+            break;
+        }
+    }
+    if (r == 0 && sr != SQLITE_DONE) {
+        r = 9;
+    }
+    // remaining overlay entries (after last row)
+    for (; r == 0 && oi < ov_nr && (limit <= 0 || nr < limit); oi++) {
+        if (ov[oi].v != NULL) {
+            cb(ov[oi].key, ov[oi].v, arg);
+            ++nr;
+        }
+    }
+    wb_scan_free(ov, ov_nr);
+
+    // cleanup (reset for reuse); table might have been removed
+    // (busy DB is an error, storage is kept)
+    int rr = stmt_put(stmts, e);
+    rd_end(m, c, (rr != 0 || r == 9) && !rd_busy(sr) ? db : NULL);
+    if (r == 0 && rr != 0) {
+        r = 6 + rr;
+    }
+    return r;
+}
+
+int
+umdb_mngr_store_del(umdb_mngrd_t *m, const char *db, const char *k)
+{
+    // sanity check
+    if (m == NULL || db == NULL || k == NULL) {
+        return 1;
+    }
+
+    // write-behind (pending delete)
+    umdb_wb_t *wb = m->wb;
+    char *old = NULL;
+    if (wb != NULL) {
+        pthread_mutex_lock(&wb->mtx);
+        bool wtc = watch_old(m, db, k, &old);
+        int r = wb_put(wb, db, k, NULL);
+        if (r == 0 && wtc) {
+            watch_notify(m, db, k, old, NULL);
+        }
+        unsigned int nr = wb_notify(wb);
+        pthread_mutex_unlock(&wb->mtx);
+        free(old);
+        // commit thread is behind (limit pending writes)
+        if (nr >= wb->batch * UMDB_WB_LIMIT) {
+            umdb_mngr_wb_flush(m);
+        }
+        return r == 0 ? 0 : 10;
+    }
+
+    pthread_mutex_lock(&m->mtx);
+    bool wtc = watch_old(m, db, k, &old);
+    int r = store_del(m, db, k);
+    if (r == 0 && wtc) {
+        watch_notify(m, db, k, old, NULL);
+    }
+    pthread_mutex_unlock(&m->mtx);
+    free(old);
+
+    return r;
+}
+
+int
+umdb_mngr_store_incr(umdb_mngrd_t *m,
+                     const char *db,
+                     const char *k,
+                     int64_t delta,
+                     int64_t *out)
+{
+    // sanity check
+    if (m == NULL || db == NULL || k == NULL) {
+        return 1;
+    }
+
+    // write-behind (read and update overlay, atomic for
+    // other overlay writers)
+    umdb_wb_t *wb = m->wb;
+    if (wb != NULL) {
+        pthread_mutex_lock(&wb->mtx);
+        char *cur = NULL;
+        int r = wb_current(m, db, k, &cur);
+        if (r == 0) {
+            int64_t nv = cur != NULL ? strtoll(cur, NULL, 10) : 0;
+            // wraps on overflow
+            nv = (int64_t)((uint64_t)nv + (uint64_t)delta);
+            char b[24];
+            snprintf(b, sizeof(b), "%lld", (long long)nv);
+            r = wb_put(wb, db, k, b) == 0 ? 0 : 10;
+            if (r == 0 && watch_match(m, db, k)) {
+                watch_notify(m, db, k, cur, b);
+            }
+            if (r == 0 && out != NULL) {
+                *out = nv;
+            }
+        }
+        unsigned int nr = wb_notify(wb);
+        pthread_mutex_unlock(&wb->mtx);
+        free(cur);
+        // commit thread is behind (limit pending writes)
+        if (nr >= wb->batch * UMDB_WB_LIMIT) {
+            umdb_mngr_wb_flush(m);
+        }
+        return r;
+    }
+
+    pthread_mutex_lock(&m->mtx);
+    char *old = NULL;
+    bool wtc = watch_old(m, db, k, &old);
+    int64_t nv = 0;
+    int r = store_incr(m, db, k, delta, &nv);
+    if (r == 0 && wtc) {
+        char b[24];
+        snprintf(b, sizeof(b), "%lld", (long long)nv);
+        watch_notify(m, db, k, old, b);
+    }
+    pthread_mutex_unlock(&m->mtx);
+    free(old);
+    if (r == 0 && out != NULL) {
+        *out = nv;
+    }
+
+    return r;
+}
+
+int
+umdb_mngr_store_cas(umdb_mngrd_t *m,
+                    const char *db,
+                    const char *k,
+                    const char *old,
+                    const char *v)
+{
+    // sanity check
+    if (m == NULL || db == NULL || k == NULL || v == NULL) {
+        return 1;
+    }
+
+    // write-behind (read and update overlay, atomic for
+    // other overlay writers)
+    umdb_wb_t *wb = m->wb;
+    if (wb != NULL) {
+        pthread_mutex_lock(&wb->mtx);
+        char *cur = NULL;
+        int r = wb_current(m, db, k, &cur);
+        if (r == 0) {
+            bool match = old != NULL ? cur != NULL && strcmp(cur, old) == 0 :
+                                       cur == NULL;
+            if (!match) {
+                r = 8;
+            } else if (wb_put(wb, db, k, v) != 0) {
+                r = 10;
+            } else if (watch_match(m, db, k)) {
+                watch_notify(m, db, k, cur, v);
+            }
+        }
+        unsigned int nr = wb_notify(wb);
+        pthread_mutex_unlock(&wb->mtx);
+        free(cur);
+        // commit thread is behind (limit pending writes)
+        if (nr >= wb->batch * UMDB_WB_LIMIT) {
+            umdb_mngr_wb_flush(m);
+        }
+        return r;
+    }
+
+    pthread_mutex_lock(&m->mtx);
+    char *cur = NULL;
+    bool wtc = watch_old(m, db, k, &cur);
+    int r = store_cas(m, db, k, old, v);
+    if (r == 0 && wtc) {
+        watch_notify(m, db, k, cur, v);
+    }
+    pthread_mutex_unlock(&m->mtx);
+    free(cur);
+
+    return r;
 }
 
 int
@@ -315,6 +1849,15 @@ umdb_mngr_store_init(umdb_mngrd_t *m, const char *name)
         return 1;
     }
 
+    // already initialized
+    umdb_store_t *st = NULL;
+    pthread_mutex_lock(&m->mtx);
+    HASH_FIND_STR(m->stores, name, st); // GCOVR_EXCL_BR_LINE
+    if (st != NULL) {
+        pthread_mutex_unlock(&m->mtx);
+        return 0;
+    }
+
     // prepare query (table names cannot be changed with bind methods )
     size_t sz = snprintf(NULL, 0, SQL_STORAGE_INIT, name);
     char s[sz + 1];
@@ -324,6 +1867,7 @@ umdb_mngr_store_init(umdb_mngrd_t *m, const char *name)
     sqlite3_stmt *stmt = NULL;
     int r = sqlite3_prepare_v2(m->db, s, -1, &stmt, NULL);
     if (r != SQLITE_OK) {
+        pthread_mutex_unlock(&m->mtx);
         return 2;
     }
 
@@ -331,18 +1875,28 @@ umdb_mngr_store_init(umdb_mngrd_t *m, const char *name)
     r = sqlite3_step(stmt);
 
     // cleanup
+    int res = 0;
     if (sqlite3_clear_bindings(stmt)) {
-        return 4;
+        res = 4;
+    } else if (sqlite3_reset(stmt)) {
+        res = 5;
     }
-    if (sqlite3_reset(stmt)) {
-        return 5;
+    if (sqlite3_finalize(stmt) && res == 0) {
+        res = 6;
     }
-    if (sqlite3_finalize(stmt)) {
-        return 6;
+    if (res == 0 && r != SQLITE_DONE) {
+        res = 7;
     }
 
-    if (r != SQLITE_DONE){
-        return 7;
+    // remember storage
+    if (res == 0) {
+        st = malloc(sizeof(umdb_store_t));
+        st->name = strdup(name);
+        // GCOVR_EXCL_BR_START
+        HASH_ADD_KEYPTR(hh, m->stores, st->name, strlen(st->name), st);
+        // GCOVR_EXCL_BR_STOP
     }
-    return 0;
+    pthread_mutex_unlock(&m->mtx);
+
+    return res;
 }
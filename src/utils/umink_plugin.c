@@ -14,6 +14,10 @@
 #include <dlfcn.h>
 #include <stdio.h>
 #include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <json_object.h>
+#include <json_tokener.h>
 
 #ifdef UNIT_TESTING
 #include <cmocka_tests.h>
@@ -158,14 +162,18 @@ umplg_reg_signal(umplg_mngr_t *pm, umplg_sh_t *sh)
     return 0;
 }
 
-int
-umplg_proc_signal(umplg_mngr_t *pm,
-                  const char *s,
-                  umplg_data_std_t *d_in,
-                  char **d_out,
-                  size_t *out_sz,
-                  int usr_flags,
-                  void *args)
+// auth context of the signal running in this thread
+static __thread const umplg_auth_t *cur_auth = NULL;
+
+static int
+proc_signal(umplg_mngr_t *pm,
+            const char *s,
+            umplg_data_std_t *d_in,
+            char **d_out,
+            size_t *out_sz,
+            int usr_flags,
+            const umplg_auth_t *auth,
+            void *args)
 {
     // signal missing
     if (s == NULL) {
@@ -183,8 +191,175 @@ umplg_proc_signal(umplg_mngr_t *pm,
         return UMPLG_RES_AUTH_ERROR;
     }
 
+    // set auth context (restored for nested signals)
+    const umplg_auth_t *prev_auth = cur_auth;
+    cur_auth = auth;
+
     // run
-    return tmp_shd->run(tmp_shd, d_in, d_out, out_sz, args);
+    int r = tmp_shd->run(tmp_shd, d_in, d_out, out_sz, args);
+    cur_auth = prev_auth;
+    return r;
+}
+
+int
+umplg_proc_signal(umplg_mngr_t *pm,
+                  const char *s,
+                  umplg_data_std_t *d_in,
+                  char **d_out,
+                  size_t *out_sz,
+                  int usr_flags,
+                  void *args)
+{
+    return proc_signal(pm, s, d_in, d_out, out_sz, usr_flags, NULL, args);
+}
+
+int
+umplg_proc_signal_auth(umplg_mngr_t *pm,
+                       const char *s,
+                       umplg_data_std_t *d_in,
+                       char **d_out,
+                       size_t *out_sz,
+                       const umplg_auth_t *auth,
+                       void *args)
+{
+    // no user
+    if (auth == NULL) {
+        return proc_signal(pm, s, d_in, d_out, out_sz, 0, NULL, args);
+    }
+    // expired
+    if (auth->exp > 0 && auth->exp < time(NULL)) {
+        return UMPLG_RES_AUTH_ERROR;
+    }
+    return proc_signal(pm, s, d_in, d_out, out_sz, auth->flags, auth, args);
+}
+
+const umplg_auth_t *
+umplg_auth_current(void)
+{
+    return cur_auth;
+}
+
+// auth context cache (bounded, keyed by auth string)
+#define UMPLG_AUTH_CACHE_MAX 256
+
+struct umplg_auth_cd {
+    // auth string (JSON)
+    char *key;
+    // parsed auth context
+    umplg_auth_t auth;
+    // hashable
+    UT_hash_handle hh;
+};
+
+static struct umplg_auth_cd *auth_cache = NULL;
+static pthread_rwlock_t auth_cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// free cached auth contexts (cache lock held)
+static void
+auth_cache_free(void)
+{
+    struct umplg_auth_cd *ac = NULL;
+    struct umplg_auth_cd *tmp = NULL;
+    HASH_ITER(hh, auth_cache, ac, tmp)
+    {
+        HASH_DEL(auth_cache, ac); // GCOVR_EXCL_BR_LINE
+        free(ac->key);
+        free(ac);
+    }
+}
+
+// parse auth JSON ({"uid": 1, "flags": 1, "username": "admin", "exp": 0})
+static void
+auth_parse(const char *s, umplg_auth_t *a)
+{
+    memset(a, 0, sizeof(umplg_auth_t));
+    a->uid = -1;
+    json_object *j = json_tokener_parse(s);
+    if (j == NULL) {
+        return;
+    }
+    json_object *jv = json_object_object_get(j, "flags");
+    a->flags = json_object_get_int(jv);
+    jv = json_object_object_get(j, "uid");
+    if (jv == NULL) {
+        jv = json_object_object_get(j, "id");
+    }
+    if (jv != NULL) {
+        a->uid = json_object_get_int(jv);
+    }
+    jv = json_object_object_get(j, "username");
+    if (jv != NULL && json_object_is_type(jv, json_type_string)) {
+        snprintf(a->usr, sizeof(a->usr), "%s", json_object_get_string(jv));
+    }
+    jv = json_object_object_get(j, "exp");
+    a->exp = json_object_get_int64(jv);
+    json_object_put(j);
+}
+
+int
+umplg_auth_get(const char *s, umplg_auth_t *out)
+{
+    if (s == NULL || out == NULL) {
+        return 1;
+    }
+    // cached
+    struct umplg_auth_cd *ac = NULL;
+    pthread_rwlock_rdlock(&auth_cache_lock);
+    HASH_FIND_STR(auth_cache, s, ac); // GCOVR_EXCL_BR_LINE
+    if (ac != NULL) {
+        *out = ac->auth;
+    }
+    pthread_rwlock_unlock(&auth_cache_lock);
+    if (ac != NULL) {
+        return 0;
+    }
+
+    // parse and cache
+    auth_parse(s, out);
+    ac = malloc(sizeof(struct umplg_auth_cd));
+    if (ac == NULL) {
+        return 0;
+    }
+    ac->key = strdup(s);
+    if (ac->key == NULL) {
+        free(ac);
+        return 0;
+    }
+    ac->auth = *out;
+    pthread_rwlock_wrlock(&auth_cache_lock);
+    struct umplg_auth_cd *tmp = NULL;
+    HASH_FIND_STR(auth_cache, s, tmp); // GCOVR_EXCL_BR_LINE
+    // cached by another thread
+    if (tmp != NULL) {
+        pthread_rwlock_unlock(&auth_cache_lock);
+        free(ac->key);
+        free(ac);
+        return 0;
+    }
+    // bounded cache; start over when full
+    if (HASH_COUNT(auth_cache) >= UMPLG_AUTH_CACHE_MAX) {
+        auth_cache_free();
+    }
+    // GCOVR_EXCL_BR_START
+    HASH_ADD_KEYPTR(hh, auth_cache, ac->key, strlen(ac->key), ac);
+    // GCOVR_EXCL_BR_STOP
+    pthread_rwlock_unlock(&auth_cache_lock);
+    return 0;
+}
+
+void
+umplg_auth_clear(void)
+{
+    pthread_rwlock_wrlock(&auth_cache_lock);
+    auth_cache_free();
+    pthread_rwlock_unlock(&auth_cache_lock);
+}
+
+// cache is process wide (shared by managers), freed on unload
+static void __attribute__((destructor))
+auth_cache_fini(void)
+{
+    umplg_auth_clear();
 }
 
 void
@@ -0,0 +1,786 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <umkv.h>
+
+#ifdef UNIT_TESTING
+#include <cmocka_tests.h>
+#endif
+
+// composite key stack buffer size
+#define UMKV_KEY_BUFF_SZ 256
+// integer value buffer size (incr)
+#define UMKV_INT_BUFF_SZ 24
+
+/*****************/
+/* composite key */
+/*****************/
+// table names are NULL terminated strings, which makes
+// "table\0key" unambiguous even for binary keys
+static size_t
+umkv_key_sz(const char *tbl, size_t k_sz)
+{
+    return strlen(tbl) + 1 + k_sz;
+}
+
+static void
+umkv_key_fill(char *b, const char *tbl, const char *k, size_t k_sz)
+{
+    size_t tl = strlen(tbl) + 1;
+    memcpy(b, tbl, tl);
+    memcpy(b + tl, k, k_sz);
+}
+
+// get stripe for composite key; uthash selects buckets
+// with the low hash bits, stripe is selected with the high
+// bits (keys in a stripe would share a single bucket
+// otherwise)
+static umkv_stripe_t *
+umkv_stripe_get(umkv_t *kv, const char *key, size_t key_sz, unsigned *hashv)
+{
+    HASH_VALUE(key, key_sz, *hashv);
+    return &kv->stripes[(uint32_t)*hashv >> (32 - UMKV_STRIPES_BITS)];
+}
+
+umkv_t *
+umkv_new(void)
+{
+    umkv_t *kv = aligned_alloc(64, sizeof(umkv_t));
+    if (kv == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < UMKV_STRIPES; i++) {
+        kv->stripes[i].items = NULL;
+        pthread_rwlock_init(&kv->stripes[i].lock, NULL);
+    }
+    return kv;
+}
+
+void
+umkv_free(umkv_t *kv)
+{
+    if (kv == NULL) {
+        return;
+    }
+    for (int i = 0; i < UMKV_STRIPES; i++) {
+        umkv_stripe_t *s = &kv->stripes[i];
+        umkv_item_t *it = NULL;
+        umkv_item_t *tmp = NULL;
+        HASH_ITER(hh, s->items, it, tmp)
+        {
+            HASH_DEL(s->items, it);
+            free(it->key);
+            free(it->value);
+            free(it);
+        }
+        pthread_rwlock_destroy(&s->lock);
+    }
+    free(kv);
+}
+
+int
+umkv_set(umkv_t *kv,
+         const char *tbl,
+         const char *k,
+         size_t k_sz,
+         const char *v,
+         size_t v_sz)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || k == NULL || v == NULL) {
+        return 1;
+    }
+
+    // prepare new value outside of the lock
+    char *nv = malloc(v_sz + 1);
+    if (nv == NULL) {
+        return 2;
+    }
+    memcpy(nv, v, v_sz);
+    nv[v_sz] = '\0';
+
+    // composite key
+    size_t key_sz = umkv_key_sz(tbl, k_sz);
+    char *key = malloc(key_sz);
+    if (key == NULL) {
+        free(nv);
+        return 2;
+    }
+    umkv_key_fill(key, tbl, k, k_sz);
+
+    // find stripe
+    unsigned hashv;
+    umkv_stripe_t *s = umkv_stripe_get(kv, key, key_sz, &hashv);
+
+    // lock stripe
+    pthread_rwlock_wrlock(&s->lock);
+    umkv_item_t *it = NULL;
+    HASH_FIND_BYHASHVALUE(hh, s->items, key, key_sz, hashv, it);
+    // update existing item (swap value)
+    char *ov = NULL;
+    if (it != NULL) {
+        ov = it->value;
+        it->value = nv;
+        it->value_sz = v_sz;
+
+    // new item
+    } else {
+        it = malloc(sizeof(umkv_item_t));
+        if (it == NULL) {
+            pthread_rwlock_unlock(&s->lock);
+            free(key);
+            free(nv);
+            return 2;
+        }
+        it->key = key;
+        it->key_sz = key_sz;
+        it->value = nv;
+        it->value_sz = v_sz;
+        // key is now owned by the item
+        key = NULL;
+        HASH_ADD_KEYPTR_BYHASHVALUE(hh, s->items, it->key, key_sz, hashv, it);
+    }
+    // unlock stripe
+    pthread_rwlock_unlock(&s->lock);
+
+    // cleanup
+    free(key);
+    free(ov);
+    return 0;
+}
+
+int
+umkv_get(umkv_t *kv,
+         const char *tbl,
+         const char *k,
+         size_t k_sz,
+         char **out,
+         size_t *out_sz)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || k == NULL || out == NULL ||
+        out_sz == NULL) {
+        return 1;
+    }
+
+    // composite key (stack for common sizes)
+    char kb[UMKV_KEY_BUFF_SZ];
+    size_t key_sz = umkv_key_sz(tbl, k_sz);
+    char *key = (key_sz <= sizeof(kb) ? kb : malloc(key_sz));
+    if (key == NULL) {
+        return 2;
+    }
+    umkv_key_fill(key, tbl, k, k_sz);
+
+    // find stripe
+    unsigned hashv;
+    umkv_stripe_t *s = umkv_stripe_get(kv, key, key_sz, &hashv);
+
+    // lock stripe (shared)
+    int r = 3;
+    *out_sz = 0;
+    pthread_rwlock_rdlock(&s->lock);
+    umkv_item_t *it = NULL;
+    HASH_FIND_BYHASHVALUE(hh, s->items, key, key_sz, hashv, it);
+    if (it != NULL) {
+        // copy value (terminator included)
+        *out = malloc(it->value_sz + 1);
+        if (*out != NULL) {
+            memcpy(*out, it->value, it->value_sz + 1);
+            *out_sz = it->value_sz;
+            r = 0;
+        } else {
+            r = 2;
+        }
+    }
+    // unlock stripe
+    pthread_rwlock_unlock(&s->lock);
+
+    // cleanup
+    if (key != kb) {
+        free(key);
+    }
+    return r;
+}
+
+int
+umkv_del(umkv_t *kv, const char *tbl, const char *k, size_t k_sz)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || k == NULL) {
+        return 1;
+    }
+
+    // composite key (stack for common sizes)
+    char kb[UMKV_KEY_BUFF_SZ];
+    size_t key_sz = umkv_key_sz(tbl, k_sz);
+    char *key = (key_sz <= sizeof(kb) ? kb : malloc(key_sz));
+    if (key == NULL) {
+        return 2;
+    }
+    umkv_key_fill(key, tbl, k, k_sz);
+
+    // find stripe
+    unsigned hashv;
+    umkv_stripe_t *s = umkv_stripe_get(kv, key, key_sz, &hashv);
+
+    // lock stripe
+    pthread_rwlock_wrlock(&s->lock);
+    umkv_item_t *it = NULL;
+    HASH_FIND_BYHASHVALUE(hh, s->items, key, key_sz, hashv, it);
+    if (it != NULL) {
+        HASH_DELETE(hh, s->items, it);
+    }
+    // unlock stripe
+    pthread_rwlock_unlock(&s->lock);
+
+    // cleanup
+    if (key != kb) {
+        free(key);
+    }
+    if (it == NULL) {
+        return 3;
+    }
+    free(it->key);
+    free(it->value);
+    free(it);
+    return 0;
+}
+
+/*******************/
+/* multi-key batch */
+/*******************/
+// resolved composite key
+typedef struct {
+    char *key;
+    size_t key_sz;
+    unsigned hashv;
+    umkv_stripe_t *s;
+} umkv_ref_t;
+
+static void
+umkv_refs_free(umkv_ref_t *refs, size_t nr)
+{
+    for (size_t i = 0; i < nr; i++) {
+        free(refs[i].key);
+    }
+    free(refs);
+}
+
+// composite keys and involved stripes
+static umkv_ref_t *
+umkv_refs_new(umkv_t *kv,
+              const char *tbl,
+              const char **keys,
+              const size_t *k_szs,
+              size_t nr,
+              bool *locks)
+{
+    umkv_ref_t *refs = calloc(nr, sizeof(umkv_ref_t));
+    if (refs == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < nr; i++) {
+        umkv_ref_t *r = &refs[i];
+        r->key_sz = umkv_key_sz(tbl, k_szs[i]);
+        r->key = malloc(r->key_sz);
+        if (r->key == NULL) {
+            umkv_refs_free(refs, i);
+            return NULL;
+        }
+        umkv_key_fill(r->key, tbl, keys[i], k_szs[i]);
+        r->s = umkv_stripe_get(kv, r->key, r->key_sz, &r->hashv);
+        locks[r->s - kv->stripes] = true;
+    }
+    return refs;
+}
+
+// copy of binary buffer ('\0' terminated)
+static char *
+umkv_dup(const char *b, size_t sz)
+{
+    char *c = malloc(sz + 1);
+    if (c != NULL) {
+        memcpy(c, b, sz);
+        c[sz] = '\0';
+    }
+    return c;
+}
+
+// copy item value (stripe lock held)
+static int
+umkv_value_copy(umkv_item_t *c, const umkv_item_t *it)
+{
+    c->value = umkv_dup(it->value, it->value_sz);
+    if (c->value == NULL) {
+        return 1;
+    }
+    c->value_sz = it->value_sz;
+    return 0;
+}
+
+// free copied items (multi-key results)
+static void
+umkv_copies_free(umkv_item_t *items, size_t nr)
+{
+    for (size_t i = 0; i < nr; i++) {
+        free(items[i].key);
+        free(items[i].value);
+    }
+    free(items);
+}
+
+// lock stripes in index order (no deadlocks between batches)
+static void
+umkv_lock_all(umkv_t *kv, const bool *locks, bool wr)
+{
+    for (int i = 0; i < UMKV_STRIPES; i++) {
+        if (locks == NULL || locks[i]) {
+            if (wr) {
+                pthread_rwlock_wrlock(&kv->stripes[i].lock);
+            } else {
+                pthread_rwlock_rdlock(&kv->stripes[i].lock);
+            }
+        }
+    }
+}
+
+static void
+umkv_unlock_all(umkv_t *kv, const bool *locks)
+{
+    for (int i = UMKV_STRIPES - 1; i >= 0; i--) {
+        if (locks == NULL || locks[i]) {
+            pthread_rwlock_unlock(&kv->stripes[i].lock);
+        }
+    }
+}
+
+int
+umkv_mget(umkv_t *kv,
+          const char *tbl,
+          const char **keys,
+          const size_t *k_szs,
+          size_t nr,
+          umkv_cb_t cb,
+          void *arg)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || keys == NULL || k_szs == NULL ||
+        cb == NULL) {
+        return 1;
+    }
+    if (nr == 0) {
+        return 0;
+    }
+
+    // composite keys
+    bool locks[UMKV_STRIPES] = { 0 };
+    umkv_ref_t *refs = umkv_refs_new(kv, tbl, keys, k_szs, nr, locks);
+    if (refs == NULL) {
+        return 2;
+    }
+
+    // values are copied, callback is called without locks
+    umkv_item_t *res = calloc(nr, sizeof(umkv_item_t));
+    if (res == NULL) {
+        umkv_refs_free(refs, nr);
+        return 2;
+    }
+
+    // lock stripes (shared)
+    int r = 0;
+    umkv_lock_all(kv, locks, false);
+    for (size_t i = 0; r == 0 && i < nr; i++) {
+        umkv_ref_t *rf = &refs[i];
+        umkv_item_t *it = NULL;
+        // GCOVR_EXCL_BR_START
+        HASH_FIND_BYHASHVALUE(hh,
+                              rf->s->items,
+                              rf->key,
+                              rf->key_sz,
+                              rf->hashv,
+                              it);
+        // GCOVR_EXCL_BR_STOP
+        if (it != NULL && umkv_value_copy(&res[i], it) != 0) {
+            r = 2;
+        }
+    }
+    // unlock stripes
+    umkv_unlock_all(kv, locks);
+
+    // results (missing keys are skipped)
+    for (size_t i = 0; r == 0 && i < nr; i++) {
+        if (res[i].value != NULL) {
+            cb(keys[i], k_szs[i], res[i].value, res[i].value_sz, arg);
+        }
+    }
+
+    // cleanup
+    umkv_copies_free(res, nr);
+    umkv_refs_free(refs, nr);
+    return r;
+}
+
+int
+umkv_mset(umkv_t *kv,
+          const char *tbl,
+          const char **keys,
+          const size_t *k_szs,
+          const char **values,
+          const size_t *v_szs,
+          size_t nr)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || keys == NULL || k_szs == NULL ||
+        values == NULL || v_szs == NULL) {
+        return 1;
+    }
+    if (nr == 0) {
+        return 0;
+    }
+
+    // composite keys
+    bool locks[UMKV_STRIPES] = { 0 };
+    umkv_ref_t *refs = umkv_refs_new(kv, tbl, keys, k_szs, nr, locks);
+    if (refs == NULL) {
+        return 2;
+    }
+
+    // prepare new items outside of the lock (new values are
+    // swapped with old ones, which are released later)
+    umkv_item_t **items = calloc(nr, sizeof(umkv_item_t *));
+    if (items == NULL) {
+        umkv_refs_free(refs, nr);
+        return 2;
+    }
+    for (size_t i = 0; i < nr; i++) {
+        items[i] = malloc(sizeof(umkv_item_t));
+        char *nv = malloc(v_szs[i] + 1);
+        if (items[i] == NULL || nv == NULL) {
+            free(nv);
+            free(items[i]);
+            for (size_t j = 0; j < i; j++) {
+                free(items[j]->value);
+                free(items[j]);
+            }
+            free(items);
+            umkv_refs_free(refs, nr);
+            return 2;
+        }
+        memcpy(nv, values[i], v_szs[i]);
+        nv[v_szs[i]] = '\0';
+        items[i]->value = nv;
+        items[i]->value_sz = v_szs[i];
+    }
+
+    // lock stripes
+    umkv_lock_all(kv, locks, true);
+    for (size_t i = 0; i < nr; i++) {
+        umkv_ref_t *r = &refs[i];
+        umkv_item_t *it = NULL;
+        // GCOVR_EXCL_BR_START
+        HASH_FIND_BYHASHVALUE(hh,
+                              r->s->items,
+                              r->key,
+                              r->key_sz,
+                              r->hashv,
+                              it);
+        // GCOVR_EXCL_BR_STOP
+        // update existing item (swap value)
+        if (it != NULL) {
+            char *ov = it->value;
+            size_t ov_sz = it->value_sz;
+            it->value = items[i]->value;
+            it->value_sz = items[i]->value_sz;
+            items[i]->value = ov;
+            items[i]->value_sz = ov_sz;
+
+        // new item (key is now owned by the item)
+        } else {
+            it = items[i];
+            items[i] = NULL;
+            it->key = r->key;
+            it->key_sz = r->key_sz;
+            r->key = NULL;
+            // GCOVR_EXCL_BR_START
+            HASH_ADD_KEYPTR_BYHASHVALUE(hh,
+                                        r->s->items,
+                                        it->key,
+                                        it->key_sz,
+                                        r->hashv,
+                                        it);
+            // GCOVR_EXCL_BR_STOP
+        }
+    }
+    // unlock stripes
+    umkv_unlock_all(kv, locks);
+
+    // cleanup (unused items and old values)
+    for (size_t i = 0; i < nr; i++) {
+        if (items[i] != NULL) {
+            free(items[i]->value);
+            free(items[i]);
+        }
+    }
+    free(items);
+    umkv_refs_free(refs, nr);
+    return 0;
+}
+
+int
+umkv_scan(umkv_t *kv,
+          const char *tbl,
+          const char *p,
+          size_t p_sz,
+          int limit,
+          umkv_cb_t cb,
+          void *arg)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || (p == NULL && p_sz > 0) || cb == NULL) {
+        return -1;
+    }
+
+    // composite prefix
+    size_t key_sz = umkv_key_sz(tbl, p_sz);
+    char *key = malloc(key_sz);
+    if (key == NULL) {
+        return -1;
+    }
+    umkv_key_fill(key, tbl, p != NULL ? p : "", p_sz);
+    size_t tl = key_sz - p_sz;
+
+    // lock all stripes (shared); matching items are copied,
+    // callback is called without locks
+    int res = 0;
+    size_t cap = 0;
+    umkv_item_t *items = NULL;
+    bool err = false;
+    umkv_lock_all(kv, NULL, false);
+    for (int i = 0; !err && i < UMKV_STRIPES; i++) {
+        umkv_item_t *it = NULL;
+        umkv_item_t *tmp = NULL;
+        HASH_ITER(hh, kv->stripes[i].items, it, tmp)
+        {
+            if (err || (limit > 0 && res >= limit)) {
+                break;
+            }
+            if (it->key_sz < key_sz || memcmp(it->key, key, key_sz) != 0) {
+                continue;
+            }
+            // grow results
+            if ((size_t)res == cap) {
+                size_t ncap = cap > 0 ? cap * 2 : 16;
+                umkv_item_t *n = realloc(items, ncap * sizeof(umkv_item_t));
+                if (n == NULL) {
+                    err = true;
+                    break;
+                }
+                items = n;
+                cap = ncap;
+            }
+            // data key and value
+            umkv_item_t *c = &items[res];
+            c->key_sz = it->key_sz - tl;
+            c->key = umkv_dup(it->key + tl, c->key_sz);
+            if (c->key == NULL || umkv_value_copy(c, it) != 0) {
+                free(c->key);
+                err = true;
+                break;
+            }
+            ++res;
+        }
+    }
+    // unlock stripes
+    umkv_unlock_all(kv, NULL);
+
+    // results
+    for (int i = 0; !err && i < res; i++) {
+        cb(items[i].key, items[i].key_sz, items[i].value, items[i].value_sz,
+           arg);
+    }
+
+    // cleanup
+    umkv_copies_free(items, res);
+    free(key);
+    return err ? -1 : res;
+}
+
+/*******************/
+/* read-modify-set */
+/*******************/
+// new item for missing key (composite key is owned by item)
+static umkv_item_t *
+umkv_item_new(const char *tbl, const char *k, size_t k_sz)
+{
+    umkv_item_t *it = malloc(sizeof(umkv_item_t));
+    if (it == NULL) {
+        return NULL;
+    }
+    it->key_sz = umkv_key_sz(tbl, k_sz);
+    it->key = malloc(it->key_sz);
+    if (it->key == NULL) {
+        free(it);
+        return NULL;
+    }
+    umkv_key_fill(it->key, tbl, k, k_sz);
+    it->value = NULL;
+    it->value_sz = 0;
+    return it;
+}
+
+static void
+umkv_item_free(umkv_item_t *it)
+{
+    if (it != NULL) {
+        free(it->key);
+        free(it->value);
+        free(it);
+    }
+}
+
+int
+umkv_incr(umkv_t *kv,
+          const char *tbl,
+          const char *k,
+          size_t k_sz,
+          int64_t delta,
+          int64_t *out)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || k == NULL) {
+        return 1;
+    }
+
+    // prepare new item and value outside of the lock
+    umkv_item_t *ni = umkv_item_new(tbl, k, k_sz);
+    char *nv = malloc(UMKV_INT_BUFF_SZ);
+    if (ni == NULL || nv == NULL) {
+        umkv_item_free(ni);
+        free(nv);
+        return 2;
+    }
+
+    // find stripe
+    unsigned hashv;
+    umkv_stripe_t *s = umkv_stripe_get(kv, ni->key, ni->key_sz, &hashv);
+
+    // lock stripe
+    pthread_rwlock_wrlock(&s->lock);
+    umkv_item_t *it = NULL;
+    // GCOVR_EXCL_BR_START
+    HASH_FIND_BYHASHVALUE(hh, s->items, ni->key, ni->key_sz, hashv, it);
+    // GCOVR_EXCL_BR_STOP
+    // new value (wraps on overflow)
+    int64_t cur = it != NULL ? strtoll(it->value, NULL, 10) : 0;
+    cur = (int64_t)((uint64_t)cur + (uint64_t)delta);
+    size_t nv_sz = snprintf(nv, UMKV_INT_BUFF_SZ, "%lld", (long long)cur);
+    // update existing item (swap value)
+    if (it != NULL) {
+        ni->value = it->value;
+        it->value = nv;
+        it->value_sz = nv_sz;
+
+    // new item
+    } else {
+        ni->value = nv;
+        ni->value_sz = nv_sz;
+        // GCOVR_EXCL_BR_START
+        HASH_ADD_KEYPTR_BYHASHVALUE(hh,
+                                    s->items,
+                                    ni->key,
+                                    ni->key_sz,
+                                    hashv,
+                                    ni);
+        // GCOVR_EXCL_BR_STOP
+        ni = NULL;
+    }
+    // unlock stripe
+    pthread_rwlock_unlock(&s->lock);
+
+    // cleanup (unused item, old value)
+    umkv_item_free(ni);
+    if (out != NULL) {
+        *out = cur;
+    }
+    return 0;
+}
+
+int
+umkv_cas(umkv_t *kv,
+         const char *tbl,
+         const char *k,
+         size_t k_sz,
+         const char *old,
+         size_t old_sz,
+         const char *v,
+         size_t v_sz)
+{
+    // sanity check
+    if (kv == NULL || tbl == NULL || k == NULL || v == NULL) {
+        return 1;
+    }
+
+    // prepare new item and value outside of the lock
+    umkv_item_t *ni = umkv_item_new(tbl, k, k_sz);
+    char *nv = malloc(v_sz + 1);
+    if (ni == NULL || nv == NULL) {
+        umkv_item_free(ni);
+        free(nv);
+        return 2;
+    }
+    memcpy(nv, v, v_sz);
+    nv[v_sz] = '\0';
+    ni->value = nv;
+    ni->value_sz = v_sz;
+
+    // find stripe
+    unsigned hashv;
+    umkv_stripe_t *s = umkv_stripe_get(kv, ni->key, ni->key_sz, &hashv);
+
+    // lock stripe
+    int r = 3;
+    pthread_rwlock_wrlock(&s->lock);
+    umkv_item_t *it = NULL;
+    // GCOVR_EXCL_BR_START
+    HASH_FIND_BYHASHVALUE(hh, s->items, ni->key, ni->key_sz, hashv, it);
+    // GCOVR_EXCL_BR_STOP
+    // missing key expected
+    if (old == NULL && it == NULL) {
+        // GCOVR_EXCL_BR_START
+        HASH_ADD_KEYPTR_BYHASHVALUE(hh,
+                                    s->items,
+                                    ni->key,
+                                    ni->key_sz,
+                                    hashv,
+                                    ni);
+        // GCOVR_EXCL_BR_STOP
+        ni = NULL;
+        r = 0;
+
+    // current value expected (swap value)
+    } else if (old != NULL && it != NULL && it->value_sz == old_sz &&
+               memcmp(it->value, old, old_sz) == 0) {
+        ni->value = it->value;
+        ni->value_sz = it->value_sz;
+        it->value = nv;
+        it->value_sz = v_sz;
+        r = 0;
+    }
+    // unlock stripe
+    pthread_rwlock_unlock(&s->lock);
+
+    // cleanup (unused item, old or unused value)
+    umkv_item_free(ni);
+    return r;
+}
@@ -16,7 +16,15 @@
 #include <cmocka.h>
 #include <cmocka_tests.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <umcounters.h>
+#include <umcshm.h>
+#include <umcexp.h>
+#include <umcpst.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 
 static void
 set_nullptr_counter(void **state)
@@ -533,6 +541,608 @@ counter_match(void **state)
     umc_free_ctx(umc);
 }
 
+// match callback creating new counters (context not locked)
+static void
+match_new_cb(umc_t *c, void *arg)
+{
+    umc_ctx_t *umc = arg;
+    char perf_id[UMC_NAME_MAX];
+    snprintf(perf_id, sizeof(perf_id), "idx.new.%s", c->idp);
+    assert_non_null(umc_new_counter(umc, perf_id, UMCT_GAUGE));
+}
+
+static void
+counter_index(void **state)
+{
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+
+    // indexed counters (index arrays grow)
+    char perf_id[UMC_NAME_MAX];
+    for (int i = 0; i < 100; i++) {
+        snprintf(perf_id, sizeof(perf_id), "idx.a.%d", i);
+        assert_non_null(umc_new_counter(umc, perf_id, UMCT_GAUGE));
+    }
+    assert_non_null(umc_new_counter(umc, "idx.b.0", UMCT_GAUGE));
+    assert_non_null(umc_new_counter(umc, "IDX.c", UMCT_GAUGE));
+    assert_non_null(umc_new_counter(umc, "idx", UMCT_GAUGE));
+    assert_non_null(umc_new_counter(umc, "other.a.0", UMCT_GAUGE));
+
+    // prefix patterns
+    umc_snap_t snap;
+    umc_snapshot(umc, &snap);
+    assert_int_equal(snap.nr, 104);
+    int cntr = 0;
+    assert_int_equal(umc_snap_match(&snap, "idx.a.*", &match_cb, &cntr), 100);
+    assert_int_equal(umc_snap_match(&snap, "IDX.A.1?", &match_cb, &cntr), 10);
+    assert_int_equal(umc_snap_match(&snap, "idx.*", &match_cb, &cntr), 102);
+    assert_int_equal(umc_snap_match(&snap, "idx.b.0", &match_cb, &cntr), 1);
+    assert_int_equal(umc_snap_match(&snap, "idx.d.*", &match_cb, &cntr), 0);
+    // no literal prefix (full scan)
+    assert_int_equal(umc_snap_match(&snap, "*.a.0", &match_cb, &cntr), 2);
+    assert_int_equal(umc_snap_match(&snap, "*", &match_cb, &cntr), 104);
+    assert_int_equal(cntr, 319);
+
+    // counters created after snapshot are not visible
+    assert_non_null(umc_new_counter(umc, "idx.a.new", UMCT_GAUGE));
+    assert_int_equal(umc_snap_match(&snap, "idx.a.*", &match_cb, &cntr), 100);
+    umc_snapshot(umc, &snap);
+    assert_int_equal(umc_snap_match(&snap, "idx.a.*", &match_cb, &cntr), 101);
+
+    // callbacks can create counters (context mutex not held)
+    cntr = 0;
+    umc_match(umc, "idx.b.*", true, &match_new_cb, umc);
+    umc_match(umc, "idx.new.*", true, &match_cb, &cntr);
+    assert_int_equal(cntr, 1);
+    assert_non_null(umc_get(umc, "idx.new.idx.b.0", true));
+
+    // free
+    umc_free_ctx(umc);
+}
+
+// sharded counter writer
+static void *
+sharded_worker(void *arg)
+{
+    umc_t *c = arg;
+    for (int i = 0; i < 10000; i++) {
+        umc_inc(c, 1);
+    }
+    return NULL;
+}
+
+static void
+sharded_counter(void **state)
+{
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+
+    // sharded incremental counter
+    umc_t *c = umc_new_counter_ex(umc,
+                                  "test_sharded",
+                                  UMCT_INCREMENTAL,
+                                  UMCF_SHARDED);
+    assert_non_null(c);
+    assert_non_null(c->shards);
+
+    // concurrent increments
+    pthread_t th[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&th[i], NULL, &sharded_worker, c);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(th[i], NULL);
+    }
+
+    // aggregated on read
+    c = umc_get(umc, "test_sharded", true);
+    assert_non_null(c);
+    assert_int_equal(c->values.last.value, 40000);
+    c = umc_get_inc(umc, "test_sharded", 10, true);
+    assert_non_null(c);
+    c = umc_get(umc, "test_sharded", true);
+    assert_int_equal(c->values.last.value, 40010);
+    assert_true(umc_get_rate(c, true) >= 0);
+
+    // set (incremental; cannot go lower)
+    umc_set(c, 50000);
+    c = umc_get(umc, "test_sharded", true);
+    assert_int_equal(c->values.last.value, 50000);
+    umc_set(c, 10);
+    c = umc_get(umc, "test_sharded", true);
+    assert_int_equal(c->values.last.value, 50000);
+
+    // aggregated on match
+    umc_inc(c, 5);
+    int cntr = 0;
+    umc_match(umc, "test_sharded", true, &match_cb, &cntr);
+    assert_int_equal(cntr, 1);
+    assert_int_equal(c->values.last.value, 50005);
+
+    // sharding ignored for gauges
+    c = umc_new_counter_ex(umc, "test_gauge", UMCT_GAUGE, UMCF_SHARDED);
+    assert_non_null(c);
+    assert_null(c->shards);
+
+    // free
+    umc_free_ctx(umc);
+}
+
+static void
+counter_rates(void **state)
+{
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+
+    // incremental counter
+    umc_t *c = umc_new_counter(umc, "test_rates", UMCT_INCREMENTAL);
+    assert_non_null(c);
+    assert_non_null(c->win);
+    umc_inc(c, 100);
+
+    // windowed rate (current second)
+    umc_rates_t r;
+    assert_int_equal(umc_get_rates(c, &r, true), 0);
+    assert_true(r.win > 0);
+
+    // completed second is folded into EWMAs on read
+    usleep(1100000);
+    assert_int_equal(umc_get_rates(c, &r, true), 0);
+    assert_true(r.win > 0 && r.win <= 100);
+    assert_true(r.ewma_1s > r.ewma_10s);
+    assert_true(r.ewma_10s > r.ewma_60s);
+    assert_true(r.ewma_60s > 0);
+    // previous value is unchanged (not decayed)
+    assert_int_equal(c->values.last.value, 100);
+
+    // idle seconds decay (1s EWMA first)
+    double e1 = r.ewma_1s;
+    usleep(1000000);
+    assert_int_equal(umc_get_rates(c, &r, true), 0);
+    assert_true(r.ewma_1s < e1);
+
+    // no rates for gauges
+    c = umc_new_counter(umc, "test_rates_gauge", UMCT_GAUGE);
+    assert_non_null(c);
+    assert_null(c->win);
+    assert_int_equal(umc_get_rates(c, &r, true), 1);
+    assert_true(r.win == 0);
+    assert_int_equal(umc_get_rates(NULL, &r, true), 1);
+
+    // free
+    umc_free_ctx(umc);
+}
+
+// histogram writer
+static void *
+hist_worker(void *arg)
+{
+    umc_t *c = arg;
+    for (int i = 1; i <= 1000; i++) {
+        umc_set(c, i);
+    }
+    return NULL;
+}
+
+static void
+histogram_counter(void **state)
+{
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+
+    // histogram counter
+    umc_t *c = umc_new_counter(umc, "test_hist", UMCT_HISTOGRAM);
+    assert_non_null(c);
+    assert_non_null(c->hist);
+    assert_null(c->win);
+
+    // empty
+    umc_hist_stats_t hs;
+    assert_int_equal(umc_get_hist(c, &hs), 0);
+    assert_int_equal(hs.count, 0);
+    assert_int_equal(umc_get_percentile(c, 50), 0);
+
+    // concurrent recording (1 - 1000, 4 times)
+    pthread_t th[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&th[i], NULL, &hist_worker, c);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(th[i], NULL);
+    }
+    assert_int_equal(umc_get_hist(c, &hs), 0);
+    assert_int_equal(hs.count, 4000);
+    assert_int_equal(hs.sum, 4 * 500500);
+    assert_int_equal(hs.max, 1000);
+    assert_int_equal(c->values.max, 1000);
+    assert_int_equal(c->values.last.value, 1000);
+
+    // percentiles (within bucket precision)
+    assert_true(hs.p50 >= 500 && hs.p50 <= 500 * 17 / 16);
+    assert_true(hs.p90 >= 900 && hs.p90 <= 900 * 17 / 16);
+    assert_true(hs.p99 >= 990 && hs.p99 <= 1000);
+    assert_true(hs.p999 >= hs.p99 && hs.p999 <= 1000);
+    assert_int_equal(umc_get_percentile(c, 100), 1000);
+    assert_int_equal(umc_get_percentile(c, 0), 1);
+
+    // small and large values
+    umc_set(c, 0);
+    assert_int_equal(c->values.last.value, 0);
+    umc_set(c, UINT64_MAX);
+    assert_int_equal(umc_get_percentile(c, 100), UINT64_MAX);
+
+    // increment is ignored
+    umc_inc(c, 5);
+    assert_int_equal(c->values.last.value, UINT64_MAX);
+
+    // not a histogram
+    c = umc_new_counter(umc, "test_hist_gauge", UMCT_GAUGE);
+    assert_int_equal(umc_get_hist(c, &hs), 1);
+    assert_int_equal(umc_get_percentile(c, 50), 0);
+
+    // free
+    umc_free_ctx(umc);
+}
+
+static void
+counter_layout(void **state)
+{
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+    assert_int_equal(umc_count(umc), 0);
+    assert_null(umc_at(umc, 0));
+
+    // hot data is cache line aligned
+    assert_int_equal(sizeof(umc_t) % 64, 0);
+
+    // counters spanning multiple chunks
+    char perf_id[UMC_NAME_MAX];
+    uint32_t nr = UMC_CHUNK_SZ * 2 + 10;
+    for (uint32_t i = 0; i < nr; i++) {
+        snprintf(perf_id, sizeof(perf_id), "test_layout_%u", i);
+        umc_t *c = umc_new_counter(umc, perf_id, UMCT_INCREMENTAL);
+        assert_non_null(c);
+        assert_int_equal((uintptr_t)c % 64, 0);
+        assert_int_equal(c->idx, i);
+    }
+    assert_int_equal(umc_count(umc), nr);
+
+    // index order and name lookup
+    for (uint32_t i = 0; i < nr; i++) {
+        umc_t *c = umc_at(umc, i);
+        snprintf(perf_id, sizeof(perf_id), "test_layout_%u", i);
+        assert_string_equal(c->idp, perf_id);
+        assert_ptr_equal(umc_get(umc, perf_id, true), c);
+    }
+    assert_null(umc_at(umc, nr));
+
+    // duplicate id
+    umc_t *c = umc_new_counter(umc, "test_layout_5", UMCT_INCREMENTAL);
+    assert_ptr_equal(c, umc_at(umc, 5));
+    assert_int_equal(umc_count(umc), nr);
+
+    // long ids are truncated
+    char long_id[UMC_NAME_MAX * 2];
+    memset(long_id, 'x', sizeof(long_id) - 1);
+    long_id[sizeof(long_id) - 1] = '\0';
+    c = umc_new_counter(umc, long_id, UMCT_GAUGE);
+    assert_non_null(c);
+    assert_int_equal(strlen(c->idp), UMC_NAME_MAX - 1);
+
+    // free
+    umc_free_ctx(umc);
+}
+
+static void
+labeled_counters(void **state)
+{
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+
+    // family
+    umc_family_t *f = umc_new_family(umc, "test_family", UMCT_INCREMENTAL, 0);
+    assert_non_null(f);
+    assert_ptr_equal(umc_new_family(umc, "test_family", UMCT_GAUGE, 0), f);
+    assert_ptr_equal(umc_get_family(umc, "test_family"), f);
+    assert_null(umc_get_family(umc, "test_family_missing"));
+
+    // label order does not matter
+    umc_label_t l1[] = { { "topic", "a/b" }, { "conn", "1" } };
+    umc_label_t l2[] = { { "conn", "1" }, { "topic", "a/b" } };
+    umc_label_t l3[] = { { "conn", "2" }, { "topic", "a\"b" } };
+    umc_t *c1 = umc_family_get(umc, f, l1, 2);
+    assert_non_null(c1);
+    assert_string_equal(c1->idp, "test_family{conn=\"1\",topic=\"a/b\"}");
+    assert_ptr_equal(umc_family_get(umc, f, l2, 2), c1);
+    umc_t *c2 = umc_family_get(umc, f, l3, 2);
+    assert_non_null(c2);
+    assert_true(c1 != c2);
+    assert_string_equal(c2->idp,
+                        "test_family{conn=\"2\",topic=\"a\\\"b\"}");
+    // no labels
+    umc_t *c3 = umc_family_get(umc, f, NULL, 0);
+    assert_non_null(c3);
+    assert_string_equal(c3->idp, "test_family");
+
+    // regular counters
+    assert_ptr_equal(umc_get(umc, c1->idp, true), c1);
+    umc_inc(c1, 3);
+    umc_inc(c2, 4);
+
+    // family iteration
+    int cntr = 0;
+    assert_int_equal(umc_family_iter(f, &match_cb, &cntr), 3);
+    assert_int_equal(cntr, 3);
+
+    // invalid
+    umc_label_t ln[] = { { "k", NULL } };
+    assert_null(umc_family_get(umc, f, ln, 1));
+    assert_null(umc_family_get(umc, f, l1, UMC_LABELS_MAX + 1));
+    assert_null(umc_family_get(umc, NULL, l1, 2));
+
+    // exporter (labels merged, one TYPE line per family)
+    size_t sz = 0;
+    char *b = umcexp_snapshot(umc, &sz);
+    assert_non_null(b);
+    assert_non_null(strstr(b,
+                           "umink_test_family_total{conn=\"1\","
+                           "topic=\"a/b\"} 3\n"));
+    assert_non_null(strstr(b,
+                           "umink_test_family_rate{conn=\"1\",topic=\"a/b\","
+                           "window=\"last\"}"));
+    char *t = strstr(b, "# TYPE umink_test_family counter\n");
+    assert_non_null(t);
+    assert_null(strstr(t + 1, "# TYPE umink_test_family counter\n"));
+    free(b);
+
+    // free
+    umc_free_ctx(umc);
+}
+
+static void
+persistent_counters(void **state)
+{
+    const char *pth = "/tmp/check_umc.pst";
+    unlink(pth);
+
+    // invalid args
+    assert_null(umcpst_new(NULL, pth, 0, 0));
+
+    // new store
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+    umcpst_t *pst = umcpst_new(umc, pth, 3, 10);
+    assert_non_null(pst);
+    assert_int_equal(pst->restored, 0);
+    umc_t *c1 = umc_new_counter(umc, "test_pst_c1", UMCT_INCREMENTAL);
+    umc_t *c2 = umc_new_counter_ex(umc,
+                                   "test_pst_c2",
+                                   UMCT_INCREMENTAL,
+                                   UMCF_SHARDED);
+    umc_t *c3 = umc_new_counter(umc, "test_pst_c3", UMCT_GAUGE);
+    umc_inc(c1, 10);
+    umc_inc(c2, 20);
+    umc_set(c3, 30);
+    // extra counter (no free slot)
+    umc_new_counter(umc, "test_pst_c4", UMCT_INCREMENTAL);
+    usleep(100000);
+    umc_inc(c1, 5);
+    umcpst_free(pst);
+    umc_free_ctx(umc);
+
+    // counters exist (store not attached)
+    umc = umc_new_ctx();
+    umc_new_counter(umc, "test_pst_c1", UMCT_INCREMENTAL);
+    assert_null(umcpst_new(umc, pth, 0, 0));
+    umc_free_ctx(umc);
+
+    // restart (counters re-created, capacity kept)
+    umc = umc_new_ctx();
+    pst = umcpst_new(umc, pth, 0, 10);
+    assert_non_null(pst);
+    assert_int_equal(pst->restored, 3);
+    assert_int_equal(pst->hdr->capacity, 3);
+    assert_int_equal(umc_count(umc), 3);
+    // incremental values restored
+    c1 = umc_get(umc, "test_pst_c1", true);
+    assert_non_null(c1);
+    assert_int_equal(c1->values.last.value, 15);
+    assert_true(umc_get_rate(c1, true) == 0);
+    umc_rates_t r;
+    umc_get_rates(c1, &r, true);
+    assert_true(r.win == 0);
+    // sharded counter
+    c2 = umc_get(umc, "test_pst_c2", true);
+    assert_non_null(c2);
+    assert_non_null(c2->shards);
+    assert_int_equal(c2->values.last.value, 20);
+    umc_inc(c2, 1);
+    c2 = umc_get(umc, "test_pst_c2", true);
+    assert_int_equal(c2->values.last.value, 21);
+    // gauges are not restored
+    c3 = umc_get(umc, "test_pst_c3", true);
+    assert_non_null(c3);
+    assert_int_equal(c3->type, UMCT_GAUGE);
+    assert_int_equal(c3->values.last.value, 0);
+    // existing counter (no recovery on creation)
+    assert_ptr_equal(umc_new_counter(umc, "test_pst_c1", UMCT_INCREMENTAL),
+                     c1);
+    assert_null(umc_get(umc, "test_pst_c4", true));
+    umcpst_free(pst);
+    umc_free_ctx(umc);
+
+    // incompatible store (re-initialized)
+    FILE *f = fopen(pth, "w");
+    fprintf(f, "%s", "not a counter store");
+    fclose(f);
+    umc = umc_new_ctx();
+    pst = umcpst_new(umc, pth, 2, 0);
+    assert_non_null(pst);
+    assert_int_equal(pst->restored, 0);
+    assert_int_equal(pst->hdr->capacity, 2);
+    umcpst_free(pst);
+    umc_free_ctx(umc);
+    unlink(pth);
+}
+
+// shm slot callback
+static void
+shm_slot_cb(const umcshm_slot_t *s, void *arg)
+{
+    int *cntr = arg;
+    (*cntr)++;
+}
+
+static void
+shm_segment(void **state)
+{
+    const char *pth = "/tmp/check_umc.cnt";
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+    umc_t *c1 = umc_new_counter_ex(umc,
+                                   "test_shm_c1",
+                                   UMCT_INCREMENTAL,
+                                   UMCF_SHARDED);
+    umc_t *c2 = umc_new_counter(umc, "test_shm_c2", UMCT_GAUGE);
+    umc_t *c3 = umc_new_counter(umc, "test_shm_c3", UMCT_HISTOGRAM);
+    umc_inc(c1, 10);
+    umc_set(c2, 20);
+    umc_set(c3, 30);
+
+    // invalid args
+    assert_null(umcshm_new(NULL, pth, 0, 0));
+    assert_null(umcshm_open("/tmp/check_umc_missing.cnt"));
+
+    // link planted at segment path (replaced, target untouched)
+    const char *tgt = "/tmp/check_umc_tgt.cnt";
+    FILE *f = fopen(tgt, "w");
+    assert_non_null(f);
+    fputs("keep", f);
+    fclose(f);
+    unlink(pth);
+    assert_int_equal(symlink(tgt, pth), 0);
+
+    // publisher (3 slots)
+    umcshm_t *shm = umcshm_new(umc, pth, 3, 10);
+    assert_non_null(shm);
+    // extra counter (no free slot)
+    umc_new_counter(umc, "test_shm_c4", UMCT_GAUGE);
+    usleep(100000);
+
+    // reader
+    umcshm_reader_t *rd = umcshm_open(pth);
+    assert_non_null(rd);
+    assert_int_equal(umcshm_count(rd), 3);
+    umcshm_slot_t s;
+    assert_int_equal(umcshm_read(rd, 0, &s), 0);
+    assert_string_equal(s.name, "test_shm_c1");
+    assert_int_equal(s.type, UMCT_INCREMENTAL);
+    assert_int_equal(s.value, 10);
+    // sharded rate window (folded by publisher)
+    assert_true(s.rate_win > 0);
+    assert_int_equal(umcshm_read(rd, 1, &s), 0);
+    assert_string_equal(s.name, "test_shm_c2");
+    assert_int_equal(s.value, 20);
+    assert_int_equal(umcshm_read(rd, 2, &s), 0);
+    assert_string_equal(s.name, "test_shm_c3");
+    assert_int_equal(s.count, 1);
+    assert_int_equal(s.p50, 30);
+    assert_int_equal(umcshm_read(rd, 3, &s), 1);
+
+    // updates are published periodically
+    umc_inc(c1, 5);
+    usleep(100000);
+    assert_int_equal(umcshm_read(rd, 0, &s), 0);
+    assert_int_equal(s.value, 15);
+    int cntr = 0;
+    assert_int_equal(umcshm_read_all(rd, &shm_slot_cb, &cntr), 3);
+    assert_int_equal(cntr, 3);
+
+    // cleanup (segment file is removed)
+    umcshm_close(rd);
+    umcshm_free(shm);
+    assert_null(umcshm_open(pth));
+    struct stat st;
+    assert_int_equal(stat(tgt, &st), 0);
+    assert_int_equal(st.st_size, 4);
+    unlink(tgt);
+    umc_free_ctx(umc);
+}
+
+static void
+openmetrics_exporter(void **state)
+{
+    const char *pth = "/tmp/check_umc.sock";
+    // create ctx
+    umc_ctx_t *umc = umc_new_ctx();
+    assert_non_null(umc);
+    umc_inc(umc_new_counter(umc, "test.exp-c1", UMCT_INCREMENTAL), 10);
+    umc_set(umc_new_counter(umc, "test_exp_c2", UMCT_GAUGE), 20);
+    umc_set(umc_new_counter(umc, "test_exp_c3", UMCT_HISTOGRAM), 30);
+    umc_t *c4 = umc_new_counter_ex(umc,
+                                   "test_exp_c4",
+                                   UMCT_INCREMENTAL,
+                                   UMCF_SHARDED);
+    umc_inc(c4, 600);
+
+    // snapshot
+    size_t sz = 0;
+    char *b = umcexp_snapshot(umc, &sz);
+    assert_non_null(b);
+    assert_int_equal(strlen(b), sz);
+    assert_non_null(strstr(b, "# TYPE umink_test_exp_c1 counter\n"));
+    assert_non_null(strstr(b, "umink_test_exp_c1_total 10\n"));
+    assert_non_null(strstr(b, "umink_test_exp_c1_rate{window=\"ewma_1s\"}"));
+    assert_non_null(strstr(b, "umink_test_exp_c2 20\n"));
+    assert_non_null(strstr(b, "umink_test_exp_c3{quantile=\"0.99\"} 30\n"));
+    assert_non_null(strstr(b, "umink_test_exp_c3_count 1\n"));
+    // sharded (folded before rates are read)
+    assert_non_null(strstr(b, "umink_test_exp_c4_total 600\n"));
+    const char *r4 = strstr(b, "umink_test_exp_c4_rate{window=\"60s\"} ");
+    assert_non_null(r4);
+    assert_true(atof(strchr(r4, ' ') + 1) > 0);
+    assert_string_equal(b + sz - 6, "# EOF\n");
+    free(b);
+
+    // invalid address
+    assert_null(umcexp_new(umc, "udp:1234"));
+    assert_null(umcexp_new(NULL, "unix:/tmp/x"));
+
+    // scrape over unix socket
+    umcexp_t *exp = umcexp_new(umc, "unix:/tmp/check_umc.sock");
+    assert_non_null(exp);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    strcpy(sa.sun_path, pth);
+    assert_int_equal(connect(fd, (struct sockaddr *)&sa, sizeof(sa)), 0);
+    const char *req = "GET /metrics HTTP/1.1\r\nHost: x\r\n\r\n";
+    assert_int_equal(send(fd, req, strlen(req), 0), strlen(req));
+    char rsp[8192];
+    size_t rsp_sz = 0;
+    ssize_t n;
+    while ((n = recv(fd, rsp + rsp_sz, sizeof(rsp) - rsp_sz - 1, 0)) > 0) {
+        rsp_sz += n;
+    }
+    rsp[rsp_sz] = '\0';
+    close(fd);
+    assert_non_null(strstr(rsp, "HTTP/1.1 200 OK\r\n"));
+    assert_non_null(strstr(rsp, "application/openmetrics-text"));
+    assert_non_null(strstr(rsp, "umink_test_exp_c2 20\n"));
+    assert_non_null(strstr(rsp, "# EOF\n"));
+
+    // free (socket file is removed)
+    umcexp_free(exp);
+    assert_int_not_equal(access(pth, F_OK), 0);
+    umc_free_ctx(umc);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -562,6 +1172,15 @@ main(int argc, char **argv)
         cmocka_unit_test(set_counter_nullptr_id),
         cmocka_unit_test(set_nullptr_counter),
         cmocka_unit_test(counter_match),
+        cmocka_unit_test(counter_index),
+        cmocka_unit_test(sharded_counter),
+        cmocka_unit_test(counter_rates),
+        cmocka_unit_test(histogram_counter),
+        cmocka_unit_test(counter_layout),
+        cmocka_unit_test(labeled_counters),
+        cmocka_unit_test(persistent_counters),
+        cmocka_unit_test(shm_segment),
+        cmocka_unit_test(openmetrics_exporter),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
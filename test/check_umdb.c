@@ -13,6 +13,9 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <cmocka_tests.h>
 #include <umdb.h>
 
@@ -305,6 +308,600 @@ store_get_from_missing_store(void **state)
     umdb_mngr_free(m);
 }
 
+static void
+stmt_cache(void **state)
+{
+    // load DB
+    umdb_mngrd_t *m = umdb_mngr_new("./test/test.db", false);
+    assert_non_null(m);
+
+    // statements are prepared once
+    umdb_uauth_d_t res = { 0, 0, 0, NULL };
+    for (int i = 0; i < 3; i++) {
+        res.auth = 0;
+        assert_int_equal(umdb_mngr_uauth(m, &res, "admin", "password"), 0);
+        assert_int_equal(res.auth, 1);
+        assert_int_equal(umdb_mngr_uget(m, &res, "admin"), 0);
+        assert_int_equal(res.id, 1);
+    }
+    // read connection (thread-local)
+    assert_int_equal(m->readers_nr, 1);
+    assert_int_equal(HASH_COUNT(m->readers->stmts), 2);
+    assert_int_equal(HASH_COUNT(m->stmts), 0);
+
+    // free
+    umdb_mngr_free(m);
+
+    // load DB (in-mem)
+    m = umdb_mngr_new(NULL, true);
+    assert_non_null(m);
+
+    // rebind on reuse
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+    char k[32];
+    for (int i = 0; i < 10; i++) {
+        snprintf(k, sizeof(k), "test_key_%d", i);
+        assert_int_equal(umdb_mngr_store_set(m, "user_test_store", k, k), 0);
+    }
+    char *res_v = NULL;
+    size_t out_sz = 0;
+    int r = umdb_mngr_store_get(m,
+                                "user_test_store",
+                                "test_key_5",
+                                &res_v,
+                                &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res_v, "test_key_5");
+    free(res_v);
+    // set and get (in-memory DB uses writer only)
+    assert_int_equal(HASH_COUNT(m->stmts), 2);
+    assert_null(m->readers);
+
+    // missing store (not cached)
+    r = umdb_mngr_store_set(m, "user_test_store_missing", "k", "v");
+    assert_int_equal(r, 2);
+    assert_int_equal(HASH_COUNT(m->stmts), 2);
+
+    // cache size limit
+    char tbl[32];
+    for (int i = 0; i < UMDB_STMT_MAX + 10; i++) {
+        snprintf(tbl, sizeof(tbl), "user_test_store_%d", i);
+        assert_int_equal(umdb_mngr_store_init(m, tbl), 0);
+        assert_int_equal(umdb_mngr_store_set(m, tbl, "k", "v"), 0);
+    }
+    assert_int_equal(HASH_COUNT(m->stmts), UMDB_STMT_MAX);
+
+    // evicted statement (prepared again)
+    r = umdb_mngr_store_get(m,
+                            "user_test_store",
+                            "test_key_1",
+                            &res_v,
+                            &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res_v, "test_key_1");
+    free(res_v);
+
+    // free
+    umdb_mngr_free(m);
+}
+
+static void
+store_init_once(void **state)
+{
+    // load DB (in-mem)
+    umdb_mngrd_t *m = umdb_mngr_new(NULL, true);
+    assert_non_null(m);
+
+    // init store (remembered)
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+    assert_int_equal(HASH_COUNT(m->stores), 1);
+    int r = umdb_mngr_store_set(m, "user_test_store", "test_key", "v1");
+    assert_int_equal(r, 0);
+
+    // table removed (init is not skipped anymore)
+    assert_int_equal(sqlite3_exec(m->db,
+                                  "DROP TABLE user_test_store",
+                                  NULL,
+                                  NULL,
+                                  NULL),
+                     0);
+    r = umdb_mngr_store_set(m, "user_test_store", "test_key", "v2");
+    assert_true(r > 1);
+    assert_int_equal(HASH_COUNT(m->stores), 0);
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+    r = umdb_mngr_store_set(m, "user_test_store", "test_key", "v2");
+    assert_int_equal(r, 0);
+
+    // removed again (get)
+    assert_int_equal(sqlite3_exec(m->db,
+                                  "DROP TABLE user_test_store",
+                                  NULL,
+                                  NULL,
+                                  NULL),
+                     0);
+    char *res = NULL;
+    size_t out_sz = 0;
+    r = umdb_mngr_store_get(m, "user_test_store", "test_key", &res, &out_sz);
+    assert_true(r > 1 && r != 8);
+    assert_int_equal(HASH_COUNT(m->stores), 0);
+
+    // free
+    umdb_mngr_free(m);
+}
+
+static void
+store_write_behind(void **state)
+{
+    const char *pth = "/tmp/check_umdb_wb.db";
+    unlink(pth);
+    FILE *f = fopen(pth, "w");
+    fclose(f);
+
+    // load DB (WAL)
+    umdb_mngrd_t *m = umdb_mngr_new(pth, false);
+    assert_non_null(m);
+    assert_int_equal(umdb_mngr_wal(m), 0);
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+    // second connection (committed data only)
+    umdb_mngrd_t *m2 = umdb_mngr_new(pth, false);
+    assert_non_null(m2);
+
+    // write-behind (long interval)
+    assert_int_equal(umdb_mngr_wb_flush(m), 1);
+    assert_int_equal(umdb_mngr_wb_start(m, 60000, 4), 0);
+    assert_int_equal(umdb_mngr_wb_start(m, 60000, 4), 1);
+    int r = umdb_mngr_store_set(m, "user_test_store", "k1", "v1");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_set(m, "user_test_store", "k1", "v2");
+    assert_int_equal(r, 0);
+    assert_int_equal(HASH_COUNT(m->wb->pending), 1);
+
+    // reads use overlay
+    char *res = NULL;
+    size_t out_sz = 0;
+    r = umdb_mngr_store_get(m, "user_test_store", "k1", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "v2");
+    assert_int_equal(out_sz, 3);
+    free(res);
+    res = NULL;
+    r = umdb_mngr_store_get(m2, "user_test_store", "k1", &res, &out_sz);
+    assert_int_equal(r, 8);
+
+    // commit
+    assert_int_equal(umdb_mngr_wb_flush(m), 0);
+    assert_int_equal(HASH_COUNT(m->wb->pending), 0);
+    r = umdb_mngr_store_get(m2, "user_test_store", "k1", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "v2");
+    free(res);
+
+    // batch size reached (commit thread)
+    char k[16];
+    for (int i = 0; i < 4; i++) {
+        snprintf(k, sizeof(k), "kb%d", i);
+        r = umdb_mngr_store_set(m, "user_test_store", k, k);
+        assert_int_equal(r, 0);
+    }
+    for (int i = 0; i < 50 && HASH_COUNT(m->wb->pending) > 0; i++) {
+        usleep(10000);
+    }
+    r = umdb_mngr_store_get(m2, "user_test_store", "kb3", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "kb3");
+    free(res);
+
+    // sets to missing storages are dropped
+    r = umdb_mngr_store_set(m, "user_test_store_missing", "k", "v");
+    assert_int_equal(r, 0);
+    assert_int_equal(umdb_mngr_wb_flush(m), 0);
+
+    // busy DB (other writer), batch is rolled back and kept
+    r = umdb_mngr_store_set(m, "user_test_store", "k3", "v4");
+    assert_int_equal(r, 0);
+    r = sqlite3_exec(m2->db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+    assert_int_equal(r, SQLITE_OK);
+    assert_int_equal(umdb_mngr_wb_flush(m), 3);
+    assert_int_equal(HASH_COUNT(m->wb->pending), 1);
+    sqlite3_exec(m2->db, "COMMIT", NULL, NULL, NULL);
+    assert_int_equal(umdb_mngr_wb_flush(m), 0);
+    r = umdb_mngr_store_get(m2, "user_test_store", "k3", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "v4");
+    free(res);
+
+    // pending sets are committed on free
+    r = umdb_mngr_store_set(m, "user_test_store", "k2", "v3");
+    assert_int_equal(r, 0);
+    umdb_mngr_free(m);
+    r = umdb_mngr_store_get(m2, "user_test_store", "k2", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "v3");
+    free(res);
+
+    // WAL is not available for in-memory DB
+    m = umdb_mngr_new(NULL, true);
+    assert_int_not_equal(umdb_mngr_wal(m), 0);
+    umdb_mngr_free(m);
+
+    // free
+    umdb_mngr_free(m2);
+    unlink(pth);
+    unlink("/tmp/check_umdb_wb.db-wal");
+    unlink("/tmp/check_umdb_wb.db-shm");
+}
+
+// collect key/value pairs ("k=v;")
+static void
+multi_cb(const char *k, const char *v, void *arg)
+{
+    char *out = arg;
+    size_t l = strlen(out);
+    snprintf(out + l, 256 - l, "%s=%s;", k, v);
+}
+
+static void
+store_multi_key(void **state)
+{
+    // in-memory DB
+    umdb_mngrd_t *m = umdb_mngr_new(NULL, true);
+    assert_non_null(m);
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+
+    // set (one transaction)
+    const char *keys[] = { "a:2", "a:1", "b:1", "10", "1x" };
+    const char *values[] = { "y", "x", "z", "n", "m" };
+    int r = umdb_mngr_store_mset(m, "user_test_store", keys, values, 5);
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_mset(m, "user_test_store", keys, NULL, 5);
+    assert_int_equal(r, 1);
+    // failed transaction is rolled back
+    const char *bad_keys[] = { "c:1" };
+    r = umdb_mngr_store_mset(m, "user_test_store_missing", bad_keys, values, 1);
+    assert_true(r > 1);
+
+    // get (missing key is skipped)
+    char out[256] = { 0 };
+    const char *gkeys[] = { "b:1", "c:1", "a:1", "10" };
+    r = umdb_mngr_store_mget(m, "user_test_store", gkeys, 4, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "b:1=z;a:1=x;10=n;");
+    r = umdb_mngr_store_mget(m, "user_test_store_missing", gkeys, 4,
+                             &multi_cb, out);
+    assert_int_equal(r, 3);
+
+    // prefix scan (ordered, numeric keys included)
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "a:", 0, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "a:1=x;a:2=y;");
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "1", 0, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "10=n;1x=m;");
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "", 2, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "10=n;1x=m;");
+
+    // delete (missing key is not an error)
+    r = umdb_mngr_store_del(m, "user_test_store", "a:1");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_del(m, "user_test_store", "a:1");
+    assert_int_equal(r, 0);
+    char *res = NULL;
+    size_t out_sz = 0;
+    r = umdb_mngr_store_get(m, "user_test_store", "a:1", &res, &out_sz);
+    assert_int_equal(r, 8);
+
+    // write-behind (pending delete hides committed value)
+    assert_int_equal(umdb_mngr_wb_start(m, 60000, 64), 0);
+    r = umdb_mngr_store_del(m, "user_test_store", "a:2");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_mset(m, "user_test_store", keys + 2, values, 1);
+    assert_int_equal(r, 0);
+    assert_int_equal(HASH_COUNT(m->wb->pending), 2);
+    r = umdb_mngr_store_get(m, "user_test_store", "a:2", &res, &out_sz);
+    assert_int_equal(r, 8);
+    out[0] = '\0';
+    const char *wkeys[] = { "a:2", "b:1" };
+    r = umdb_mngr_store_mget(m, "user_test_store", wkeys, 2, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "b:1=y;");
+
+    // scan merges pending data (not committed)
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "", 0, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_int_equal(HASH_COUNT(m->wb->pending), 2);
+    assert_string_equal(out, "10=n;1x=m;b:1=y;");
+    // pending sets before, between and after rows, limit
+    const char *okeys[] = { "0", "1y", "c:1", "10" };
+    const char *ovalues[] = { "o", "p", "q", NULL };
+    r = umdb_mngr_store_mset(m, "user_test_store", okeys, ovalues, 3);
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_del(m, "user_test_store", okeys[3]);
+    assert_int_equal(r, 0);
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "", 0, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "0=o;1x=m;1y=p;b:1=y;c:1=q;");
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "1", 0, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "1x=m;1y=p;");
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "", 3, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "0=o;1x=m;1y=p;");
+    assert_int_equal(HASH_COUNT(m->wb->pending), 6);
+    // committed data gives the same results
+    assert_int_equal(umdb_mngr_wb_flush(m), 0);
+    out[0] = '\0';
+    r = umdb_mngr_store_scan(m, "user_test_store", "", 0, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "0=o;1x=m;1y=p;b:1=y;c:1=q;");
+
+    // free
+    umdb_mngr_free(m);
+}
+
+static void
+store_atomic_ops(void **state)
+{
+    // in-memory DB
+    umdb_mngrd_t *m = umdb_mngr_new(NULL, true);
+    assert_non_null(m);
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+
+    // increment (missing and non-numeric values start at 0)
+    int64_t nv = 0;
+    int r = umdb_mngr_store_incr(m, "user_test_store", "n", 5, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, 5);
+    r = umdb_mngr_store_incr(m, "user_test_store", "n", -7, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, -2);
+    r = umdb_mngr_store_set(m, "user_test_store", "s", "abc");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_incr(m, "user_test_store", "s", 1, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, 1);
+    char *res = NULL;
+    size_t out_sz = 0;
+    r = umdb_mngr_store_get(m, "user_test_store", "n", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "-2");
+    free(res);
+    r = umdb_mngr_store_incr(m, "user_test_store_missing", "n", 1, &nv);
+    assert_int_equal(r, 2);
+
+    // compare-and-set (missing key expected)
+    r = umdb_mngr_store_cas(m, "user_test_store", "st", NULL, "idle");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_cas(m, "user_test_store", "st", NULL, "idle");
+    assert_int_equal(r, 8);
+    // current value expected (numeric values included)
+    r = umdb_mngr_store_cas(m, "user_test_store", "st", "busy", "done");
+    assert_int_equal(r, 8);
+    r = umdb_mngr_store_cas(m, "user_test_store", "st", "idle", "busy");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_cas(m, "user_test_store", "n", "-2", "10");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_get(m, "user_test_store", "st", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "busy");
+    free(res);
+
+    // write-behind (overlay and DB values)
+    assert_int_equal(umdb_mngr_wb_start(m, 60000, 64), 0);
+    r = umdb_mngr_store_incr(m, "user_test_store", "n", 1, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, 11);
+    r = umdb_mngr_store_incr(m, "user_test_store", "n", 1, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, 12);
+    r = umdb_mngr_store_cas(m, "user_test_store", "st", "idle", "done");
+    assert_int_equal(r, 8);
+    r = umdb_mngr_store_cas(m, "user_test_store", "st", "busy", "done");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_del(m, "user_test_store", "st");
+    assert_int_equal(r, 0);
+    r = umdb_mngr_store_cas(m, "user_test_store", "st", NULL, "idle");
+    assert_int_equal(r, 0);
+    assert_int_equal(umdb_mngr_wb_flush(m), 0);
+    r = umdb_mngr_store_get(m, "user_test_store", "n", &res, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(res, "12");
+    free(res);
+
+    // free
+    umdb_mngr_free(m);
+}
+
+// collect key changes ("name:k:old>new;")
+static void
+watch_cb(const umdb_watch_t *w, const char *k, const char *old, const char *v)
+{
+    char *out = w->arg;
+    size_t l = strlen(out);
+    snprintf(out + l,
+             512 - l,
+             "%s:%s:%s>%s;",
+             w->name,
+             k,
+             old != NULL ? old : "nil",
+             v != NULL ? v : "nil");
+}
+
+static void
+store_watch(void **state)
+{
+    // in-memory DB
+    umdb_mngrd_t *m = umdb_mngr_new(NULL, true);
+    assert_non_null(m);
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+
+    // prefix and exact key watches (duplicate is ignored)
+    char out[512] = { 0 };
+    int r = umdb_mngr_watch(m, "user_test_store", "a:*", "W1", &watch_cb, out);
+    assert_int_equal(r, 0);
+    r = umdb_mngr_watch(m, "user_test_store", "a:*", "W1", &watch_cb, out);
+    assert_int_equal(r, 0);
+    r = umdb_mngr_watch(m, "user_test_store", "n", "W2", &watch_cb, out);
+    assert_int_equal(r, 0);
+    r = umdb_mngr_watch(m, NULL, "n", "W2", &watch_cb, out);
+    assert_int_equal(r, 1);
+    assert_non_null(m->watches);
+    assert_null(m->watches->next->next);
+
+    // set, unchanged set, other keys and delete
+    umdb_mngr_store_set(m, "user_test_store", "a:1", "x");
+    umdb_mngr_store_set(m, "user_test_store", "a:1", "x");
+    umdb_mngr_store_set(m, "user_test_store", "b:1", "x");
+    umdb_mngr_store_set(m, "user_test_store", "nn", "x");
+    umdb_mngr_store_del(m, "user_test_store", "a:1");
+    assert_string_equal(out, "W1:a:1:nil>x;W1:a:1:x>nil;");
+
+    // increment, compare-and-set and multi-key set
+    out[0] = '\0';
+    umdb_mngr_store_incr(m, "user_test_store", "n", 2, NULL);
+    umdb_mngr_store_cas(m, "user_test_store", "n", "2", "5");
+    umdb_mngr_store_cas(m, "user_test_store", "n", "2", "6");
+    const char *keys[] = { "a:2", "b:2" };
+    const char *values[] = { "y", "z" };
+    umdb_mngr_store_mset(m, "user_test_store", keys, values, 2);
+    assert_string_equal(out, "W2:n:nil>2;W2:n:2>5;W1:a:2:nil>y;");
+
+    // write-behind (old values from overlay and DB)
+    out[0] = '\0';
+    assert_int_equal(umdb_mngr_wb_start(m, 60000, 64), 0);
+    umdb_mngr_store_set(m, "user_test_store", "a:2", "w");
+    umdb_mngr_store_incr(m, "user_test_store", "n", 1, NULL);
+    umdb_mngr_store_del(m, "user_test_store", "a:2");
+    assert_string_equal(out, "W1:a:2:y>w;W2:n:5>6;W1:a:2:w>nil;");
+
+    // free
+    umdb_mngr_free(m);
+}
+
+// reader thread (user auth and custom storage get)
+static void *
+read_worker(void *arg)
+{
+    umdb_mngrd_t *m = arg;
+    for (int i = 0; i < 100; i++) {
+        umdb_uauth_d_t res = { 0, 0, 0, NULL };
+        if (umdb_mngr_uauth(m, &res, "admin", "password") != 0 ||
+            res.auth != 1) {
+            return (void *)1;
+        }
+    }
+    return NULL;
+}
+
+// reader thread (custom storage get)
+static void *
+read_mem_worker(void *arg)
+{
+    umdb_mngrd_t *m = arg;
+    for (int i = 0; i < 200; i++) {
+        char *res = NULL;
+        size_t out_sz = 0;
+        if (umdb_mngr_store_get(m, "user_test_store", "k", &res, &out_sz)) {
+            return (void *)1;
+        }
+        int r = strcmp(res, "v");
+        free(res);
+        if (r != 0) {
+            return (void *)1;
+        }
+    }
+    return NULL;
+}
+
+// readers and writer (storage init and set) never fail
+static void
+read_write(umdb_mngrd_t *m)
+{
+    assert_int_equal(umdb_mngr_store_init(m, "user_test_store"), 0);
+    assert_int_equal(umdb_mngr_store_set(m, "user_test_store", "k", "v"), 0);
+    pthread_t th[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&th[i], NULL, &read_mem_worker, m);
+    }
+    char tbl[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(tbl, sizeof(tbl), "user_test_store_%d", i % 10);
+        assert_int_equal(umdb_mngr_store_init(m, tbl), 0);
+        assert_int_equal(umdb_mngr_store_set(m, tbl, "k", "v"), 0);
+        assert_int_equal(umdb_mngr_store_set(m, "user_test_store", tbl, "v"),
+                         0);
+    }
+    void *th_r = NULL;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(th[i], &th_r);
+        assert_null(th_r);
+    }
+}
+
+static void
+read_connections(void **state)
+{
+    // load DB
+    umdb_mngrd_t *m = umdb_mngr_new("./test/test.db", false);
+    assert_non_null(m);
+
+    // parallel readers (one connection per thread)
+    pthread_t th[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&th[i], NULL, &read_worker, m);
+    }
+    void *th_r = NULL;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(th[i], &th_r);
+        assert_null(th_r);
+    }
+    int nr = m->readers_nr;
+    assert_true(nr >= 1 && nr <= 4);
+    // connections of exited threads are reused
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&th[i], NULL, &read_worker, m);
+        pthread_join(th[i], &th_r);
+        assert_null(th_r);
+    }
+    assert_int_equal(m->readers_nr, nr);
+    umdb_mngr_free(m);
+
+    // concurrent writes (rollback journal)
+    const char *pth = "/tmp/check_umdb_rw.db";
+    unlink(pth);
+    FILE *f = fopen(pth, "w");
+    fclose(f);
+    m = umdb_mngr_new(pth, false);
+    assert_non_null(m);
+    read_write(m);
+    assert_true(m->readers_nr >= 1);
+    umdb_mngr_free(m);
+    unlink(pth);
+
+    // in-memory DB (writer connection only)
+    m = umdb_mngr_new(NULL, true);
+    assert_non_null(m);
+    read_write(m);
+    assert_int_equal(m->readers_nr, 0);
+    // second in-memory DB is not shared
+    umdb_mngrd_t *m2 = umdb_mngr_new(NULL, true);
+    assert_non_null(m2);
+    char *res = NULL;
+    size_t out_sz = 0;
+    int r = umdb_mngr_store_get(m2, "user_test_store", "k", &res, &out_sz);
+    assert_int_equal(r, 3);
+    umdb_mngr_free(m2);
+    umdb_mngr_free(m);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -329,7 +926,14 @@ main(int argc, char **argv)
         cmocka_unit_test(store_get_nullptr_dbm),
         cmocka_unit_test(store_set_nullptr_dbm),
         cmocka_unit_test(store_init_nullptr_dbm),
-        cmocka_unit_test(store_get_from_missing_store)
+        cmocka_unit_test(store_get_from_missing_store),
+        cmocka_unit_test(stmt_cache),
+        cmocka_unit_test(store_init_once),
+        cmocka_unit_test(store_write_behind),
+        cmocka_unit_test(store_multi_key),
+        cmocka_unit_test(store_atomic_ops),
+        cmocka_unit_test(store_watch),
+        cmocka_unit_test(read_connections)
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,402 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <cmocka_tests.h>
+#include <umkv.h>
+
+static void
+create_kv(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+    umkv_free(kv);
+}
+
+static void
+free_nullptr_kv(void **state)
+{
+    umkv_free(NULL);
+}
+
+static void
+set_get_nullptr_kv(void **state)
+{
+    char *out = NULL;
+    size_t out_sz = 0;
+    int r = umkv_set(NULL, "test_db", "k", 1, "v", 1);
+    assert_int_equal(r, 1);
+    r = umkv_get(NULL, "test_db", "k", 1, &out, &out_sz);
+    assert_int_equal(r, 1);
+    r = umkv_del(NULL, "test_db", "k", 1);
+    assert_int_equal(r, 1);
+}
+
+static void
+set_get_value(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    int r = umkv_set(kv, "test_db", "test_key", 8, "test_value", 10);
+    assert_int_equal(r, 0);
+
+    char *out = NULL;
+    size_t out_sz = 0;
+    r = umkv_get(kv, "test_db", "test_key", 8, &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_int_equal(out_sz, 10);
+    assert_string_equal(out, "test_value");
+    free(out);
+
+    // overwrite
+    r = umkv_set(kv, "test_db", "test_key", 8, "v2", 2);
+    assert_int_equal(r, 0);
+    r = umkv_get(kv, "test_db", "test_key", 8, &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_int_equal(out_sz, 2);
+    assert_string_equal(out, "v2");
+    free(out);
+
+    umkv_free(kv);
+}
+
+static void
+get_missing_key(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    char *out = NULL;
+    size_t out_sz = 0;
+    int r = umkv_get(kv, "test_db", "missing_key", 11, &out, &out_sz);
+    assert_int_equal(r, 3);
+    assert_int_equal(out_sz, 0);
+
+    umkv_free(kv);
+}
+
+static void
+set_get_binary_value(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    const char k[] = { 'k', '\0', 'x' };
+    const char v[] = { 'a', '\0', 'b', '\0', 'c' };
+    int r = umkv_set(kv, "test_db", k, sizeof(k), v, sizeof(v));
+    assert_int_equal(r, 0);
+
+    // key prefix up to '\0' is a different key
+    char *out = NULL;
+    size_t out_sz = 0;
+    r = umkv_get(kv, "test_db", k, 1, &out, &out_sz);
+    assert_int_equal(r, 3);
+
+    r = umkv_get(kv, "test_db", k, sizeof(k), &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_int_equal(out_sz, sizeof(v));
+    assert_memory_equal(out, v, sizeof(v));
+    free(out);
+
+    umkv_free(kv);
+}
+
+static void
+table_namespaces(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    int r = umkv_set(kv, "db_a", "key", 3, "value_a", 7);
+    assert_int_equal(r, 0);
+    r = umkv_set(kv, "db_b", "key", 3, "value_b", 7);
+    assert_int_equal(r, 0);
+
+    char *out = NULL;
+    size_t out_sz = 0;
+    r = umkv_get(kv, "db_a", "key", 3, &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "value_a");
+    free(out);
+
+    r = umkv_get(kv, "db_b", "key", 3, &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "value_b");
+    free(out);
+
+    // "db_" + "akey" must not collide with "db_a" + "key"
+    r = umkv_get(kv, "db_", "akey", 4, &out, &out_sz);
+    assert_int_equal(r, 3);
+
+    umkv_free(kv);
+}
+
+static void
+delete_value(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    int r = umkv_set(kv, "test_db", "test_key", 8, "test_value", 10);
+    assert_int_equal(r, 0);
+    r = umkv_del(kv, "test_db", "test_key", 8);
+    assert_int_equal(r, 0);
+    r = umkv_del(kv, "test_db", "test_key", 8);
+    assert_int_equal(r, 3);
+
+    char *out = NULL;
+    size_t out_sz = 0;
+    r = umkv_get(kv, "test_db", "test_key", 8, &out, &out_sz);
+    assert_int_equal(r, 3);
+
+    umkv_free(kv);
+}
+
+// collect key/value pairs ("k=v;")
+static void
+multi_cb(const char *k, size_t k_sz, const char *v, size_t v_sz, void *arg)
+{
+    char *out = arg;
+    size_t l = strlen(out);
+    snprintf(out + l, 256 - l, "%.*s=%.*s;", (int)k_sz, k, (int)v_sz, v);
+}
+
+// store is writable from callbacks (no locks held)
+static void
+copy_cb(const char *k, size_t k_sz, const char *v, size_t v_sz, void *arg)
+{
+    umkv_set(arg, "copy_db", k, k_sz, v, v_sz);
+}
+
+static void
+multi_key(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    // set (keys are spread over stripes, duplicate key
+    // keeps the last value)
+    const char *keys[] = { "a:1", "a:2", "b:1", "a:1" };
+    const size_t k_szs[] = { 3, 3, 3, 3 };
+    const char *values[] = { "x", "y", "z", "w" };
+    const size_t v_szs[] = { 1, 1, 1, 1 };
+    int r = umkv_mset(kv, "test_db", keys, k_szs, values, v_szs, 4);
+    assert_int_equal(r, 0);
+    r = umkv_set(kv, "other_db", "a:3", 3, "o", 1);
+    assert_int_equal(r, 0);
+    r = umkv_mset(kv, NULL, keys, k_szs, values, v_szs, 4);
+    assert_int_equal(r, 1);
+
+    // get (missing key is skipped)
+    char out[256] = { 0 };
+    const char *gkeys[] = { "b:1", "a:3", "a:1" };
+    const size_t gk_szs[] = { 3, 3, 3 };
+    r = umkv_mget(kv, "test_db", gkeys, gk_szs, 3, &multi_cb, out);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "b:1=z;a:1=w;");
+
+    // prefix scan (table namespace)
+    out[0] = '\0';
+    r = umkv_scan(kv, "test_db", "a:", 2, 0, &multi_cb, out);
+    assert_int_equal(r, 2);
+    assert_non_null(strstr(out, "a:1=w;"));
+    assert_non_null(strstr(out, "a:2=y;"));
+    assert_null(strstr(out, "a:3"));
+
+    // limit and empty prefix
+    r = umkv_scan(kv, "test_db", "a:", 2, 1, &multi_cb, out);
+    assert_int_equal(r, 1);
+    r = umkv_scan(kv, "test_db", NULL, 0, 0, &multi_cb, out);
+    assert_int_equal(r, 3);
+    r = umkv_scan(kv, "test_db", "c:", 2, 0, &multi_cb, out);
+    assert_int_equal(r, 0);
+
+    // callbacks can use the store
+    r = umkv_scan(kv, "test_db", "a:", 2, 0, &copy_cb, kv);
+    assert_int_equal(r, 2);
+    r = umkv_mget(kv, "test_db", gkeys, gk_szs, 3, &copy_cb, kv);
+    assert_int_equal(r, 0);
+    out[0] = '\0';
+    r = umkv_scan(kv, "copy_db", NULL, 0, 0, &multi_cb, out);
+    assert_int_equal(r, 3);
+    assert_non_null(strstr(out, "a:2=y;"));
+    assert_non_null(strstr(out, "b:1=z;"));
+
+    umkv_free(kv);
+}
+
+// stripe hash tables stay balanced (bucket chains are
+// bounded and tables can expand)
+static void
+stripe_buckets(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    char k[32];
+    for (int i = 0; i < 100000; i++) {
+        int k_sz = snprintf(k, sizeof(k), "key:%d", i);
+        assert_int_equal(umkv_set(kv, "test_db", k, k_sz, "v", 1), 0);
+    }
+    for (int i = 0; i < UMKV_STRIPES; i++) {
+        umkv_item_t *items = kv->stripes[i].items;
+        assert_non_null(items);
+        UT_hash_table *tbl = items->hh.tbl;
+        assert_int_equal(tbl->noexpand, 0);
+        unsigned max = 0;
+        for (unsigned b = 0; b < tbl->num_buckets; b++) {
+            if (tbl->buckets[b].count > max) {
+                max = tbl->buckets[b].count;
+            }
+        }
+        assert_true(max <= 2 * HASH_BKT_CAPACITY_THRESH);
+    }
+
+    umkv_free(kv);
+}
+
+// concurrent increments
+static void *
+incr_worker(void *arg)
+{
+    umkv_t *kv = arg;
+    for (int i = 0; i < 1000; i++) {
+        umkv_incr(kv, "test_db", "cnt", 3, 1, NULL);
+    }
+    return NULL;
+}
+
+static void
+atomic_ops(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    // increment (missing and non-numeric values start at 0)
+    int64_t nv = 0;
+    int r = umkv_incr(kv, "test_db", "n", 1, 5, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, 5);
+    r = umkv_incr(kv, "test_db", "n", 1, -7, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, -2);
+    r = umkv_set(kv, "test_db", "s", 1, "abc", 3);
+    assert_int_equal(r, 0);
+    r = umkv_incr(kv, "test_db", "s", 1, 1, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, 1);
+    char *out = NULL;
+    size_t out_sz = 0;
+    r = umkv_get(kv, "test_db", "n", 1, &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "-2");
+    free(out);
+
+    // compare-and-set (missing key expected)
+    r = umkv_cas(kv, "test_db", "st", 2, NULL, 0, "idle", 4);
+    assert_int_equal(r, 0);
+    r = umkv_cas(kv, "test_db", "st", 2, NULL, 0, "idle", 4);
+    assert_int_equal(r, 3);
+    // current value expected
+    r = umkv_cas(kv, "test_db", "st", 2, "busy", 4, "done", 4);
+    assert_int_equal(r, 3);
+    r = umkv_cas(kv, "test_db", "st", 2, "idle", 4, "busy", 4);
+    assert_int_equal(r, 0);
+    r = umkv_get(kv, "test_db", "st", 2, &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "busy");
+    free(out);
+    r = umkv_cas(kv, NULL, "st", 2, NULL, 0, "idle", 4);
+    assert_int_equal(r, 1);
+
+    // concurrent increments are not lost
+    pthread_t th[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&th[i], NULL, &incr_worker, kv);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(th[i], NULL);
+    }
+    r = umkv_incr(kv, "test_db", "cnt", 3, 0, &nv);
+    assert_int_equal(r, 0);
+    assert_int_equal(nv, 4000);
+
+    umkv_free(kv);
+}
+
+// concurrent writers/readers
+static void *
+kv_worker(void *arg)
+{
+    umkv_t *kv = arg;
+    char k[32];
+    for (int i = 0; i < 1000; i++) {
+        int sz = snprintf(k, sizeof(k), "key_%d", i);
+        umkv_set(kv, "test_db", k, sz, k, sz);
+        char *out = NULL;
+        size_t out_sz = 0;
+        if (umkv_get(kv, "test_db", k, sz, &out, &out_sz) == 0) {
+            free(out);
+        }
+    }
+    return NULL;
+}
+
+static void
+concurrent_access(void **state)
+{
+    umkv_t *kv = umkv_new();
+    assert_non_null(kv);
+
+    pthread_t th[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&th[i], NULL, &kv_worker, kv);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(th[i], NULL);
+    }
+
+    char *out = NULL;
+    size_t out_sz = 0;
+    int r = umkv_get(kv, "test_db", "key_999", 7, &out, &out_sz);
+    assert_int_equal(r, 0);
+    assert_string_equal(out, "key_999");
+    free(out);
+
+    umkv_free(kv);
+}
+
+int
+main(int argc, char **argv)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(create_kv),
+        cmocka_unit_test(free_nullptr_kv),
+        cmocka_unit_test(set_get_nullptr_kv),
+        cmocka_unit_test(set_get_value),
+        cmocka_unit_test(get_missing_key),
+        cmocka_unit_test(set_get_binary_value),
+        cmocka_unit_test(table_namespaces),
+        cmocka_unit_test(delete_value),
+        cmocka_unit_test(multi_key),
+        cmocka_unit_test(atomic_ops),
+        cmocka_unit_test(stripe_buckets),
+        cmocka_unit_test(concurrent_access),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -458,6 +458,11 @@ run_lua_env_thread(void **state)
     // check runtime counters (lag)
     c = umc_get(data->umd->perf, "lua.environment.TEST_ENV.lag", true);
     assert_non_null(c);
+    assert_int_equal(c->type, UMCT_HISTOGRAM);
+    umc_hist_stats_t hs;
+    assert_int_equal(umc_get_hist(c, &hs), 0);
+    assert_true(hs.count > 0);
+    assert_true(hs.p50 <= hs.p99 && hs.p99 <= hs.max);
     if (c->values.last.value == 0) {
         fail();
     }
@@ -611,6 +616,48 @@ run_signal_call_admin_signal_from_another_signal(void **state)
     free(b);
 }
 
+//  check binary safe signal result
+static void
+run_signal_w_binary_output(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = umplg_proc_signal(m, "TEST_EVENT_11", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    // 7 bytes + '\0' terminator
+    assert_int_equal(b_sz, 8);
+    assert_memory_equal(b, "bin\0ary", 8);
+    free(b);
+}
+
+//  check lua value passing between nested signals
+static void
+run_signal_call_signal_w_lua_value_result(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = umplg_proc_signal(m, "TEST_EVENT_12", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "tbl3");
+    free(b);
+}
+
 //  check signal recursion check
 static void
 run_signal_prevent_signal_recursion(void **state)
@@ -813,6 +860,464 @@ run_signal_via_unix_domain_socket(void **state)
     close(sock);
 }
 
+// run lua code via domain socket cli
+static int
+cli_run(const char *code, char *out, size_t out_sz)
+{
+    struct sockaddr_un remote;
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1) {
+        return -1;
+    }
+    memset(&remote, 0, sizeof(remote));
+    remote.sun_family = AF_UNIX;
+    strcpy(remote.sun_path, "/tmp/umink.sock");
+    if (connect(sock, (struct sockaddr *)&remote, sizeof(remote)) == -1 ||
+        send(sock, code, strlen(code), 0) == -1) {
+        close(sock);
+        return -1;
+    }
+    memset(out, 0, out_sz);
+    int r = recv(sock, out, out_sz, 0);
+    close(sock);
+    return r;
+}
+
+//  check structured signal arguments/result (same lua state)
+static void
+run_signal_w_structured_args(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = umplg_proc_signal(m, "TEST_EVENT_14", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "table3");
+    free(b);
+}
+
+//  check structured signal arguments/result (different lua states)
+static void
+run_signal_w_structured_args_via_unix_domain_socket(void **state)
+{
+    char recv_msg[128];
+    int r = cli_run("local r = M.signal(\"TEST_EVENT_13\", "
+                    "{ a = 1, b = { 2, 3 } }) "
+                    "return r.t .. r.s",
+                    recv_msg,
+                    sizeof(recv_msg));
+    assert_int_equal(r, 7);
+    assert_string_equal(recv_msg, "table3");
+}
+
+//  check auth context (parsed once, available via M.auth())
+static void
+run_signal_w_auth_context(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // auth passed from lua (M.signal)
+    int r = umplg_proc_signal(m, "TEST_EVENT_16", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "admin71true");
+    free(b);
+    b = NULL;
+
+    // structured auth context
+    umplg_auth_t a = { .uid = 0, .flags = 1, .usr = "root", .exp = 0 };
+    r = umplg_proc_signal_auth(m, "TEST_EVENT_15", NULL, &b, &b_sz, &a, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "root01");
+    free(b);
+    b = NULL;
+
+    // no auth context
+    r = umplg_proc_signal(m, "TEST_EVENT_15", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "none");
+    free(b);
+    b = NULL;
+
+    // expired auth context
+    a.exp = 1;
+    r = umplg_proc_signal_auth(m, "TEST_EVENT_15", NULL, &b, &b_sz, &a, NULL);
+    assert_int_equal(r, UMPLG_RES_AUTH_ERROR);
+    assert_null(b);
+}
+
+//  check lazy signal arguments view (M.get_args())
+static void
+run_signal_w_lazy_args_view(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = umplg_proc_signal(m, "TEST_EVENT_18", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+#if LUA_VERSION_NUM >= 503
+    assert_string_equal(b, "userdata1abcnilnil1abctable");
+#else
+    // plain tables before Lua 5.3
+    assert_string_equal(b, "table1abcnilnil1abctable");
+#endif
+    free(b);
+}
+
+//  check env with selected standard libraries and M sub-modules
+static void
+run_env_w_lib_profile(void **state)
+{
+    test_t *data = *state;
+
+    // set by env script (1 = only selected libraries present)
+    umc_t *c = umc_get(data->umd->perf, "test_env_libs", true);
+    assert_non_null(c);
+    assert_int_equal(c->values.last.value, 1);
+
+    // lua state creation counters
+    c = umc_get(data->umd->perf, "lua.state.count", true);
+    assert_non_null(c);
+    if (c->values.last.value == 0) {
+        fail();
+    }
+    c = umc_get(data->umd->perf, "lua.state.lag", true);
+    assert_non_null(c);
+}
+
+//  check envs sharing one lua state (isolated globals)
+static void
+run_env_w_shared_state(void **state)
+{
+    test_t *data = *state;
+
+    // own globals only (1 per run)
+    umc_t *c = umc_get(data->umd->perf, "test_sbox_01", true);
+    assert_non_null(c);
+    if (c->values.last.value < 1 || c->values.last.value >= 1000000) {
+        fail_msg("sandbox globals leaked (%d)", (int)c->values.last.value);
+    }
+
+    // own globals only (1000000 per run, resumed after yield)
+    c = umc_get(data->umd->perf, "test_sbox_02", true);
+    assert_non_null(c);
+    if (c->values.last.value < 1000000 ||
+        c->values.last.value % 1000000 != 0) {
+        fail_msg("sandbox globals leaked (%d)", (int)c->values.last.value);
+    }
+
+    // globals set through _G (TEST_SBOX_01)
+    c = umc_get(data->umd->perf, "test_sbox_02_leak", true);
+    assert_non_null(c);
+    assert_int_equal(c->values.last.value, 0);
+
+    // env perf counters
+    c = umc_get(data->umd->perf, "lua.environment.TEST_SBOX_02.count", true);
+    assert_non_null(c);
+    if (c->values.last.value == 0) {
+        fail();
+    }
+}
+
+//  check M.json module
+static void
+run_signal_w_json_module(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = umplg_proc_signal(m, "TEST_EVENT_19", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    // lazy views are decoded eagerly before Lua 5.3
+#if LUA_VERSION_NUM >= 503
+    assert_string_equal(b,
+                        "3xtrue1.5true3xuserdata33truetrue"
+                        "[1,\"two\",false]7");
+#else
+    assert_string_equal(b,
+                        "3xtrue1.5true3xtable33truetrue"
+                        "[1,\"two\",false]7");
+#endif
+    free(b);
+}
+
+//  check counter handles (M.counter)
+static void
+run_signal_w_counter_handles(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = umplg_proc_signal(m, "TEST_EVENT_20", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "57falsetrue");
+    free(b);
+
+    // check counters
+    umc_t *c = umc_get(data->umd->perf, "test_lua_counter", true);
+    assert_non_null(c);
+    assert_int_equal(c->type, UMCT_INCREMENTAL);
+    assert_int_equal(c->values.last.value, 5);
+    c = umc_get(data->umd->perf, "test_lua_gauge", true);
+    assert_non_null(c);
+    assert_int_equal(c->type, UMCT_GAUGE);
+    assert_int_equal(c->values.last.value, 7);
+}
+
+//  check labeled counters (families)
+static void
+run_signal_w_labeled_counters(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = umplg_proc_signal(m, "TEST_EVENT_21", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b,
+                        "52test_lua_family{qos=\"1\",topic=\"a\"}"
+                        "test_lua_family{topic=\"b\"}nil");
+    free(b);
+
+    // family members
+    umc_family_t *f = umc_get_family(data->umd->perf, "test_lua_family");
+    assert_non_null(f);
+    assert_int_equal(f->nr, 2);
+    umc_label_t l[] = { { "topic", "b" } };
+    umc_t *c = umc_family_get(data->umd->perf, f, l, 1);
+    assert_non_null(c);
+    assert_int_equal(c->values.last.value, 1);
+}
+
+static void
+run_signal_w_db_multi_key(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal (mset, mget, scan and del)
+    int r = umplg_proc_signal(m, "TEST_EVENT_22", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "xznil2ynil");
+    free(b);
+}
+
+static void
+run_signal_w_db_atomic_ops(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal (incr and cas)
+    int r = umplg_proc_signal(m, "TEST_EVENT_23", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "5truefalsetruebusy");
+    free(b);
+}
+
+// run signal with single positional argument
+static int
+run_signal_w_arg(umplg_mngr_t *m,
+                 const char *sig,
+                 const char *arg,
+                 char **b,
+                 size_t *b_sz)
+{
+    umplg_data_std_t d = { .items = NULL };
+    umplg_data_std_items_t items = { .table = NULL };
+    umplg_data_std_item_t item = { .name = "", .value = (char *)arg };
+    umplg_stdd_init(&d);
+    umplg_stdd_item_add(&items, &item);
+    umplg_stdd_items_add(&d, &items);
+    int r = umplg_proc_signal(m, sig, &d, b, b_sz, 0, NULL);
+    HASH_CLEAR(hh, items.table);
+    umplg_stdd_free(&d);
+    return r;
+}
+
+static void
+run_signal_w_db_watch(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // register watch from lua (permanent store)
+    int r = run_signal_w_arg(m, "TEST_EVENT_24", "watch", &b, &b_sz);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "truenil");
+    free(b);
+    b = NULL;
+
+    // dispatcher with in-memory DB (test DB is not modified)
+    umdb_mngrd_t *dbm = umdb_mngr_new(NULL, true);
+    assert_non_null(dbm);
+    struct umlua_watchd *wd = umlua_watch_new(m);
+    assert_non_null(wd);
+    r = umlua_watch_add(wd, dbm, "test_watch_db", "w:*", "TEST_EVENT_24");
+    assert_int_equal(r, 0);
+    assert_int_equal(umdb_mngr_store_init(dbm, "test_watch_db"), 0);
+
+    // hold signal handler while first change is dispatched
+    umplg_sh_t *sh = NULL;
+    HASH_FIND_STR(m->signals, "TEST_EVENT_24", sh);
+    assert_non_null(sh);
+    pthread_mutex_lock(&sh->mtx);
+    assert_int_equal(umdb_mngr_store_set(dbm, "test_watch_db", "w:1", "a"), 0);
+    bool busy = false;
+    while (!busy) {
+        pthread_mutex_lock(&wd->mtx);
+        busy = wd->busy;
+        pthread_mutex_unlock(&wd->mtx);
+    }
+    // pending changes are merged; a -> b -> a is dropped
+    assert_int_equal(umdb_mngr_store_set(dbm, "test_watch_db", "w:1", "b"), 0);
+    assert_int_equal(umdb_mngr_store_set(dbm, "test_watch_db", "w:1", "a"), 0);
+    assert_int_equal(umdb_mngr_store_set(dbm, "test_watch_db", "w:2", "x"), 0);
+    assert_int_equal(umdb_mngr_store_set(dbm, "test_watch_db", "w:2", "y"), 0);
+    // key not watched
+    assert_int_equal(umdb_mngr_store_set(dbm, "test_watch_db", "o:1", "z"), 0);
+    pthread_mutex_unlock(&sh->mtx);
+    umlua_watch_wait(wd);
+
+    // delete
+    assert_int_equal(umdb_mngr_store_del(dbm, "test_watch_db", "w:2"), 0);
+    umlua_watch_wait(wd);
+
+    // signal received db, key, old and new values
+    r = umplg_proc_signal(m, "TEST_EVENT_24", NULL, &b, &b_sz, 0, NULL);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b,
+                        "test_watch_db:w:1:nil>a;"
+                        "test_watch_db:w:2:nil>y;"
+                        "test_watch_db:w:2:y>nil;");
+    free(b);
+
+    // free
+    umlua_watch_stop(wd);
+    umdb_mngr_free(dbm);
+    umlua_watch_free(wd);
+}
+
+//  check M.get_args() view kept after its signal returned
+static void
+run_signal_w_stale_args_view(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // keep view
+    int r = run_signal_w_arg(m, "TEST_EVENT_25", "a", &b, &b_sz);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+    assert_string_equal(b, "first");
+    free(b);
+    b = NULL;
+
+    // next call (input data at the same address)
+    r = run_signal_w_arg(m, "TEST_EVENT_25", "b", &b, &b_sz);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+#if LUA_VERSION_NUM >= 503
+    // stale view raises an error
+    assert_string_equal(b, "false");
+#else
+    // plain tables are copies
+    assert_string_equal(b, "truea");
+#endif
+    free(b);
+}
+
+//  check M.get_args() views in JSON, M.signal payloads and results
+static void
+run_signal_w_args_view_copy(void **state)
+{
+    // get pm
+    test_t *data = *state;
+    umplg_mngr_t *m = data->m;
+
+    // output buffer
+    char *b = NULL;
+    size_t b_sz = 0;
+
+    // run signal
+    int r = run_signal_w_arg(m, "TEST_EVENT_26", "x", &b, &b_sz);
+    assert_int_equal(r, 0);
+    assert_non_null(b);
+#if LUA_VERSION_NUM >= 503
+    assert_string_equal(b, "[[\"x\"]]tablexfalse");
+#else
+    // plain tables before Lua 5.3 (writable)
+    assert_string_equal(b, "[[\"x\"]]tablextrue");
+#endif
+    free(b);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -838,12 +1343,28 @@ main(int argc, char **argv)
         cmocka_unit_test(run_signal_check_umc_from_lua),
         cmocka_unit_test(run_signal_call_signal_from_another_signal),
         cmocka_unit_test(run_signal_call_admin_signal_from_another_signal),
+        cmocka_unit_test(run_signal_w_binary_output),
+        cmocka_unit_test(run_signal_call_signal_w_lua_value_result),
         cmocka_unit_test(run_signal_prevent_signal_recursion),
         cmocka_unit_test(run_signal_check_arg_levels_w_thread_local_lref),
         cmocka_unit_test(run_signal_check_umdb_from_lua),
         cmocka_unit_test(run_signal_check_cmd_call_w_generic_interface),
         cmocka_unit_test(run_signal_check_lua_submodule_from_umink_plugin),
-        cmocka_unit_test(run_signal_via_unix_domain_socket)
+        cmocka_unit_test(run_signal_via_unix_domain_socket),
+        cmocka_unit_test(run_signal_w_structured_args),
+        cmocka_unit_test(run_signal_w_structured_args_via_unix_domain_socket),
+        cmocka_unit_test(run_signal_w_auth_context),
+        cmocka_unit_test(run_signal_w_lazy_args_view),
+        cmocka_unit_test(run_env_w_lib_profile),
+        cmocka_unit_test(run_env_w_shared_state),
+        cmocka_unit_test(run_signal_w_json_module),
+        cmocka_unit_test(run_signal_w_counter_handles),
+        cmocka_unit_test(run_signal_w_labeled_counters),
+        cmocka_unit_test(run_signal_w_db_multi_key),
+        cmocka_unit_test(run_signal_w_db_atomic_ops),
+        cmocka_unit_test(run_signal_w_db_watch),
+        cmocka_unit_test(run_signal_w_stale_args_view),
+        cmocka_unit_test(run_signal_w_args_view_copy)
     };
 
     const struct CMUnitTest tests_02[] = {
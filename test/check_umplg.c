@@ -313,6 +313,41 @@ run_plugin_w_args_expect_output(void **state)
     umplg_stdd_free(&d);
 }
 
+static void
+parse_auth_context(void **state)
+{
+    const char *s = "{\"uid\": 3, \"flags\": 2, \"username\": \"u\"}";
+    umplg_auth_t ac;
+
+    // parse and cache
+    int r = umplg_auth_get(s, &ac);
+    assert_int_equal(r, 0);
+    assert_int_equal(ac.uid, 3);
+    assert_int_equal(ac.flags, 2);
+    assert_string_equal(ac.usr, "u");
+
+    // cached
+    r = umplg_auth_get(s, &ac);
+    assert_int_equal(r, 0);
+    assert_int_equal(ac.uid, 3);
+
+    // malformed
+    r = umplg_auth_get("{", &ac);
+    assert_int_equal(r, 0);
+    assert_int_equal(ac.uid, -1);
+    assert_int_equal(ac.flags, 0);
+    assert_int_equal(umplg_auth_get(NULL, &ac), 1);
+
+    // cache is bounded
+    char b[64];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(b, sizeof(b), "{\"uid\": %d}", i);
+        assert_int_equal(umplg_auth_get(b, &ac), 0);
+        assert_int_equal(ac.uid, i);
+    }
+    umplg_auth_clear();
+}
+
 int
 main(int argc, char **argv)
 {
@@ -329,6 +364,7 @@ main(int argc, char **argv)
         cmocka_unit_test(run_plugin_expect_err_from_plugin),
         cmocka_unit_test(run_plugin_w_args_expect_no_output),
         cmocka_unit_test(run_plugin_w_args_expect_output),
+        cmocka_unit_test(parse_auth_context),
     };
 
     return cmocka_run_group_tests(tests, umplg_run_init, umplg_run_dtor);
@@ -0,0 +1,3 @@
+-- only base and string libraries should be present
+local ok = io == nil and os == nil and math == nil and string ~= nil
+M.perf_set("test_env_libs", ok and 1 or 2)
@@ -0,0 +1,2 @@
+-- binary result (embedded NUL)
+return "bin\0ary"
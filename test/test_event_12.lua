@@ -0,0 +1,3 @@
+-- nested signal returning a lua value (same lua state)
+local d = M.signal("TEST_EVENT_12_T")
+return d.k .. #d.t
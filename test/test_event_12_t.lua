@@ -0,0 +1 @@
+return { k = "tbl", t = { 1, 2, 3 } }
@@ -0,0 +1,3 @@
+-- structured signal arguments and result
+local a = M.get_args()[1][1]
+return { t = type(a), s = a.a + #a.b }
@@ -0,0 +1,2 @@
+local r = M.signal("TEST_EVENT_13", { a = 1, b = { 2, 3 } })
+return r.t .. r.s
@@ -0,0 +1,5 @@
+local a = M.auth()
+if a == nil then
+    return "none"
+end
+return a.username .. a.uid .. a.flags
@@ -0,0 +1,4 @@
+local r = M.signal("TEST_EVENT_15", "", '{"uid": 7, "flags": 1, "username": "admin"}')
+-- cached auth context
+r = M.signal("TEST_EVENT_15", "", '{"uid": 7, "flags": 1, "username": "admin"}')
+return r .. tostring(M.auth() == nil)
@@ -0,0 +1,5 @@
+local data = M.get_args()
+local row = data[1]
+local t = data:totable()
+return type(data) .. #data .. row[1] .. tostring(row.missing) ..
+       tostring(data[2]) .. #t .. t[1][1] .. type(row:totable())
@@ -0,0 +1 @@
+return M.signal("TEST_EVENT_17", "abc")
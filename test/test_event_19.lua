@@ -0,0 +1,10 @@
+local t = M.json.decode('{"a": [1, 2, {"b": "x"}], "n": null, "f": 1.5, "t": true}')
+local l = M.json.decode('{"a": [1, 2, {"b": "x"}]}', { lazy = true })
+local e = M.json.encode({ s = "q\"\n", a = { 1, 2, 3 }, n = M.json.null })
+local d = M.json.decode(e)
+local _, err = M.json.decode('{"a": ')
+local o = M.json.decode('{"totable": 7}', { lazy = true })
+return tostring(#t.a) .. t.a[3].b .. tostring(t.n == M.json.null) .. t.f ..
+       tostring(t.t) .. #l.a .. l.a[3].b .. type(l) .. d.s:len() .. #d.a ..
+       tostring(d.n == M.json.null) .. tostring(err ~= nil) ..
+       M.json.encode({ 1, "two", false }) .. o.totable
@@ -0,0 +1,12 @@
+local c = M.counter("test_lua_counter")
+c:inc()
+c:inc(4)
+local g = M.counter("test_lua_gauge", "gauge")
+g:set(7)
+-- negative values are rejected
+local ok = pcall(function() c:inc(-1) end)
+-- sharded counter (signal runs)
+M.signal("TEST_EVENT_01")
+local s = M.counter("lua.signal.TEST_EVENT_01.count"):get()
+return tostring(c:get()) .. tostring(g:get()) .. tostring(ok) ..
+       tostring(s > 0)
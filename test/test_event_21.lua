@@ -0,0 +1,18 @@
+-- labeled counters (label order does not matter)
+local c1 = M.counter("test_lua_family", "inc", { topic = "a", qos = 1 })
+local c2 = M.counter("test_lua_family", "inc", { qos = "1", topic = "a" })
+local c3 = M.counter("test_lua_family", "inc", { topic = "b" })
+c1:inc(2)
+c2:inc(3)
+c3:inc()
+-- family members
+local d = M.perf_family("test_lua_family")
+local rt = {}
+for k, v in pairs(d) do
+    table.insert(rt, k)
+end
+table.sort(rt)
+-- missing family
+local e = M.perf_family("test_lua_family_missing")
+return tostring(c1:get()) .. tostring(#rt) .. rt[1] .. rt[2] ..
+           tostring(next(e))
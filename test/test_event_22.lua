@@ -0,0 +1,11 @@
+M.db_mset("test_multi_db", { ["a:1"] = "x", ["a:2"] = "y", ["b:1"] = "z" })
+local g = M.db_mget("test_multi_db", { "a:1", "b:1", "c:1" })
+local s = M.db_scan("test_multi_db", "a:", 10)
+local n = 0
+for _ in pairs(s) do
+    n = n + 1
+end
+M.db_del("test_multi_db", "a:1")
+local d = M.db_get("test_multi_db", "a:1")
+return g["a:1"] .. g["b:1"] .. tostring(g["c:1"]) .. n .. s["a:2"] ..
+       tostring(d)
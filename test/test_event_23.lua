@@ -0,0 +1,7 @@
+M.db_incr("test_atomic_db", "cnt")
+local n = M.db_incr("test_atomic_db", "cnt", 4)
+local c1 = M.db_cas("test_atomic_db", "st", nil, "idle")
+local c2 = M.db_cas("test_atomic_db", "st", "busy", "done")
+local c3 = M.db_cas("test_atomic_db", "st", "idle", "busy")
+return n .. tostring(c1) .. tostring(c2) .. tostring(c3) ..
+       M.db_get("test_atomic_db", "st")
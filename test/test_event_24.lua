@@ -0,0 +1,15 @@
+local a = M.get_args()[1]
+-- key change (dispatcher)
+if a ~= nil and a.key ~= nil then
+    local s = M.db_get("test_watch_db", "log") or ""
+    M.db_set("test_watch_db", "log", s .. a.db .. ":" .. a.key .. ":" ..
+             tostring(a.old) .. ">" .. tostring(a.new) .. ";")
+    return ""
+end
+-- register watch (permanent store, missing signal)
+if a ~= nil and a[1] == "watch" then
+    return tostring(M.db_watch("test_watch_db", "w:*", "TEST_EVENT_24")) ..
+           tostring((M.db_watch("test_watch_db", "w:*")))
+end
+-- collected changes
+return M.db_get("test_watch_db", "log")
@@ -0,0 +1,8 @@
+-- view kept from previous call
+local res = "first"
+if args_view ~= nil then
+    local ok, v = pcall(function() return args_view[1][1] end)
+    res = tostring(ok) .. (ok and v or "")
+end
+args_view = M.get_args()
+return res
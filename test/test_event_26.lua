@@ -0,0 +1,8 @@
+-- M.get_args() views are copied by M.json.encode and M.signal
+local args = M.get_args()
+local j = M.json.encode(args)
+-- view payload and view result (another lua state, MessagePack)
+local r = M.signal("TEST_EVENT_27", args[1])
+-- views are read-only
+local ok = pcall(function() args[1].x = 1 end)
+return j .. type(r) .. r[1][1] .. tostring(ok)
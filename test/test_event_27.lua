@@ -0,0 +1,2 @@
+-- return signal arguments view
+return M.get_args()[1]
@@ -0,0 +1,6 @@
+-- globals are isolated per sandbox
+cnt = (cnt or 0) + 1
+-- _G is the sandbox globals table
+_G.sbox_leak = 1
+rawset(_G, "sbox_leak_raw", 1)
+M.perf_set("test_sbox_01", cnt)
@@ -0,0 +1,8 @@
+-- globals are isolated per sandbox
+cnt = (cnt or 0) + 1000000
+-- let other sandboxes run
+coroutine.yield()
+M.perf_set("test_sbox_02", cnt)
+-- globals set through _G in other sandboxes
+M.perf_set("test_sbox_02_leak",
+           (sbox_leak or 0) + (rawget(_G, "sbox_leak_raw") or 0))